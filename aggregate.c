@@ -0,0 +1,219 @@
+#include "aggregate.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+/* Unsigned, so overflow wraps instead of being undefined. */
+static long long scalar_sum(const long long *a, int n)
+{
+    unsigned long long sum = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        sum += (unsigned long long) a[i];
+    }
+    return (long long) sum;
+}
+
+static long long scalar_min(const long long *a, int n)
+{
+    long long min = a[0];
+
+    for (int i = 1; i < n; i++)
+    {
+        if (a[i] < min)
+        {
+            min = a[i];
+        }
+    }
+    return min;
+}
+
+static long long scalar_max(const long long *a, int n)
+{
+    long long max = a[0];
+
+    for (int i = 1; i < n; i++)
+    {
+        if (a[i] > max)
+        {
+            max = a[i];
+        }
+    }
+    return max;
+}
+
+static long long scalar_dot(const long long *a, const long long *b, int n)
+{
+    unsigned long long sum = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        sum += (unsigned long long) a[i] * (unsigned long long) b[i];
+    }
+    return (long long) sum;
+}
+
+static const struct aggregator scalar_aggregator =
+{
+    "scalar", scalar_sum, scalar_min, scalar_max, scalar_dot
+};
+
+#ifdef HAVE_X86_SIMD
+
+#define AVX2 __attribute__((target("avx2")))
+
+/*
+ * Each function keeps four lanes of partial results, two vectors at a
+ * time so consecutive adds do not wait on each other, and finishes the
+ * last few elements with scalar code.
+ */
+static inline AVX2 long long avx2_lanes_sum(__m256i v)
+{
+    long long lanes[4];
+
+    _mm256_storeu_si256((__m256i *) lanes, v);
+    return (long long) ((unsigned long long) lanes[0] + (unsigned long long) lanes[1]
+                        + (unsigned long long) lanes[2] + (unsigned long long) lanes[3]);
+}
+
+static AVX2 long long avx2_sum(const long long *a, int n)
+{
+    __m256i s0 = _mm256_setzero_si256();
+    __m256i s1 = _mm256_setzero_si256();
+    unsigned long long sum;
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        s0 = _mm256_add_epi64(s0, _mm256_loadu_si256((const __m256i *) (a + i)));
+        s1 = _mm256_add_epi64(s1, _mm256_loadu_si256((const __m256i *) (a + i + 4)));
+    }
+    sum = avx2_lanes_sum(_mm256_add_epi64(s0, s1));
+    for (; i < n; i++)
+    {
+        sum += (unsigned long long) a[i];
+    }
+    return (long long) sum;
+}
+
+/* AVX2 has no 64 bit min or max, so they are built from a compare. */
+static inline AVX2 __m256i avx2_min64(__m256i x, __m256i y)
+{
+    return _mm256_blendv_epi8(x, y, _mm256_cmpgt_epi64(x, y));
+}
+
+static inline AVX2 __m256i avx2_max64(__m256i x, __m256i y)
+{
+    return _mm256_blendv_epi8(y, x, _mm256_cmpgt_epi64(x, y));
+}
+
+#define AVX2_EXTREME(name, pick, better)                                \
+    static AVX2 long long name(const long long *a, int n)               \
+    {                                                                   \
+        __m256i m0 = _mm256_set1_epi64x(a[0]);                          \
+        __m256i m1 = m0;                                                \
+        long long lanes[4];                                             \
+        long long m;                                                    \
+        int i = 0;                                                      \
+                                                                        \
+        for (; i + 8 <= n; i += 8)                                      \
+        {                                                               \
+            m0 = pick(m0, _mm256_loadu_si256((const __m256i *) (a + i))); \
+            m1 = pick(m1, _mm256_loadu_si256((const __m256i *) (a + i + 4))); \
+        }                                                               \
+        _mm256_storeu_si256((__m256i *) lanes, pick(m0, m1));           \
+        m = lanes[0];                                                   \
+        for (int j = 1; j < 4; j++)                                     \
+        {                                                               \
+            if (lanes[j] better m)                                      \
+            {                                                           \
+                m = lanes[j];                                           \
+            }                                                           \
+        }                                                               \
+        for (; i < n; i++)                                              \
+        {                                                               \
+            if (a[i] better m)                                          \
+            {                                                           \
+                m = a[i];                                               \
+            }                                                           \
+        }                                                               \
+        return m;                                                       \
+    }
+
+AVX2_EXTREME(avx2_min, avx2_min64, <)
+AVX2_EXTREME(avx2_max, avx2_max64, >)
+
+/* The low 64 bits of each product, from three 32 by 32 bit multiplies. */
+static inline AVX2 __m256i avx2_mul64(__m256i x, __m256i y)
+{
+    __m256i lo = _mm256_mul_epu32(x, y);
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), y),
+                                     _mm256_mul_epu32(x, _mm256_srli_epi64(y, 32)));
+
+    return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+
+static AVX2 long long avx2_dot(const long long *a, const long long *b, int n)
+{
+    __m256i s0 = _mm256_setzero_si256();
+    __m256i s1 = _mm256_setzero_si256();
+    unsigned long long sum;
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        s0 = _mm256_add_epi64(s0, avx2_mul64(_mm256_loadu_si256((const __m256i *) (a + i)),
+                                             _mm256_loadu_si256((const __m256i *) (b + i))));
+        s1 = _mm256_add_epi64(s1, avx2_mul64(_mm256_loadu_si256((const __m256i *) (a + i + 4)),
+                                             _mm256_loadu_si256((const __m256i *) (b + i + 4))));
+    }
+    sum = avx2_lanes_sum(_mm256_add_epi64(s0, s1));
+    for (; i < n; i++)
+    {
+        sum += (unsigned long long) a[i] * (unsigned long long) b[i];
+    }
+    return (long long) sum;
+}
+
+static const struct aggregator avx2_aggregator =
+{
+    "avx2", avx2_sum, avx2_min, avx2_max, avx2_dot
+};
+
+#endif
+
+const struct aggregator *aggregator_get(enum aggregator_kind kind)
+{
+    switch (kind)
+    {
+    case SCALAR_AGGREGATOR:
+    {
+        return &scalar_aggregator;
+    }
+#ifdef HAVE_X86_SIMD
+    case AVX2_AGGREGATOR:
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") ? &avx2_aggregator : NULL;
+    }
+#endif
+    default:
+    {
+        return NULL;
+    }
+    }
+}
+
+const struct aggregator *aggregator_best(void)
+{
+    const struct aggregator *aggregator;
+
+    if ((aggregator = aggregator_get(AVX2_AGGREGATOR)) != NULL)
+    {
+        return aggregator;
+    }
+    return &scalar_aggregator;
+}
@@ -0,0 +1,28 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+/*
+ * Reductions over unboxed integer arrays.  Sums and dot products wrap
+ * around on overflow, as every version computes them modulo 2^64.  min
+ * and max need n > 0.
+ */
+struct aggregator
+{
+    const char *name;
+    long long (*sum)(const long long *a, int n);
+    long long (*min)(const long long *a, int n);
+    long long (*max)(const long long *a, int n);
+    long long (*dot)(const long long *a, const long long *b, int n);
+};
+
+enum aggregator_kind
+{
+    SCALAR_AGGREGATOR,
+    AVX2_AGGREGATOR
+};
+
+/* NULL if this machine cannot run kind. */
+const struct aggregator *aggregator_get(enum aggregator_kind kind);
+const struct aggregator *aggregator_best(void);
+
+#endif
@@ -0,0 +1,84 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <mem.h>
+#include <seq.h>
+
+#include "aggregate.h"
+#include "object.h"
+#include "state.h"
+
+#define ELEMENTS 10000000
+#define ROUNDS 10
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* How arrays were summed before they were unboxed: one pointer per element. */
+static long long boxed_sum(Seq_T elements)
+{
+    unsigned long long sum = 0;
+
+    for (int i = 0; i < Seq_length(elements); i++)
+    {
+        sum += ((struct integer_object *) Seq_get(elements, i))->value;
+    }
+    return (long long) sum;
+}
+
+static void report(const char *name, double secs, long long result)
+{
+    printf("%-8s %.3f s, %6.0f M elements/s  (%lld)\n", name, secs,
+           (double) ELEMENTS * ROUNDS / secs / 1e6, result);
+}
+
+int main(void)
+{
+    const struct aggregator *aggregators[] =
+        { aggregator_get(SCALAR_AGGREGATOR), aggregator_get(AVX2_AGGREGATOR) };
+    struct interpreter_state *state;
+    Seq_T elements;
+    long long *ints;
+    long long result = 0;
+    double start;
+
+    state = interpreter_state_alloc();
+    elements = Seq_new(ELEMENTS);
+    ints = ALLOC(ELEMENTS * sizeof *ints);
+    for (int i = 0; i < ELEMENTS; i++)
+    {
+        ints[i] = (i * 2654435761LL) % 1000003;
+        Seq_addhi(elements, integer_object_alloc(state, ints[i]));
+    }
+    printf("sum of %d integers, %d rounds\n", ELEMENTS, ROUNDS);
+    start = now();
+    for (int i = 0; i < ROUNDS; i++)
+    {
+        result = boxed_sum(elements);
+    }
+    report("boxed", now() - start, result);
+    for (int i = 0; i < sizeof aggregators / sizeof aggregators[0]; i++)
+    {
+        if (aggregators[i] == NULL)
+        {
+            continue;
+        }
+        start = now();
+        for (int j = 0; j < ROUNDS; j++)
+        {
+            result = aggregators[i]->sum(ints, ELEMENTS);
+        }
+        report(aggregators[i]->name, now() - start, result);
+    }
+    FREE(ints);
+    Seq_free(&elements);
+    interpreter_state_destroy(state);
+    return EXIT_SUCCESS;
+}
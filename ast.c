@@ -23,7 +23,8 @@ const char *node_type_str [] =
     [INFIX_EXPR] = "INFIX EXPR",
     [BOOL_EXPR] = "BOOL EXPR",
     [IF_EXPR] = "IF EXPR",
-    [CALL_EXPR] = "CALL EXPR"
+    [CALL_EXPR] = "CALL EXPR",
+    [SLICE_EXPR] = "SLICE EXPR"
 };
 
 Text_T expression_token_literal(struct expression *expression)
@@ -63,6 +64,10 @@ Text_T expression_token_literal(struct expression *expression)
     {
         return prefix_expression_token_literal((struct prefix_expression *) expression);
     }
+    case SLICE_EXPR:
+    {
+        return slice_expression_token_literal((struct slice_expression *) expression);
+    }
     case PREFIX_EXPR:
     {
         return prefix_expression_token_literal((struct prefix_expression *) expression);
@@ -187,6 +192,11 @@ Text_T index_expression_token_literal(struct index_expression *index_expression)
     return index_expression->token.literal;
 }
 
+Text_T slice_expression_token_literal(struct slice_expression *slice_expression)
+{
+    return slice_expression->token.literal;
+}
+
 Text_T prefix_expression_token_literal(struct prefix_expression *prefix_expression)
 {
     return prefix_expression->token.literal;
@@ -244,6 +254,10 @@ char *expression_to_string(struct expression *expression)
     {
         return index_expression_to_string((struct index_expression *) expression);
     }
+    case SLICE_EXPR:
+    {
+        return slice_expression_to_string((struct slice_expression *) expression);
+    }
     case PREFIX_EXPR:
     {
         return prefix_expression_to_string((struct prefix_expression *) expression);
@@ -350,6 +364,10 @@ char *integer_literal_to_string(struct integer_literal *integer_literal)
     int len;
     char *str;
 
+    if (integer_literal->big)
+    {
+        return Text_get(NULL, 0, integer_literal->token.literal);
+    }
     len = 24;
     str = ALLOC(len);
     snprintf(str, len, "%lld", integer_literal->value);
@@ -413,7 +431,7 @@ char *hash_literal_to_string(struct hash_literal *hash_literal)
             str2 = expression_to_string(expression);
             expression = (struct expression *) Seq_get(hash_literal->values, 0);
             str3 = expression_to_string(expression);
-            str = Str_catv(str1, 1, 0, ", ", 1, 0, str2, 1, 0, " : ", 1, 0, str3, 1, 0);
+            str = Str_catv(str1, 1, 0, ", ", 1, 0, str2, 1, 0, " : ", 1, 0, str3, 1, 0, NULL);
             FREE(str3);
             FREE(str2);
             FREE(str1);
@@ -444,6 +462,7 @@ char *function_literal_to_string(struct function_literal *function_literal)
         str = Str_cat(str, 1, 0, str2, 1, 0);
         FREE(str2);
         FREE(str1);
+        str1 = str;
         for (int i = 1; i < Seq_length(function_literal->parameters); i++)
         {
             identifier = (struct identifier *) Seq_get(function_literal->parameters, i);
@@ -458,6 +477,10 @@ char *function_literal_to_string(struct function_literal *function_literal)
     FREE(str1);
     str1 = str;
     str2 = block_statement_to_string(function_literal->body);
+    if (str2 == NULL)
+    {
+        return str1;
+    }
     str = Str_cat(str1, 1, 0, str2, 1, 0);
     FREE(str2);
     FREE(str1);
@@ -582,6 +605,24 @@ char *index_expression_to_string(struct index_expression *index_expression)
     return str;
 }
 
+char *slice_expression_to_string(struct slice_expression *slice_expression)
+{
+    char *str;
+    char *str1;
+    char *str2;
+    char *str3;
+
+    str1 = expression_to_string(slice_expression->left);
+    str2 = slice_expression->start != NULL ? expression_to_string(slice_expression->start) : NULL;
+    str3 = slice_expression->end != NULL ? expression_to_string(slice_expression->end) : NULL;
+    str = Str_catv("(", 1, 0, str1, 1, 0, "[", 1, 0, str2 != NULL ? str2 : "", 1, 0,
+                   ":", 1, 0, str3 != NULL ? str3 : "", 1, 0, "])", 1, 0, NULL);
+    FREE(str3);
+    FREE(str2);
+    FREE(str1);
+    return str;
+}
+
 char *prefix_expression_to_string(struct prefix_expression *prefix_expression)
 {
     int len;
@@ -724,6 +765,11 @@ void expression_destroy(struct expression *expression)
         index_expression_destroy((struct index_expression *) expression);
         break;
     }
+    case SLICE_EXPR:
+    {
+        slice_expression_destroy((struct slice_expression *) expression);
+        break;
+    }
     case PREFIX_EXPR:
     {
         prefix_expression_destroy((struct prefix_expression *) expression);
@@ -905,7 +951,7 @@ struct function_literal *function_literal_alloc(struct token token)
 
 void function_literal_addref(struct function_literal *function_literal)
 {
-    function_literal->cnt++;
+    __atomic_add_fetch(&function_literal->cnt, 1, __ATOMIC_RELAXED);
 }
 
 struct boolean *boolean_alloc(struct token token, bool value)
@@ -954,6 +1000,17 @@ struct index_expression *index_expression_alloc(struct token token)
     return index_expression;
 }
 
+struct slice_expression *slice_expression_alloc(struct token token)
+{
+    struct slice_expression *slice_expression;
+
+    NEW0(slice_expression);
+    slice_expression->type = SLICE_EXPR;
+    token.literal = Text_box(Text_get(NULL, 0, token.literal), token.literal.len);
+    slice_expression->token = token;
+    return slice_expression;
+}
+
 struct prefix_expression *prefix_expression_alloc(struct token token)
 {
     struct prefix_expression *prefix_expression;
@@ -1078,6 +1135,22 @@ void index_expression_destroy(struct index_expression *index_expression)
     FREE(index_expression);
 }
 
+void slice_expression_destroy(struct slice_expression *slice_expression)
+{
+    char *c;
+    
+    if (slice_expression == NULL)
+    {
+        return;
+    }
+    expression_destroy(slice_expression->left);
+    expression_destroy(slice_expression->start);
+    expression_destroy(slice_expression->end);
+    c = (char *) slice_expression->token.literal.str;
+    FREE(c);
+    FREE(slice_expression);
+}
+
 void prefix_expression_destroy(struct prefix_expression *prefix_expression)
 {
     char *c;
@@ -1151,6 +1224,10 @@ void identifier_destroy(struct identifier *identifier)
 {
     char *c;
 
+    if (identifier == NULL)
+    {
+        return;
+    }
     c = (char *) identifier->value.str;
     FREE(c);
     c = (char *) identifier->token.literal.str;
@@ -1236,7 +1313,7 @@ void function_literal_destroy(struct function_literal *function_literal)
     {
         return;
     }
-    if (--function_literal->cnt > 0)
+    if (__atomic_sub_fetch(&function_literal->cnt, 1, __ATOMIC_ACQ_REL) > 0)
     {
         return;
     }
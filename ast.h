@@ -23,7 +23,8 @@ enum node_type
     INFIX_EXPR,
     BOOL_EXPR,
     IF_EXPR,
-    CALL_EXPR
+    CALL_EXPR,
+    SLICE_EXPR
 };
 
 extern const char *node_type_str[];
@@ -65,11 +66,13 @@ struct string_literal
     Text_T value;
 };
 
+/* A literal too large for a long long is big, and kept as the digits of its token. */
 struct integer_literal
 {
     enum node_type type;
     struct token token;
     long long value;
+    bool big;
 };
 
 struct array_literal
@@ -98,6 +101,8 @@ struct function_literal
 {
     enum node_type type;
     struct token token;
+    /* Shared by every function object made from it; updated atomically
+       so compiled programs can be run from several threads. */
     unsigned int cnt;
     Seq_T parameters;
     struct block_statement *body;
@@ -140,6 +145,16 @@ struct index_expression
     struct expression *index;    
 };
 
+/* left[start:end]; either bound may be left out, and is then NULL. */
+struct slice_expression
+{
+    enum node_type type;
+    struct token token;
+    struct expression *left;
+    struct expression *start;
+    struct expression *end;
+};
+
 struct prefix_expression
 {
     enum node_type type;
@@ -166,12 +181,33 @@ struct if_expression
     struct block_statement *alternative;
 };
 
+struct builtin_object;
+
+/*
+ * Where a call by name last found its function: the binding at slot of
+ * the environment depth out from the caller's, or, when builtin is not
+ * NULL, that builtin of builtins_version.  The evaluator checks it on
+ * every call, so it is only ever a hint.  Compiled programs are run by
+ * several threads at once, so its fields are written only by whoever
+ * moves sequence from even to odd, and a read only counts if sequence
+ * is the same even number, other than 0, before and after it.
+ */
+struct call_cache
+{
+    unsigned sequence;
+    int depth;
+    int slot;
+    struct builtin_object *builtin;
+    unsigned builtins_version;
+};
+
 struct call_expression
 {
     enum node_type type;
     struct token token;
     struct expression *function;
     Seq_T arguments;
+    struct call_cache cache;
 };
 
 Text_T expression_token_literal(struct expression *expression);
@@ -190,6 +226,7 @@ Text_T expression_statement_token_literal(struct expression_statement *expressio
 Text_T block_statement_token_literal(struct block_statement *block_statement);
 Text_T prefix_expression_token_literal(struct prefix_expression *prefix_expression);
 Text_T index_expression_token_literal(struct index_expression *index_expression);
+Text_T slice_expression_token_literal(struct slice_expression *slice_expression);
 Text_T infix_expression_token_literal(struct infix_expression *infix_expression);
 Text_T if_expression_token_literal(struct if_expression *if_expression);
 Text_T call_expression_token_literal(struct call_expression *call_expression);
@@ -208,6 +245,7 @@ char *return_statement_to_string(struct return_statement *let_statement);
 char *expression_statement_to_string(struct expression_statement *expression_statement);
 char *block_statement_to_string(struct block_statement *block_statement);
 char *index_expression_to_string(struct index_expression *index_expression);
+char *slice_expression_to_string(struct slice_expression *slice_expression);
 char *prefix_expression_to_string(struct prefix_expression *prefix_expression);
 char *infix_expression_to_string(struct infix_expression *infix_expression);
 char *if_expression_to_string(struct if_expression *if_expression);
@@ -226,6 +264,7 @@ struct let_statement *let_statement_alloc(struct token token);
 struct expression_statement *expression_statement_alloc(struct token token);
 struct block_statement *block_statement_alloc(struct token token);
 struct index_expression *index_expression_alloc(struct token token);
+struct slice_expression *slice_expression_alloc(struct token token);
 struct prefix_expression *prefix_expression_alloc(struct token token);
 struct infix_expression *infix_expression_alloc(struct token token);
 struct if_expression *if_expression_alloc(struct token token);
@@ -245,6 +284,7 @@ void return_statement_destroy(struct return_statement *return_statement);
 void expression_statement_destroy(struct expression_statement *expression_statement);
 void block_statement_destroy(struct block_statement *block_statement);
 void index_expression_destroy(struct index_expression *index_expression);
+void slice_expression_destroy(struct slice_expression *slice_expression);
 void prefix_expression_destroy(struct prefix_expression *prefix_expression);
 void infix_expression_destroy(struct infix_expression *infix_expression);
 void if_expression_destroy(struct if_expression *if_expression);
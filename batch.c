@@ -0,0 +1,426 @@
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <mem.h>
+#include <str.h>
+
+#include "batch.h"
+#include "lexer.h"
+#include "parser.h"
+#include "evaluator.h"
+#include "object.h"
+#include "state.h"
+#include "scan.h"
+
+/* How far reading may run ahead of the oldest unwritten result. */
+#define BATCH_WINDOW 1024
+
+struct job
+{
+    char *name;
+    /* NULL when the program could not be read; result says why. */
+    char *source;
+    char *result;
+    /* What the program wrote with puts, written to out before result. */
+    char *output;
+    int output_length;
+    bool failed;
+    bool done;
+};
+
+/*
+ * Jobs live in a ring indexed by their position in the input.  The
+ * reader appends at queued, workers take from started, and the writer
+ * waits for the job at written to be done, so results leave in order
+ * however the workers finish.
+ */
+struct batch
+{
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t result;
+    pthread_cond_t space;
+    struct job jobs[BATCH_WINDOW];
+    unsigned long queued;
+    unsigned long started;
+    unsigned long written;
+    bool eof;
+    void (*read)(struct batch *batch, void *cl);
+    void *cl;
+};
+
+static char *padded_copy(const char *s, size_t len)
+{
+    char *copy;
+
+    copy = ALLOC(len + 1 + SCAN_PADDING);
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+/* Takes ownership of name, source and result. */
+static void submit(struct batch *batch, char *name, char *source, char *result)
+{
+    struct job *job;
+
+    pthread_mutex_lock(&batch->lock);
+    while (batch->queued - batch->written >= BATCH_WINDOW)
+    {
+        pthread_cond_wait(&batch->space, &batch->lock);
+    }
+    job = &batch->jobs[batch->queued % BATCH_WINDOW];
+    job->name = name;
+    job->source = source;
+    job->result = result;
+    job->output = NULL;
+    job->output_length = 0;
+    job->failed = source == NULL;
+    job->done = false;
+    batch->queued++;
+    pthread_cond_signal(&batch->work);
+    pthread_mutex_unlock(&batch->lock);
+}
+
+static char *parse_errors(struct parser *parser)
+{
+    char *result;
+    char *str;
+
+    result = Str_dup("parse error: ", 1, 0, 1);
+    for (int i = 0; i < Seq_length(parser->errors); i++)
+    {
+        str = Str_catv(result, 1, 0, i > 0 ? "; " : "", 1, 0,
+                       (char *) Seq_get(parser->errors, i), 1, 0, NULL);
+        FREE(result);
+        result = str;
+    }
+    return result;
+}
+
+/*
+ * Collecting with only a fresh environment as the root frees whatever
+ * the previous program left behind.  The state's output has no stream,
+ * so what the program writes is kept for the writer.
+ */
+static void run_job(struct interpreter_state *state, struct job *job)
+{
+    struct env_object *env;
+    struct lexer *lexer;
+    struct parser *parser;
+    struct program *program;
+    struct object *object;
+
+    env = env_object_alloc(state, NULL);
+    objects_gc(state, env);
+    lexer = lexer_alloc(job->source);
+    parser = parser_alloc(lexer);
+    program = parser_parse_program(parser);
+    if (Seq_length(parser->errors) != 0)
+    {
+        job->result = parse_errors(parser);
+        job->failed = true;
+    }
+    else
+    {
+        object = eval(state, (struct node *) program, env);
+        job->result = object_inspect(object);
+        job->failed = object->type == ERROR_OBJ;
+        if (state->output.length > 0)
+        {
+            job->output_length = state->output.length;
+            job->output = output_take(&state->output);
+            output_init(&state->output, NULL);
+        }
+    }
+    program_destroy(program);
+    parser_destroy(parser);
+    lexer_destroy(lexer);
+}
+
+static void *worker(void *arg)
+{
+    struct batch *batch = arg;
+    struct interpreter_state *state;
+    struct job *job;
+
+    state = interpreter_state_alloc();
+    output_free(&state->output);
+    output_init(&state->output, NULL);
+    pthread_mutex_lock(&batch->lock);
+    for (;;)
+    {
+        while (batch->started == batch->queued && !batch->eof)
+        {
+            pthread_cond_wait(&batch->work, &batch->lock);
+        }
+        if (batch->started == batch->queued)
+        {
+            break;
+        }
+        job = &batch->jobs[batch->started++ % BATCH_WINDOW];
+        pthread_mutex_unlock(&batch->lock);
+        if (job->source != NULL)
+        {
+            run_job(state, job);
+        }
+        pthread_mutex_lock(&batch->lock);
+        job->done = true;
+        pthread_cond_broadcast(&batch->result);
+    }
+    pthread_mutex_unlock(&batch->lock);
+    interpreter_state_destroy(state);
+    return NULL;
+}
+
+static void *reader(void *arg)
+{
+    struct batch *batch = arg;
+
+    batch->read(batch, batch->cl);
+    pthread_mutex_lock(&batch->lock);
+    batch->eof = true;
+    pthread_cond_broadcast(&batch->work);
+    pthread_cond_broadcast(&batch->result);
+    pthread_mutex_unlock(&batch->lock);
+    return NULL;
+}
+
+static int run(int workers, FILE *out, void (*read)(struct batch *batch, void *cl),
+               void *cl)
+{
+    struct batch *batch;
+    pthread_t *threads;
+    pthread_t reader_thread;
+    struct job *job;
+    int started = 0;
+    int rc = EXIT_SUCCESS;
+
+    if (workers <= 0)
+    {
+        workers = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = workers > 0 ? workers : 1;
+    }
+    NEW0(batch);
+    pthread_mutex_init(&batch->lock, NULL);
+    pthread_cond_init(&batch->work, NULL);
+    pthread_cond_init(&batch->result, NULL);
+    pthread_cond_init(&batch->space, NULL);
+    batch->read = read;
+    batch->cl = cl;
+    threads = CALLOC(workers, sizeof *threads);
+    for (; started < workers; started++)
+    {
+        if (pthread_create(&threads[started], NULL, worker, batch) != 0)
+        {
+            break;
+        }
+    }
+    if (started == 0 || pthread_create(&reader_thread, NULL, reader, batch) != 0)
+    {
+        Fmt_fprint(stderr, "cannot start batch threads\n");
+        pthread_mutex_lock(&batch->lock);
+        batch->eof = true;
+        pthread_cond_broadcast(&batch->work);
+        pthread_mutex_unlock(&batch->lock);
+        for (int i = 0; i < started; i++)
+        {
+            pthread_join(threads[i], NULL);
+        }
+        rc = EXIT_FAILURE;
+        goto cleanup;
+    }
+    pthread_mutex_lock(&batch->lock);
+    for (;;)
+    {
+        job = &batch->jobs[batch->written % BATCH_WINDOW];
+        while (!(batch->written < batch->queued && job->done)
+               && !(batch->eof && batch->written == batch->queued))
+        {
+            pthread_cond_wait(&batch->result, &batch->lock);
+        }
+        if (batch->written == batch->queued)
+        {
+            break;
+        }
+        pthread_mutex_unlock(&batch->lock);
+        if (job->output != NULL)
+        {
+            fwrite(job->output, 1, job->output_length, out);
+        }
+        if (job->name != NULL)
+        {
+            fprintf(out, "%s: %s\n", job->name, job->result);
+        }
+        else
+        {
+            fprintf(out, "%s\n", job->result);
+        }
+        if (job->failed)
+        {
+            rc = EXIT_FAILURE;
+        }
+        FREE(job->name);
+        FREE(job->source);
+        FREE(job->result);
+        FREE(job->output);
+        pthread_mutex_lock(&batch->lock);
+        batch->written++;
+        pthread_cond_signal(&batch->space);
+    }
+    pthread_mutex_unlock(&batch->lock);
+    pthread_join(reader_thread, NULL);
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    fflush(out);
+
+cleanup:
+    FREE(threads);
+    pthread_cond_destroy(&batch->space);
+    pthread_cond_destroy(&batch->result);
+    pthread_cond_destroy(&batch->work);
+    pthread_mutex_destroy(&batch->lock);
+    FREE(batch);
+    return rc;
+}
+
+static void read_lines(struct batch *batch, void *cl)
+{
+    FILE *in = cl;
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t len;
+
+    while ((len = getline(&line, &size, in)) >= 0)
+    {
+        if (len > 0 && line[len - 1] == '\n')
+        {
+            len--;
+        }
+        submit(batch, NULL, padded_copy(line, len), NULL);
+    }
+    free(line);
+}
+
+int batch_run_fd(int fd, int workers, FILE *out)
+{
+    FILE *in;
+    int copy;
+    int rc;
+
+    /* Closing the stream must leave the caller's descriptor open. */
+    copy = dup(fd);
+    if (copy < 0 || (in = fdopen(copy, "r")) == NULL)
+    {
+        Fmt_fprint(stderr, "cannot read programs: %s\n", strerror(errno));
+        if (copy >= 0)
+        {
+            close(copy);
+        }
+        return EXIT_FAILURE;
+    }
+    rc = run(workers, out, read_lines, in);
+    fclose(in);
+    return rc;
+}
+
+struct directory
+{
+    const char *path;
+    struct dirent **entries;
+    int n;
+};
+
+static char *read_file(const char *path, char **error)
+{
+    struct stat st;
+    char *source;
+    size_t len = 0;
+    ssize_t n;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        *error = Str_cat("cannot read: ", 1, 0, strerror(errno), 1, 0);
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return NULL;
+    }
+    if (!S_ISREG(st.st_mode))
+    {
+        *error = Str_dup("not a regular file", 1, 0, 1);
+        close(fd);
+        return NULL;
+    }
+    source = ALLOC(st.st_size + 1 + SCAN_PADDING);
+    while (len < (size_t) st.st_size
+           && (n = read(fd, source + len, st.st_size - len)) > 0)
+    {
+        len += n;
+    }
+    close(fd);
+    source[len] = '\0';
+    return source;
+}
+
+static void read_directory(struct batch *batch, void *cl)
+{
+    struct directory *directory = cl;
+    char *name;
+    char *path;
+    char *source;
+    char *error;
+
+    for (int i = 0; i < directory->n; i++)
+    {
+        name = Str_dup(directory->entries[i]->d_name, 1, 0, 1);
+        path = Str_catv(directory->path, 1, 0, "/", 1, 0, name, 1, 0, NULL);
+        error = NULL;
+        source = read_file(path, &error);
+        FREE(path);
+        submit(batch, name, source, error);
+    }
+}
+
+/* Links and file systems without d_type are checked when read. */
+static int program_file(const struct dirent *entry)
+{
+    return entry->d_name[0] != '.'
+        && (entry->d_type == DT_REG || entry->d_type == DT_LNK
+            || entry->d_type == DT_UNKNOWN);
+}
+
+int batch_run_dir(const char *path, int workers, FILE *out)
+{
+    struct directory directory;
+    int rc;
+
+    directory.path = path;
+    directory.n = scandir(path, &directory.entries, program_file, alphasort);
+    if (directory.n < 0)
+    {
+        Fmt_fprint(stderr, "cannot open %s: %s\n", path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    rc = run(workers, out, read_directory, &directory);
+    for (int i = 0; i < directory.n; i++)
+    {
+        free(directory.entries[i]);
+    }
+    free(directory.entries);
+    return rc;
+}
@@ -0,0 +1,20 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+
+/*
+ * Runs many independent programs on a pool of worker threads and writes
+ * one result line per program to out, in input order.  Each worker owns
+ * an interpreter and each program starts in a fresh environment.  A
+ * workers count of 0 uses one per online CPU.  What a program writes
+ * with puts goes to out just before its result.
+ */
+
+/* One program per line. */
+int batch_run_fd(int fd, int workers, FILE *out);
+/* One program per file, in name order, skipping dot files; results are
+   prefixed with the file name. */
+int batch_run_dir(const char *path, int workers, FILE *out);
+
+#endif
@@ -0,0 +1,69 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "batch.h"
+
+#define PROGRAMS 10000
+
+/* A small rule: a few bindings, a call or two, a hash lookup. */
+static void write_programs(FILE *file)
+{
+    for (int i = 0; i < PROGRAMS; i++)
+    {
+        fprintf(file, "let limit = %d; let score = fn(x) { if (x > limit) { x - limit } "
+                "else { limit - x } }; let weights = {\"a\": %d, \"b\": %d}; "
+                "let fib = fn(n) { if (n < 2) { n } else { fib(n - 1) + fib(n - 2) } }; "
+                "score(weights[\"a\"] * 3 + weights[\"b\"]) + fib(%d) + len([1, 2, 3])\n",
+                i % 97, i % 13, i % 7, 5 + i % 5);
+    }
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    FILE *programs;
+    FILE *out;
+    double base = 0;
+    double start;
+    double secs;
+
+    programs = tmpfile();
+    out = fopen("/dev/null", "w");
+    if (programs == NULL || out == NULL)
+    {
+        perror("batch_bench");
+        return EXIT_FAILURE;
+    }
+    write_programs(programs);
+    fflush(programs);
+    printf("%d programs, %ld cpus\n", PROGRAMS, cpus);
+    for (int workers = 1; workers <= 2 * cpus; workers *= 2)
+    {
+        rewind(programs);
+        lseek(fileno(programs), 0, SEEK_SET);
+        start = now();
+        batch_run_fd(fileno(programs), workers, out);
+        secs = now() - start;
+        if (workers == 1)
+        {
+            base = secs;
+        }
+        printf("%3d workers: %.3f s, %8.0f programs/s, speedup %.2f\n",
+               workers, secs, PROGRAMS / secs, base / secs);
+    }
+    fclose(out);
+    fclose(programs);
+    return EXIT_SUCCESS;
+}
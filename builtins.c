@@ -1,190 +1,1524 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <seq.h>
 #include <str.h>
+#include <mem.h>
 
+#include "aggregate.h"
 #include "builtins.h"
+#include "evaluator.h"
+#include "json.h"
+#include "sort.h"
 #include "util.h"
 
-static Table_T builtins;
-
-static struct object *len(Seq_T args)
+static struct object *len(struct interpreter_state *state, struct object *arg, void *cl)
 {
-    struct object *arg;
     struct string_object *string_object;
-    struct array_object *array_object;
     
-    if (Seq_length(args) != 1)
-    {
-        return (struct object *) error_object_alloc("wrong number of arguments. got=%d, want=1",
-                                                    Seq_length(args));
-    }
-    arg = (struct object *) Seq_get(args, 0);
     if (arg->type == STRING_OBJ)
     {
         string_object = (struct string_object *) arg;
-        return (struct object *) integer_object_alloc(Str_len(string_object->value, 1, 0));
-
+        return (struct object *) integer_object_alloc(state, string_object->length);
     }
-    else if (arg->type == ARRAY_OBJ)
+    else if (is_sequence(arg))
     {
-        array_object = (struct array_object *) arg;
-        return (struct object *) integer_object_alloc(Seq_length(array_object->elements));
+        return (struct object *) integer_object_alloc(state, sequence_length(arg));
+    }
+    else if (arg->type == HASH_OBJ)
+    {
+        return (struct object *) integer_object_alloc(state, ((struct hash_object *) arg)->length);
     }
-    return (struct object *) error_object_alloc("argument to 'len' not supported, got %s",
+    return (struct object *) error_object_alloc(state, "argument to 'len' not supported, got %s",
                                                     object_type_str[arg->type]);        
 
 }
 
-static struct object *first(Seq_T args)
+static struct object *first(struct interpreter_state *state, struct object *arg, void *cl)
 {
-    struct object *arg;
-    struct array_object *array_object;
-    struct object *object;
-    
-    if (Seq_length(args) != 1)
+    if (is_sequence(arg))
     {
-        return (struct object *) error_object_alloc("wrong number of arguments. got=%d, want=1",
-                                                    Seq_length(args));
-    }
-    arg = (struct object *) Seq_get(args, 0);
-    if (arg->type == ARRAY_OBJ)
-    {
-        array_object = (struct array_object *) arg;
-        if (Seq_length(array_object->elements) > 0)
+        if (sequence_length(arg) > 0)
         {
-            object = Seq_get(array_object->elements, 0);
-            return object;
+            return sequence_get(state, arg, 0);
         }
         return (struct object *) &null_object;
     }
-    return (struct object *) error_object_alloc("argument to 'first' must be ARRAY, got %s",
+    return (struct object *) error_object_alloc(state, "argument to 'first' must be ARRAY or RANGE, got %s",
                                                 object_type_str[arg->type]);
 }
 
-static struct object *last(Seq_T args)
+static struct object *last(struct interpreter_state *state, struct object *arg, void *cl)
 {
-    struct object *arg;
-    struct array_object *array_object;
-    struct object *object;
-    
-    if (Seq_length(args) != 1)
+    if (is_sequence(arg))
     {
-        return (struct object *) error_object_alloc("wrong number of arguments. got=%d, want=1",
-                                                    Seq_length(args));
-    }
-    arg = (struct object *) Seq_get(args, 0);
-    if (arg->type == ARRAY_OBJ)
-    {
-        array_object = (struct array_object *) arg;
-        if (Seq_length(array_object->elements) > 0)
+        if (sequence_length(arg) > 0)
         {
-            object = Seq_get(array_object->elements, Seq_length(array_object->elements) - 1);
-            return object;
+            return sequence_get(state, arg, sequence_length(arg) - 1);
         }
         return (struct object *) &null_object;
     }
-    return (struct object *) error_object_alloc("argument to 'last' must be ARRAY, got %s",
+    return (struct object *) error_object_alloc(state, "argument to 'last' must be ARRAY or RANGE, got %s",
                                                 object_type_str[arg->type]);
 }
 
-static struct object *rest(Seq_T args)
+static struct object *rest(struct interpreter_state *state, struct object *arg, void *cl)
 {
-    struct object *arg;
     struct array_object *array_object;
-    struct object *object;
+    struct range_object *range;
+    long long *ints;
     Seq_T elements;
+    int n;
     
-    if (Seq_length(args) != 1)
+    /* The rest of a range is a range, so recursing over one stays lazy. */
+    if (arg->type == RANGE_OBJ)
     {
-        return (struct object *) error_object_alloc("wrong number of arguments. got=%d, want=1",
-                                                    Seq_length(args));
+        range = (struct range_object *) arg;
+        if (range->length > 0)
+        {
+            /* The last element may be the only one step can reach. */
+            return (struct object *) range_object_alloc(state,
+                                                        range->length > 1
+                                                        ? range->start + range->step
+                                                        : range->end,
+                                                        range->end, range->step);
+        }
+        return (struct object *) &null_object;
     }
-    arg = (struct object *) Seq_get(args, 0);
     if (arg->type == ARRAY_OBJ)
     {
         array_object = (struct array_object *) arg;
-        if (Seq_length(array_object->elements) > 0)
+        n = array_object->length;
+        if (n > 1 && array_object->ints != NULL)
+        {
+            ints = ALLOC((n - 1) * sizeof *ints);
+            memcpy(ints, array_object->ints + 1, (n - 1) * sizeof *ints);
+            return (struct object *) int_array_object_alloc(state, ints, n - 1);
+        }
+        if (n > 0)
         {
-            elements = Seq_new(Seq_length(array_object->elements) - 1);
-            for (int i = 1; i < Seq_length(array_object->elements); i++)
+            elements = Seq_new(n - 1);
+            for (int i = 1; i < n; i++)
             {
-                object = (struct object *) Seq_get(array_object->elements, i);
-                Seq_addhi(elements, object);
+                Seq_addhi(elements, sequence_get(state, arg, i));
             }
-            return (struct object *) array_object_alloc(elements);
+            return (struct object *) array_object_alloc(state, elements);
         }
         return (struct object *) &null_object;
     }
-    return (struct object *) error_object_alloc("argument to 'rest' must be ARRAY, got %s",
+    return (struct object *) error_object_alloc(state, "argument to 'rest' must be ARRAY or RANGE, got %s",
                                                 object_type_str[arg->type]);
 }
 
-static struct object *push(Seq_T args)
+static struct object *push(struct interpreter_state *state, struct object *arg,
+                           struct object *element, void *cl)
 {
-    struct object *arg;
     struct array_object *array_object;
-    struct object *object;
+    long long *ints;
     Seq_T elements;
+    int n;
     
-    if (Seq_length(args) != 2)
-    {
-        return (struct object *) error_object_alloc("wrong number of arguments. got=%d, want=2",
-                                                    Seq_length(args));
-    }
-    arg = (struct object *) Seq_get(args, 0);
     if (arg->type == ARRAY_OBJ)
     {
         array_object = (struct array_object *) arg;
-        elements = Seq_new(Seq_length(array_object->elements) + 1);
-        for (int i = 0; i < Seq_length(array_object->elements); i++)
+        n = array_object->length;
+        if (array_object->ints != NULL && element->type == INTEGER_OBJ)
+        {
+            ints = ALLOC((n + 1) * sizeof *ints);
+            memcpy(ints, array_object->ints, n * sizeof *ints);
+            ints[n] = ((struct integer_object *) element)->value;
+            return (struct object *) int_array_object_alloc(state, ints, n + 1);
+        }
+        elements = Seq_new(n + 1);
+        for (int i = 0; i < n; i++)
         {
-            object = (struct object *) Seq_get(array_object->elements, i);
-            Seq_addhi(elements, object);
+            Seq_addhi(elements, sequence_get(state, arg, i));
         }
-        object = (struct object *) Seq_get(args, 1);
-        Seq_addhi(elements, object);
-        return (struct object *) array_object_alloc(elements);
+        Seq_addhi(elements, element);
+        return (struct object *) array_object_alloc(state, elements);
     }
-    return (struct object *) error_object_alloc("first argument to 'push' must be ARRAY, got %s",
+    return (struct object *) error_object_alloc(state, "first argument to 'push' must be ARRAY, got %s",
                                                 object_type_str[arg->type]);
 }
 
-static struct object *putz(Seq_T args)
+static struct object *not_string(struct interpreter_state *state, const char *position,
+                                 const char *name, struct object *arg)
+{
+    return (struct object *) error_object_alloc(state, "%s argument to '%s' must be STRING, got %s",
+                                                position, name, object_type_str[arg->type]);
+}
+
+/*
+ * The first needle in haystack, or NULL.  memchr, which the C library
+ * vectorizes, skips to each candidate first byte, so only those are
+ * compared in full.
+ */
+static const char *find(const char *haystack, int n, const char *needle, int m)
+{
+    const char *last = haystack + n - m;
+    const char *p = haystack;
+
+    if (m == 0)
+    {
+        return haystack;
+    }
+    if (m > n)
+    {
+        return NULL;
+    }
+    while (p <= last && (p = memchr(p, needle[0], last - p + 1)) != NULL)
+    {
+        if (memcmp(p + 1, needle + 1, m - 1) == 0)
+        {
+            return p;
+        }
+        p++;
+    }
+    return NULL;
+}
+
+/* The n bytes of string from p, as a slice rather than a copy. */
+static struct object *sub_string(struct interpreter_state *state, struct string_object *string,
+                                 const char *p, int n)
+{
+    return (struct object *) string_slice_alloc(state, string, p - string->value, n);
+}
+
+/* An empty separator splits str into single bytes. */
+static struct object *split(struct interpreter_state *state, struct object *arg,
+                            struct object *sep, void *cl)
+{
+    struct string_object *string = (struct string_object *) arg;
+    struct string_object *separator = (struct string_object *) sep;
+    const char *end;
+    const char *p;
+    const char *q;
+    Seq_T elements;
+
+    if (arg->type != STRING_OBJ)
+    {
+        return not_string(state, "first", "split", arg);
+    }
+    if (sep->type != STRING_OBJ)
+    {
+        return not_string(state, "second", "split", sep);
+    }
+    elements = Seq_new(0);
+    p = string->value;
+    end = string->value + string->length;
+    if (separator->length == 0)
+    {
+        for (; p < end; p++)
+        {
+            Seq_addhi(elements, sub_string(state, string, p, 1));
+        }
+        return (struct object *) array_object_alloc(state, elements);
+    }
+    while ((q = find(p, end - p, separator->value, separator->length)) != NULL)
+    {
+        Seq_addhi(elements, sub_string(state, string, p, q - p));
+        p = q + separator->length;
+    }
+    Seq_addhi(elements, sub_string(state, string, p, end - p));
+    return (struct object *) array_object_alloc(state, elements);
+}
+
+static struct object *join(struct interpreter_state *state, struct object *arg,
+                           struct object *sep, void *cl)
 {
+    struct string_object *separator = (struct string_object *) sep;
+    struct string_object *string;
     struct object *object;
-    
-    for (int i = 0; i < Seq_length(args); i++)
+    long long length = 0;
+    char *value;
+    char *p;
+    int n;
+
+    if (arg->type != ARRAY_OBJ)
     {
-        object = (struct object *) Seq_get(args, i);
-        puts(object_inspect(object));
+        return (struct object *) error_object_alloc(state, "first argument to 'join' must be ARRAY, got %s",
+                                                    object_type_str[arg->type]);
     }
-    return (struct object *) &null_object;
+    if (sep->type != STRING_OBJ)
+    {
+        return not_string(state, "second", "join", sep);
+    }
+    n = sequence_length(arg);
+    for (int i = 0; i < n; i++)
+    {
+        object = sequence_get(state, arg, i);
+        if (object->type != STRING_OBJ)
+        {
+            return (struct object *) error_object_alloc(state, "elements of 'join' must be STRING, got %s",
+                                                        object_type_str[object->type]);
+        }
+        length += ((struct string_object *) object)->length + (i > 0 ? separator->length : 0);
+    }
+    if (length > INT_MAX)
+    {
+        return (struct object *) error_object_alloc(state, "result of 'join' is too long, got %lld",
+                                                    length);
+    }
+    p = value = ALLOC(length + 1);
+    for (int i = 0; i < n; i++)
+    {
+        if (i > 0)
+        {
+            memcpy(p, separator->value, separator->length);
+            p += separator->length;
+        }
+        string = (struct string_object *) sequence_get(state, arg, i);
+        memcpy(p, string->value, string->length);
+        p += string->length;
+    }
+    *p = '\0';
+    return (struct object *) string_object_take(state, value, length);
 }
 
-struct object *builtins_get(struct identifier *identifier)
+/*
+ * substr(str, start) or substr(str, start, length); start and length
+ * are clamped to the string, so the result may be shorter or empty.
+ */
+static struct object *substr(struct interpreter_state *state, int argc,
+                             struct object **argv, void *cl)
 {
-    return (struct object *) Table_get(builtins, &identifier->value);
+    struct string_object *string = (struct string_object *) argv[0];
+    long long bounds[2];
+
+    if (argc < 2 || argc > 3)
+    {
+        return (struct object *) error_object_alloc(state, "wrong number of arguments. got=%d, want=2 or 3",
+                                                    argc);
+    }
+    if (argv[0]->type != STRING_OBJ)
+    {
+        return not_string(state, "first", "substr", argv[0]);
+    }
+    for (int i = 1; i < argc; i++)
+    {
+        if (argv[i]->type != INTEGER_OBJ)
+        {
+            return (struct object *) error_object_alloc(state, "arguments to 'substr' after the first must be INTEGER, got %s",
+                                                        object_type_str[argv[i]->type]);
+        }
+        bounds[i - 1] = ((struct integer_object *) argv[i])->value;
+    }
+    bounds[0] = bounds[0] < 0 ? 0 : bounds[0] > string->length ? string->length : bounds[0];
+    if (argc == 2 || bounds[1] > string->length - bounds[0])
+    {
+        bounds[1] = string->length - bounds[0];
+    }
+    return sub_string(state, string, string->value + bounds[0], bounds[1] < 0 ? 0 : bounds[1]);
 }
 
-void builtins_init(void)
+/* The byte offset of the first sub in str, or -1. */
+static struct object *index_of(struct interpreter_state *state, struct object *arg,
+                               struct object *sub, void *cl)
 {
-    static struct identifier_builtin
+    struct string_object *string = (struct string_object *) arg;
+    struct string_object *needle = (struct string_object *) sub;
+    const char *p;
+
+    if (arg->type != STRING_OBJ)
     {
-        Text_T identifier;
-        struct builtin_object builtin;
-    } identifier_builtins[] =
-      {
-          { {sizeof "len" - 1, "len"}, {BUILTIN_OBJ, 1, len} },
-          { {sizeof "first" - 1, "first"}, {BUILTIN_OBJ, 1, first} },
-          { {sizeof "last" - 1, "last"}, {BUILTIN_OBJ, 1, last} },
-          { {sizeof "rest" - 1, "rest"}, {BUILTIN_OBJ, 1, rest} },
-          { {sizeof "push" - 1, "push"}, {BUILTIN_OBJ, 1, push} },
-          { {sizeof "puts" - 1, "puts"}, {BUILTIN_OBJ, 1, putz} }
-      };
-    builtins = Table_new(0, text_cmp, text_hash);
-    for (int i = 0; i < sizeof identifier_builtins / sizeof identifier_builtins[0]; i++)
+        return not_string(state, "first", "index_of", arg);
+    }
+    if (sub->type != STRING_OBJ)
     {
-        Table_put(builtins, &identifier_builtins[i].identifier,
-                  &identifier_builtins[i].builtin);
+        return not_string(state, "second", "index_of", sub);
+    }
+    p = find(string->value, string->length, needle->value, needle->length);
+    return (struct object *) integer_object_alloc(state, p != NULL ? p - string->value : -1);
+}
+
+/* Replaces every old in str, left to right, with new. */
+static struct object *replace(struct interpreter_state *state, struct object *arg,
+                              struct object *old, struct object *new, void *cl)
+{
+    struct string_object *string = (struct string_object *) arg;
+    struct string_object *from = (struct string_object *) old;
+    struct string_object *to = (struct string_object *) new;
+    const char *end = string->value + string->length;
+    long long length = string->length;
+    const char *p;
+    const char *q;
+    char *value;
+    char *r;
+
+    if (arg->type != STRING_OBJ || old->type != STRING_OBJ || new->type != STRING_OBJ)
+    {
+        return (struct object *) error_object_alloc(state, "arguments to 'replace' must be STRING, got %s, %s and %s",
+                                                    object_type_str[arg->type],
+                                                    object_type_str[old->type],
+                                                    object_type_str[new->type]);
+    }
+    if (from->length == 0)
+    {
+        return (struct object *) error_object_alloc(state, "second argument to 'replace' must not be empty");
+    }
+    for (p = string->value; (q = find(p, end - p, from->value, from->length)) != NULL;
+         p = q + from->length)
+    {
+        length += to->length - from->length;
+    }
+    if (length > INT_MAX)
+    {
+        return (struct object *) error_object_alloc(state, "result of 'replace' is too long, got %lld",
+                                                    length);
+    }
+    r = value = ALLOC(length + 1);
+    for (p = string->value; (q = find(p, end - p, from->value, from->length)) != NULL;
+         p = q + from->length)
+    {
+        memcpy(r, p, q - p);
+        r += q - p;
+        memcpy(r, to->value, to->length);
+        r += to->length;
+    }
+    memcpy(r, p, end - p);
+    r[end - p] = '\0';
+    return (struct object *) string_object_take(state, value, length);
+}
+
+static struct object *starts_with(struct interpreter_state *state, struct object *arg,
+                                  struct object *prefix, void *cl)
+{
+    struct string_object *string = (struct string_object *) arg;
+    struct string_object *start = (struct string_object *) prefix;
+
+    if (arg->type != STRING_OBJ)
+    {
+        return not_string(state, "first", "starts_with", arg);
+    }
+    if (prefix->type != STRING_OBJ)
+    {
+        return not_string(state, "second", "starts_with", prefix);
+    }
+    return (struct object *) boolean_object_alloc(start->length <= string->length
+                                                  && memcmp(string->value, start->value,
+                                                            start->length) == 0);
+}
+
+static struct object *not_hash(struct interpreter_state *state, const char *position,
+                               const char *name, struct object *arg)
+{
+    return (struct object *) error_object_alloc(state, "%s argument to '%s' must be HASH, got %s",
+                                                position, name, object_type_str[arg->type]);
+}
+
+static struct object *not_hash_key(struct interpreter_state *state, const char *name,
+                                   struct object *arg)
+{
+    return (struct object *) error_object_alloc(state, "second argument to '%s' is unusable as hash key, got %s",
+                                                name, object_type_str[arg->type]);
+}
+
+static void add_key(struct object *key, struct object *value, void *cl)
+{
+    Seq_addhi(cl, key);
+}
+
+static void add_value(struct object *key, struct object *value, void *cl)
+{
+    Seq_addhi(cl, value);
+}
+
+/* keys and values list a hash in the same order. */
+static struct object *keys(struct interpreter_state *state, struct object *arg, void *cl)
+{
+    struct hash_object *hash = (struct hash_object *) arg;
+    Seq_T elements;
+
+    if (arg->type != HASH_OBJ)
+    {
+        return not_hash(state, "first", "keys", arg);
+    }
+    elements = Seq_new(hash->length);
+    hamt_map(hash->pairs, add_key, elements);
+    return (struct object *) array_object_alloc(state, elements);
+}
+
+static struct object *values(struct interpreter_state *state, struct object *arg, void *cl)
+{
+    struct hash_object *hash = (struct hash_object *) arg;
+    Seq_T elements;
+
+    if (arg->type != HASH_OBJ)
+    {
+        return not_hash(state, "first", "values", arg);
+    }
+    elements = Seq_new(hash->length);
+    hamt_map(hash->pairs, add_value, elements);
+    return (struct object *) array_object_alloc(state, elements);
+}
+
+static struct object *has(struct interpreter_state *state, struct object *arg,
+                          struct object *key, void *cl)
+{
+    if (arg->type != HASH_OBJ)
+    {
+        return not_hash(state, "first", "has", arg);
+    }
+    if (!is_object_hash_key(key))
+    {
+        return not_hash_key(state, "has", key);
+    }
+    return (struct object *) boolean_object_alloc(
+        hamt_get(((struct hash_object *) arg)->pairs, key) != NULL);
+}
+
+/*
+ * set, delete and merge leave their arguments as they were.  The hash
+ * they return shares every part of the trie the change did not touch,
+ * so each costs O(log n) for a hash of n pairs rather than a copy.
+ */
+static struct object *set(struct interpreter_state *state, struct object *arg,
+                          struct object *key, struct object *value, void *cl)
+{
+    struct hash_object *hash = (struct hash_object *) arg;
+    struct hamt_node *pairs;
+    bool added;
+
+    if (arg->type != HASH_OBJ)
+    {
+        return not_hash(state, "first", "set", arg);
+    }
+    if (!is_object_hash_key(key))
+    {
+        return not_hash_key(state, "set", key);
+    }
+    pairs = hamt_put(hamt_ref(hash->pairs), key, value, &added);
+    return (struct object *) hash_object_take(state, pairs, hash->length + added);
+}
+
+static struct object *delete(struct interpreter_state *state, struct object *arg,
+                             struct object *key, void *cl)
+{
+    struct hash_object *hash = (struct hash_object *) arg;
+    struct hamt_node *pairs;
+    bool removed;
+
+    if (arg->type != HASH_OBJ)
+    {
+        return not_hash(state, "first", "delete", arg);
+    }
+    if (!is_object_hash_key(key))
+    {
+        return not_hash_key(state, "delete", key);
+    }
+    pairs = hamt_remove(hamt_ref(hash->pairs), key, &removed);
+    if (!removed)
+    {
+        hamt_free(pairs);
+        return arg;
+    }
+    return (struct object *) hash_object_take(state, pairs, hash->length - 1);
+}
+
+struct merge
+{
+    struct hamt_node *pairs;
+    int length;
+};
+
+static void merge_pair(struct object *key, struct object *value, void *cl)
+{
+    struct merge *merge = cl;
+    bool added;
+
+    merge->pairs = hamt_put(merge->pairs, key, value, &added);
+    merge->length += added;
+}
+
+/* The pairs of both hashes; where a key is in both, the second's value wins. */
+static struct object *merge(struct interpreter_state *state, struct object *arg,
+                            struct object *other, void *cl)
+{
+    struct hash_object *hash = (struct hash_object *) arg;
+    struct merge merged;
+
+    if (arg->type != HASH_OBJ)
+    {
+        return not_hash(state, "first", "merge", arg);
+    }
+    if (other->type != HASH_OBJ)
+    {
+        return not_hash(state, "second", "merge", other);
     }
+    if (((struct hash_object *) other)->length == 0)
+    {
+        return arg;
+    }
+    if (hash->length == 0)
+    {
+        return other;
+    }
+    merged.pairs = hamt_ref(hash->pairs);
+    merged.length = hash->length;
+    hamt_map(((struct hash_object *) other)->pairs, merge_pair, &merged);
+    return (struct object *) hash_object_take(state, merged.pairs, merged.length);
+}
+
+static struct object *json_parse_builtin(struct interpreter_state *state, struct object *arg,
+                                         void *cl)
+{
+    if (arg->type != STRING_OBJ)
+    {
+        return not_string(state, "first", "json_parse", arg);
+    }
+    return json_parse(state, (struct string_object *) arg);
+}
+
+static struct object *json_stringify_builtin(struct interpreter_state *state, struct object *arg,
+                                             void *cl)
+{
+    return json_stringify(state, arg);
+}
+
+static struct object *not_sequence(struct interpreter_state *state, const char *name,
+                                   struct object *arg)
+{
+    return (struct object *) error_object_alloc(state, "first argument to '%s' must be ARRAY or RANGE, got %s",
+                                                name, object_type_str[arg->type]);
+}
+
+static struct object *not_iterable(struct interpreter_state *state, const char *name,
+                                   struct object *arg)
+{
+    return (struct object *) error_object_alloc(state, "first argument to '%s' must be ARRAY, RANGE or LINES, got %s",
+                                                name, object_type_str[arg->type]);
+}
+
+/*
+ * The higher-order builtins loop in C and reuse one argument buffer for
+ * every call to fn, so they run in linear time and constant C stack.
+ * They take anything iterable, so a range is never made into an array,
+ * and free what each call leaves behind as they go, so a loop over a
+ * file's lines runs in constant memory.
+ */
+static struct object *map(struct interpreter_state *state, struct object *arg,
+                          struct object *fn, void *cl)
+{
+    struct objects_scope scope;
+    struct iterator iterator;
+    Seq_T result;
+    struct object *argv[1];
+    struct object *object;
+
+    if (!is_iterable(arg))
+    {
+        return not_iterable(state, "map", arg);
+    }
+    iterator_init(&iterator, arg);
+    objects_scope_begin(state, &scope);
+    result = Seq_new(0);
+    while ((argv[0] = iterator_next(state, &iterator)) != NULL)
+    {
+        object = apply_function(state, fn, 1, argv);
+        if (object->type == ERROR_OBJ)
+        {
+            Seq_free(&result);
+            return object;
+        }
+        Seq_addhi(result, object);
+        objects_scope_collect(state, &scope, result, NULL);
+    }
+    return (struct object *) array_object_alloc(state, result);
+}
+
+static struct object *filter(struct interpreter_state *state, struct object *arg,
+                             struct object *fn, void *cl)
+{
+    struct objects_scope scope;
+    struct iterator iterator;
+    Seq_T result;
+    struct object *argv[1];
+    struct object *object;
+
+    if (!is_iterable(arg))
+    {
+        return not_iterable(state, "filter", arg);
+    }
+    iterator_init(&iterator, arg);
+    objects_scope_begin(state, &scope);
+    result = Seq_new(0);
+    while ((argv[0] = iterator_next(state, &iterator)) != NULL)
+    {
+        object = apply_function(state, fn, 1, argv);
+        if (object->type == ERROR_OBJ)
+        {
+            Seq_free(&result);
+            return object;
+        }
+        if (is_truthy(object))
+        {
+            Seq_addhi(result, argv[0]);
+        }
+        objects_scope_collect(state, &scope, result, NULL);
+    }
+    return (struct object *) array_object_alloc(state, result);
+}
+
+/* fn is called with the accumulated value and each element in turn. */
+static struct object *reduce(struct interpreter_state *state, struct object *arg,
+                             struct object *initial, struct object *fn, void *cl)
+{
+    struct objects_scope scope;
+    struct iterator iterator;
+    struct object *argv[2];
+
+    if (!is_iterable(arg))
+    {
+        return not_iterable(state, "reduce", arg);
+    }
+    iterator_init(&iterator, arg);
+    objects_scope_begin(state, &scope);
+    argv[0] = initial;
+    while ((argv[1] = iterator_next(state, &iterator)) != NULL)
+    {
+        argv[0] = apply_function(state, fn, 2, argv);
+        if (argv[0]->type == ERROR_OBJ)
+        {
+            break;
+        }
+        objects_scope_collect(state, &scope, NULL, argv[0]);
+    }
+    return argv[0];
 }
 
+static struct object *each(struct interpreter_state *state, struct object *arg,
+                           struct object *fn, void *cl)
+{
+    struct objects_scope scope;
+    struct iterator iterator;
+    struct object *argv[1];
+    struct object *object;
+
+    if (!is_iterable(arg))
+    {
+        return not_iterable(state, "each", arg);
+    }
+    iterator_init(&iterator, arg);
+    objects_scope_begin(state, &scope);
+    while ((argv[0] = iterator_next(state, &iterator)) != NULL)
+    {
+        object = apply_function(state, fn, 1, argv);
+        if (object->type == ERROR_OBJ)
+        {
+            return object;
+        }
+        objects_scope_collect(state, &scope, NULL, NULL);
+    }
+    return (struct object *) &null_object;
+}
+
+/* Fewer elements than this per thread are not worth a thread. */
+#define PMAP_MIN_SLICE 1024
+
+struct pmap_slice
+{
+    struct interpreter_state *state;
+    struct object *fn;
+    struct object *elements;
+    struct object **results;
+    int lo;
+    int hi;
+    /* The first element fn failed on, or hi. */
+    int failed;
+};
+
+static void *pmap_slice(void *arg)
+{
+    struct pmap_slice *slice = arg;
+    struct object *argv[1];
+
+    slice->failed = slice->hi;
+    for (int i = slice->lo; i < slice->hi; i++)
+    {
+        argv[0] = sequence_get(slice->state, slice->elements, i);
+        slice->results[i] = apply_function(slice->state, slice->fn, 1, argv);
+        if (slice->results[i]->type == ERROR_OBJ)
+        {
+            slice->failed = i;
+            break;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * map on several threads.  The array is cut into one slice per thread;
+ * the calling thread takes the first and every other slice runs in a
+ * fork of the interpreter, whose objects are handed back once all are
+ * done.  Monkey values are never changed once made, so fn can only see
+ * shared state through host builtins, which must then be thread safe.
+ * Small arrays, and any slice whose thread cannot be started, run on
+ * the calling thread.
+ */
+static struct object *pmap(struct interpreter_state *state, struct object *arg,
+                           struct object *fn, void *cl)
+{
+    struct pmap_slice *slices;
+    pthread_t *threads;
+    bool *started;
+    struct object **results;
+    struct object *object;
+    Seq_T result;
+    int nthreads;
+    int n;
+
+    if (!is_sequence(arg))
+    {
+        return not_sequence(state, "pmap", arg);
+    }
+    if (sequence_length(arg) > INT_MAX)
+    {
+        return (struct object *) error_object_alloc(state, "argument to 'pmap' is too long, got %lld",
+                                                    sequence_length(arg));
+    }
+    n = sequence_length(arg);
+    nthreads = state->threads > 0 ? state->threads : sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads > n / PMAP_MIN_SLICE)
+    {
+        nthreads = n / PMAP_MIN_SLICE;
+    }
+    if (nthreads <= 1)
+    {
+        return map(state, arg, fn, cl);
+    }
+    slices = CALLOC(nthreads, sizeof *slices);
+    threads = CALLOC(nthreads, sizeof *threads);
+    started = CALLOC(nthreads, sizeof *started);
+    results = CALLOC(n, sizeof *results);
+    for (int i = 0; i < nthreads; i++)
+    {
+        slices[i].state = i == 0 ? state : interpreter_state_fork(state);
+        slices[i].fn = fn;
+        slices[i].elements = arg;
+        slices[i].results = results;
+        slices[i].lo = (long long) n * i / nthreads;
+        slices[i].hi = (long long) n * (i + 1) / nthreads;
+        if (i > 0)
+        {
+            started[i] = pthread_create(&threads[i], NULL, pmap_slice, &slices[i]) == 0;
+        }
+    }
+    for (int i = 0; i < nthreads; i++)
+    {
+        if (!started[i])
+        {
+            pmap_slice(&slices[i]);
+        }
+    }
+    object = NULL;
+    for (int i = 0; i < nthreads; i++)
+    {
+        if (started[i])
+        {
+            pthread_join(threads[i], NULL);
+        }
+        if (i > 0)
+        {
+            interpreter_state_join(state, slices[i].state);
+        }
+        if (object == NULL && slices[i].failed < slices[i].hi)
+        {
+            object = results[slices[i].failed];
+        }
+    }
+    if (object == NULL)
+    {
+        result = Seq_new(n);
+        for (int i = 0; i < n; i++)
+        {
+            Seq_addhi(result, results[i]);
+        }
+        object = (struct object *) array_object_alloc(state, result);
+    }
+    FREE(results);
+    FREE(started);
+    FREE(threads);
+    FREE(slices);
+    return object;
+}
+
+/*
+ * Finds the integers of arg for the aggregate builtins.  An unboxed
+ * array is used in place; anything else is copied into *copy, which the
+ * caller frees.  Returns NULL, or the error if arg holds anything but
+ * integers.
+ */
+static struct object *integers(struct interpreter_state *state, const char *name,
+                               struct object *arg, const long long **ints, int *n,
+                               long long **copy)
+{
+    struct array_object *array;
+    struct object *object;
+
+    *copy = NULL;
+    if (!is_sequence(arg))
+    {
+        return (struct object *) error_object_alloc(state, "argument to '%s' must be ARRAY or RANGE, got %s",
+                                                    name, object_type_str[arg->type]);
+    }
+    if (sequence_length(arg) > INT_MAX)
+    {
+        return (struct object *) error_object_alloc(state, "argument to '%s' is too long, got %lld",
+                                                    name, sequence_length(arg));
+    }
+    *n = sequence_length(arg);
+    array = (struct array_object *) arg;
+    if (arg->type == ARRAY_OBJ && array->ints != NULL)
+    {
+        *ints = array->ints;
+        return NULL;
+    }
+    *copy = ALLOC((*n > 0 ? *n : 1) * sizeof **copy);
+    for (int i = 0; i < *n; i++)
+    {
+        if (arg->type == RANGE_OBJ)
+        {
+            (*copy)[i] = range_get((struct range_object *) arg, i);
+            continue;
+        }
+        object = (struct object *) Seq_get(array->elements, i);
+        if (object->type != INTEGER_OBJ)
+        {
+            FREE(*copy);
+            return (struct object *) error_object_alloc(state, "elements of '%s' must be INTEGER, got %s",
+                                                        name, object_type_str[object->type]);
+        }
+        (*copy)[i] = ((struct integer_object *) object)->value;
+    }
+    *ints = *copy;
+    return NULL;
+}
+
+enum aggregate
+{
+    SUM,
+    MIN,
+    MAX
+};
+
+/* The largest absolute value in ints, which holds n > 0 integers. */
+static unsigned long long magnitude(const struct aggregator *aggregator, const long long *ints,
+                                   int n)
+{
+    long long low = aggregator->min(ints, n);
+    long long high = aggregator->max(ints, n);
+    unsigned long long m1 = low < 0 ? -(unsigned long long) low : low;
+    unsigned long long m2 = high < 0 ? -(unsigned long long) high : high;
+
+    return m1 > m2 ? m1 : m2;
+}
+
+/* big, or total if there is no big yet, plus x, which it takes. */
+static AP_T add_big(AP_T big, long long total, AP_T x)
+{
+    AP_T sum;
+
+    if (big == NULL)
+    {
+        big = AP_new(total);
+    }
+    sum = AP_add(big, x);
+    AP_free(&big);
+    AP_free(&x);
+    return sum;
+}
+
+/*
+ * The aggregators wrap around on overflow, so they are used only when
+ * the magnitudes show the result fits.  Otherwise these checked loops
+ * run, and carry on in an AP_T from the first element that overflows.
+ */
+static struct object *exact_sum(struct interpreter_state *state, const long long *ints, int n)
+{
+    long long total = 0;
+    long long next;
+    AP_T big = NULL;
+
+    for (int i = 0; i < n; i++)
+    {
+        if (big == NULL && !__builtin_add_overflow(total, ints[i], &next))
+        {
+            total = next;
+        }
+        else
+        {
+            big = add_big(big, total, AP_new(ints[i]));
+        }
+    }
+    return big != NULL ? integer_object_from_ap(state, big)
+        : (struct object *) integer_object_alloc(state, total);
+}
+
+static struct object *exact_dot(struct interpreter_state *state, const long long *ints1,
+                                const long long *ints2, int n)
+{
+    long long total = 0;
+    long long product;
+    long long next;
+    AP_T big = NULL;
+    AP_T x;
+    AP_T y;
+
+    for (int i = 0; i < n; i++)
+    {
+        if (big == NULL && !__builtin_mul_overflow(ints1[i], ints2[i], &product)
+            && !__builtin_add_overflow(total, product, &next))
+        {
+            total = next;
+        }
+        else
+        {
+            x = AP_new(ints1[i]);
+            y = AP_new(ints2[i]);
+            big = add_big(big, total, AP_mul(x, y));
+            AP_free(&y);
+            AP_free(&x);
+        }
+    }
+    return big != NULL ? integer_object_from_ap(state, big)
+        : (struct object *) integer_object_alloc(state, total);
+}
+
+/* Sums are exact, however large; min and max of nothing are null. */
+static struct object *aggregate(struct interpreter_state *state, const char *name,
+                                struct object *arg, enum aggregate op)
+{
+    const struct aggregator *aggregator = aggregator_best();
+    const long long *ints;
+    long long *copy;
+    long long value;
+    struct object *object;
+    int n;
+
+    if ((object = integers(state, name, arg, &ints, &n, &copy)) != NULL)
+    {
+        return object;
+    }
+    if (n == 0)
+    {
+        FREE(copy);
+        return op == SUM ? (struct object *) integer_object_alloc(state, 0)
+            : (struct object *) &null_object;
+    }
+    switch (op)
+    {
+    case SUM:
+    {
+        if (magnitude(aggregator, ints, n) > LLONG_MAX / n)
+        {
+            object = exact_sum(state, ints, n);
+            FREE(copy);
+            return object;
+        }
+        value = aggregator->sum(ints, n);
+        break;
+    }
+    case MIN:
+    {
+        value = aggregator->min(ints, n);
+        break;
+    }
+    default:
+    {
+        value = aggregator->max(ints, n);
+        break;
+    }
+    }
+    FREE(copy);
+    return (struct object *) integer_object_alloc(state, value);
+}
+
+static struct object *sum(struct interpreter_state *state, struct object *arg, void *cl)
+{
+    return aggregate(state, "sum", arg, SUM);
+}
+
+static struct object *min(struct interpreter_state *state, struct object *arg, void *cl)
+{
+    return aggregate(state, "min", arg, MIN);
+}
+
+static struct object *max(struct interpreter_state *state, struct object *arg, void *cl)
+{
+    return aggregate(state, "max", arg, MAX);
+}
+
+static struct object *dot(struct interpreter_state *state, struct object *arg1,
+                          struct object *arg2, void *cl)
+{
+    const struct aggregator *aggregator = aggregator_best();
+    const long long *ints1;
+    const long long *ints2;
+    long long *copy1;
+    long long *copy2 = NULL;
+    unsigned long long m1;
+    unsigned long long m2;
+    struct object *object;
+    int n1;
+    int n2;
+
+    if ((object = integers(state, "dot", arg1, &ints1, &n1, &copy1)) != NULL
+        || (object = integers(state, "dot", arg2, &ints2, &n2, &copy2)) != NULL)
+    {
+        FREE(copy1);
+        return object;
+    }
+    if (n1 != n2)
+    {
+        object = (struct object *) error_object_alloc(state, "arguments to 'dot' must have the same length, got=%d and %d",
+                                                      n1, n2);
+    }
+    else if (n1 > 0 && (m1 = magnitude(aggregator, ints1, n1)) > 0
+             && (m2 = magnitude(aggregator, ints2, n2)) > LLONG_MAX / m1 / n1)
+    {
+        object = exact_dot(state, ints1, ints2, n1);
+    }
+    else
+    {
+        object = (struct object *) integer_object_alloc(state, aggregator->dot(ints1, ints2, n1));
+    }
+    FREE(copy2);
+    FREE(copy1);
+    return object;
+}
+
+/* range(end), range(start, end) or range(start, end, step). */
+static struct object *range(struct interpreter_state *state, int argc,
+                            struct object **argv, void *cl)
+{
+    long long bounds[3] = { 0, 0, 1 };
+
+    if (argc < 1 || argc > 3)
+    {
+        return (struct object *) error_object_alloc(state, "wrong number of arguments. got=%d, want=1 to 3",
+                                                    argc);
+    }
+    for (int i = 0; i < argc; i++)
+    {
+        if (argv[i]->type != INTEGER_OBJ)
+        {
+            return (struct object *) error_object_alloc(state, "arguments to 'range' must be INTEGER, got %s",
+                                                        object_type_str[argv[i]->type]);
+        }
+        bounds[argc == 1 ? 1 : i] = ((struct integer_object *) argv[i])->value;
+    }
+    if (bounds[2] == 0)
+    {
+        return (struct object *) error_object_alloc(state, "step of 'range' must not be 0");
+    }
+    return (struct object *) range_object_alloc(state, bounds[0], bounds[1], bounds[2]);
+}
+
+struct sort_callback
+{
+    struct interpreter_state *state;
+    struct object *fn;
+    /* The first error fn returned; later comparisons are skipped. */
+    struct object *error;
+};
+
+static bool callback_less(struct object *a, struct object *b, void *cl)
+{
+    struct sort_callback *callback = cl;
+    struct object *argv[2] = { a, b };
+    struct object *object;
+
+    if (callback->error != NULL)
+    {
+        return false;
+    }
+    object = apply_function(callback->state, callback->fn, 2, argv);
+    if (object->type == ERROR_OBJ)
+    {
+        callback->error = object;
+        return false;
+    }
+    return is_truthy(object);
+}
+
+static bool string_less(struct object *a, struct object *b, void *cl)
+{
+    return string_cmp((struct string_object *) a, (struct string_object *) b) < 0;
+}
+
+/*
+ * sort(arr) orders integers or strings ascending without calling back
+ * into Monkey; sort(arr, less) orders by less(a, b), which is true when
+ * a must come first.  Both return a new array.
+ */
+static struct object *sort_sequence(struct interpreter_state *state, const char *name,
+                                    int argc, struct object **argv, bool stable)
+{
+    struct sort_callback callback = { state, NULL, NULL };
+    struct object **objects;
+    struct object *object;
+    const long long *ints;
+    long long *copy;
+    Seq_T elements;
+    int n;
+
+    if (argc < 1 || argc > 2)
+    {
+        return (struct object *) error_object_alloc(state, "wrong number of arguments. got=%d, want=1 or 2",
+                                                    argc);
+    }
+    if (!is_sequence(argv[0]))
+    {
+        return not_sequence(state, name, argv[0]);
+    }
+    if (sequence_length(argv[0]) == 0)
+    {
+        return (struct object *) array_object_alloc(state, Seq_new(0));
+    }
+    if (argc == 1 && (argv[0]->type == RANGE_OBJ || ((struct array_object *) argv[0])->ints != NULL))
+    {
+        if ((object = integers(state, name, argv[0], &ints, &n, &copy)) != NULL)
+        {
+            return object;
+        }
+        if (copy == NULL)
+        {
+            copy = ALLOC(n * sizeof *copy);
+            memcpy(copy, ints, n * sizeof *copy);
+        }
+        sort_ints(copy, n);
+        return (struct object *) int_array_object_alloc(state, copy, n);
+    }
+    if (sequence_length(argv[0]) > INT_MAX)
+    {
+        return (struct object *) error_object_alloc(state, "argument to '%s' is too long, got %lld",
+                                                    name, sequence_length(argv[0]));
+    }
+    n = sequence_length(argv[0]);
+    objects = ALLOC(n * sizeof *objects);
+    for (int i = 0; i < n; i++)
+    {
+        objects[i] = sequence_get(state, argv[0], i);
+        if (argc == 1 && objects[i]->type != STRING_OBJ)
+        {
+            object = (struct object *) error_object_alloc(state, "elements of '%s' must all be INTEGER or all STRING, got %s",
+                                                          name, object_type_str[objects[i]->type]);
+            FREE(objects);
+            return object;
+        }
+    }
+    if (argc == 1)
+    {
+        sort_objects(objects, n, string_less, NULL);
+    }
+    else
+    {
+        callback.fn = argv[1];
+        if (stable)
+        {
+            sort_objects_stable(objects, n, callback_less, &callback);
+        }
+        else
+        {
+            sort_objects(objects, n, callback_less, &callback);
+        }
+    }
+    if (callback.error != NULL)
+    {
+        FREE(objects);
+        return callback.error;
+    }
+    elements = Seq_new(n);
+    for (int i = 0; i < n; i++)
+    {
+        Seq_addhi(elements, objects[i]);
+    }
+    FREE(objects);
+    return (struct object *) array_object_alloc(state, elements);
+}
+
+static struct object *sort(struct interpreter_state *state, int argc,
+                           struct object **argv, void *cl)
+{
+    return sort_sequence(state, "sort", argc, argv, false);
+}
+
+/* Like sort, but elements that are not less than each other keep their order. */
+static struct object *sort_stable(struct interpreter_state *state, int argc,
+                                  struct object **argv, void *cl)
+{
+    return sort_sequence(state, "sort_stable", argc, argv, true);
+}
+
+static struct object *read_lines(struct interpreter_state *state, struct object *path, void *cl)
+{
+    const char *name;
+    int fd;
+
+    if (path->type != STRING_OBJ)
+    {
+        return not_string(state, "first", "read_lines", path);
+    }
+    name = string_object_cstr((struct string_object *) path);
+    if ((fd = open(name, O_RDONLY)) < 0)
+    {
+        return (struct object *) error_object_alloc(state, "cannot open %.80s: %s", name,
+                                                    strerror(errno));
+    }
+    return (struct object *) lines_object_alloc(state, fd, name);
+}
+
+/* Bytes write_file and append_file gather before each write. */
+#define WRITE_BUFFER (1 << 16)
+
+/*
+ * Writes a string as it is, or the strings of an array or lines one
+ * per line, and returns how many bytes that was.  Lines from
+ * read_lines are written as they are read, so copying a file never
+ * holds it whole.
+ */
+static struct object *write_to(struct interpreter_state *state, const char *name,
+                               const char *mode, struct object *path, struct object *content)
+{
+    struct objects_scope scope;
+    struct iterator iterator;
+    struct string_object *line;
+    struct object *error = NULL;
+    const char *file_name;
+    long long written = 0;
+    FILE *file;
+
+    if (path->type != STRING_OBJ)
+    {
+        return not_string(state, "first", name, path);
+    }
+    if (content->type != STRING_OBJ && !is_iterable(content))
+    {
+        return (struct object *) error_object_alloc(state, "second argument to '%s' must be STRING, ARRAY or LINES, got %s",
+                                                    name, object_type_str[content->type]);
+    }
+    file_name = string_object_cstr((struct string_object *) path);
+    if ((file = fopen(file_name, mode)) == NULL)
+    {
+        return (struct object *) error_object_alloc(state, "cannot open %.80s: %s", file_name,
+                                                    strerror(errno));
+    }
+    setvbuf(file, NULL, _IOFBF, WRITE_BUFFER);
+    if (content->type == STRING_OBJ)
+    {
+        line = (struct string_object *) content;
+        written = fwrite(line->value, 1, line->length, file);
+    }
+    else
+    {
+        iterator_init(&iterator, content);
+        objects_scope_begin(state, &scope);
+        while ((line = (struct string_object *) iterator_next(state, &iterator)) != NULL)
+        {
+            if (line->type != STRING_OBJ)
+            {
+                error = (struct object *) error_object_alloc(state, "elements of second argument to '%s' must be STRING, got %s",
+                                                             name, object_type_str[line->type]);
+                break;
+            }
+            written += fwrite(line->value, 1, line->length, file);
+            written += fputc('\n', file) != EOF;
+            objects_scope_collect(state, &scope, NULL, NULL);
+        }
+    }
+    if ((ferror(file) | fclose(file)) != 0 && error == NULL)
+    {
+        error = (struct object *) error_object_alloc(state, "cannot write %.80s: %s", file_name,
+                                                     strerror(errno));
+    }
+    return error != NULL ? error : (struct object *) integer_object_alloc(state, written);
+}
+
+static struct object *write_file(struct interpreter_state *state, struct object *path,
+                                 struct object *content, void *cl)
+{
+    return write_to(state, "write_file", "w", path, content);
+}
+
+static struct object *append_file(struct interpreter_state *state, struct object *path,
+                                  struct object *content, void *cl)
+{
+    return write_to(state, "append_file", "a", path, content);
+}
+
+/* Values are written straight into the output, so nothing is built to print them. */
+static struct object *putz(struct interpreter_state *state, int argc,
+                           struct object **argv, void *cl)
+{
+    for (int i = 0; i < argc; i++)
+    {
+        object_write(argv[i], &state->output);
+        output_line(&state->output);
+    }
+    return (struct object *) &null_object;
+}
+
+static struct object *flush(struct interpreter_state *state, int argc,
+                            struct object **argv, void *cl)
+{
+    if (argc != 0)
+    {
+        return (struct object *) error_object_alloc(state, "wrong number of arguments. got=%d, want=0",
+                                                    argc);
+    }
+    output_flush(&state->output);
+    return (struct object *) &null_object;
+}
+
+struct object *builtins_get(struct interpreter_state *state,
+                            struct identifier *identifier)
+{
+    return (struct object *) Table_get(state->builtins, &identifier->value);
+}
+
+/* The builtin objects are never written, so every interpreter shares them. */
+void builtins_init(struct interpreter_state *state)
+{
+    static struct identifier_builtin
+    {
+        Text_T identifier;
+        struct builtin_object builtin;
+    } identifier_builtins[] =
+      {
+          { {sizeof "len" - 1, "len"}, {BUILTIN_OBJ, 1, .arity = 1, .fixed.one = len} },
+          { {sizeof "first" - 1, "first"}, {BUILTIN_OBJ, 1, .arity = 1, .fixed.one = first} },
+          { {sizeof "last" - 1, "last"}, {BUILTIN_OBJ, 1, .arity = 1, .fixed.one = last} },
+          { {sizeof "rest" - 1, "rest"}, {BUILTIN_OBJ, 1, .arity = 1, .fixed.one = rest} },
+          { {sizeof "push" - 1, "push"}, {BUILTIN_OBJ, 1, .arity = 2, .fixed.two = push} },
+          { {sizeof "puts" - 1, "puts"}, {BUILTIN_OBJ, 1, .native = putz} },
+          { {sizeof "flush" - 1, "flush"}, {BUILTIN_OBJ, 1, .native = flush} },
+          { {sizeof "map" - 1, "map"}, {BUILTIN_OBJ, 1, .arity = 2, .fixed.two = map} },
+          { {sizeof "filter" - 1, "filter"}, {BUILTIN_OBJ, 1, .arity = 2, .fixed.two = filter} },
+          { {sizeof "reduce" - 1, "reduce"}, {BUILTIN_OBJ, 1, .arity = 3, .fixed.three = reduce} },
+          { {sizeof "each" - 1, "each"}, {BUILTIN_OBJ, 1, .arity = 2, .fixed.two = each} },
+          { {sizeof "pmap" - 1, "pmap"}, {BUILTIN_OBJ, 1, .arity = 2, .fixed.two = pmap} },
+          { {sizeof "range" - 1, "range"}, {BUILTIN_OBJ, 1, .native = range} },
+          { {sizeof "sum" - 1, "sum"}, {BUILTIN_OBJ, 1, .arity = 1, .fixed.one = sum} },
+          { {sizeof "min" - 1, "min"}, {BUILTIN_OBJ, 1, .arity = 1, .fixed.one = min} },
+          { {sizeof "max" - 1, "max"}, {BUILTIN_OBJ, 1, .arity = 1, .fixed.one = max} },
+          { {sizeof "dot" - 1, "dot"}, {BUILTIN_OBJ, 1, .arity = 2, .fixed.two = dot} },
+          { {sizeof "sort" - 1, "sort"}, {BUILTIN_OBJ, 1, .native = sort} },
+          { {sizeof "sort_stable" - 1, "sort_stable"}, {BUILTIN_OBJ, 1, .native = sort_stable} },
+          { {sizeof "split" - 1, "split"}, {BUILTIN_OBJ, 1, .arity = 2, .fixed.two = split} },
+          { {sizeof "join" - 1, "join"}, {BUILTIN_OBJ, 1, .arity = 2, .fixed.two = join} },
+          { {sizeof "substr" - 1, "substr"}, {BUILTIN_OBJ, 1, .native = substr} },
+          { {sizeof "index_of" - 1, "index_of"}, {BUILTIN_OBJ, 1, .arity = 2, .fixed.two = index_of} },
+          { {sizeof "replace" - 1, "replace"}, {BUILTIN_OBJ, 1, .arity = 3, .fixed.three = replace} },
+          { {sizeof "starts_with" - 1, "starts_with"}, {BUILTIN_OBJ, 1, .arity = 2, .fixed.two = starts_with} },
+          { {sizeof "keys" - 1, "keys"}, {BUILTIN_OBJ, 1, .arity = 1, .fixed.one = keys} },
+          { {sizeof "values" - 1, "values"}, {BUILTIN_OBJ, 1, .arity = 1, .fixed.one = values} },
+          { {sizeof "has" - 1, "has"}, {BUILTIN_OBJ, 1, .arity = 2, .fixed.two = has} },
+          { {sizeof "set" - 1, "set"}, {BUILTIN_OBJ, 1, .arity = 3, .fixed.three = set} },
+          { {sizeof "delete" - 1, "delete"}, {BUILTIN_OBJ, 1, .arity = 2, .fixed.two = delete} },
+          { {sizeof "merge" - 1, "merge"}, {BUILTIN_OBJ, 1, .arity = 2, .fixed.two = merge} },
+          { {sizeof "json_parse" - 1, "json_parse"}, {BUILTIN_OBJ, 1, .arity = 1, .fixed.one = json_parse_builtin} },
+          { {sizeof "json_stringify" - 1, "json_stringify"}, {BUILTIN_OBJ, 1, .arity = 1, .fixed.one = json_stringify_builtin} },
+          { {sizeof "read_lines" - 1, "read_lines"}, {BUILTIN_OBJ, 1, .arity = 1, .fixed.one = read_lines} },
+          { {sizeof "write_file" - 1, "write_file"}, {BUILTIN_OBJ, 1, .arity = 2, .fixed.two = write_file} },
+          { {sizeof "append_file" - 1, "append_file"}, {BUILTIN_OBJ, 1, .arity = 2, .fixed.two = append_file} }
+      };
+    state->builtins = Table_new(0, text_cmp, text_hash);
+    state->natives = Seq_new(0);
+    for (int i = 0; i < sizeof identifier_builtins / sizeof identifier_builtins[0]; i++)
+    {
+        Table_put(state->builtins, &identifier_builtins[i].identifier,
+                  &identifier_builtins[i].builtin);
+    }
+}
+
+/* A registered builtin owns its name, which keys it in state->builtins. */
+struct native_builtin
+{
+    Text_T name;
+    struct builtin_object builtin;
+};
+
+/* Shared by every interpreter, so no two sets of builtins get the same version. */
+static unsigned builtins_versions;
+
+static void register_builtin(struct interpreter_state *state, const char *name,
+                             struct builtin_object *template)
+{
+    struct native_builtin *registered;
+    Text_T text;
+
+    template->type = BUILTIN_OBJ;
+    template->marked = true;
+    text = Text_box(name, strlen(name));
+    for (int i = 0; i < Seq_length(state->natives); i++)
+    {
+        registered = Seq_get(state->natives, i);
+        if (text_cmp(&registered->name, &text) == 0)
+        {
+            registered->builtin = *template;
+            return;
+        }
+    }
+    /* Replaces a language builtin of the same name, if there is one. */
+    Table_remove(state->builtins, &text);
+    state->builtins_version = __atomic_add_fetch(&builtins_versions, 1, __ATOMIC_RELAXED);
+    NEW0(registered);
+    registered->name = Text_box(Text_get(NULL, 0, text), text.len);
+    registered->builtin = *template;
+    Seq_addhi(state->natives, registered);
+    Table_put(state->builtins, &registered->name, &registered->builtin);
+}
+
+void builtins_register(struct interpreter_state *state, const char *name,
+                       native_fn native, void *cl)
+{
+    struct builtin_object builtin = { .native = native, .cl = cl };
+
+    register_builtin(state, name, &builtin);
+}
+
+void builtins_register1(struct interpreter_state *state, const char *name,
+                        native1_fn fn, void *cl)
+{
+    struct builtin_object builtin = { .arity = 1, .fixed.one = fn, .cl = cl };
+
+    register_builtin(state, name, &builtin);
+}
+
+void builtins_register2(struct interpreter_state *state, const char *name,
+                        native2_fn fn, void *cl)
+{
+    struct builtin_object builtin = { .arity = 2, .fixed.two = fn, .cl = cl };
+
+    register_builtin(state, name, &builtin);
+}
+
+void builtins_register3(struct interpreter_state *state, const char *name,
+                        native3_fn fn, void *cl)
+{
+    struct builtin_object builtin = { .arity = 3, .fixed.three = fn, .cl = cl };
+
+    register_builtin(state, name, &builtin);
+}
+
+void builtins_destroy(struct interpreter_state *state)
+{
+    struct native_builtin *registered;
+    char *c;
+
+    while (Seq_length(state->natives) > 0)
+    {
+        registered = Seq_remlo(state->natives);
+        c = (char *) registered->name.str;
+        FREE(c);
+        FREE(registered);
+    }
+    Seq_free(&state->natives);
+    Table_free(&state->builtins);
+}
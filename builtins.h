@@ -6,7 +6,18 @@
 #include "ast.h"
 #include "object.h"
 
-void builtins_init(void);
-struct object *builtins_get(struct identifier *identifier);
+void builtins_init(struct interpreter_state *state);
+void builtins_destroy(struct interpreter_state *state);
+struct object *builtins_get(struct interpreter_state *state,
+                            struct identifier *identifier);
+/* Each adds or replaces the builtin called name for this interpreter only. */
+void builtins_register(struct interpreter_state *state, const char *name,
+                       native_fn native, void *cl);
+void builtins_register1(struct interpreter_state *state, const char *name,
+                        native1_fn fn, void *cl);
+void builtins_register2(struct interpreter_state *state, const char *name,
+                        native2_fn fn, void *cl);
+void builtins_register3(struct interpreter_state *state, const char *name,
+                        native3_fn fn, void *cl);
 
 #endif
@@ -0,0 +1,945 @@
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <mem.h>
+#include <table.h>
+
+#include "cache.h"
+#include "util.h"
+
+#define CACHE_MAGIC "MKYC"
+/* Bump whenever the node encoding or the AST changes. */
+#define CACHE_VERSION 3
+#define BYTE_ORDER_MARK 0x01020304u
+#define NULL_NODE 0xff
+#define NULL_SEQ 0xffffffffu
+/* Deeper nesting than this is treated as a corrupt file. */
+#define MAX_DEPTH 10000
+
+struct cache_header
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t statements;
+    uint64_t source_size;
+    int64_t source_mtime;
+    int64_t source_mtime_nsec;
+    uint64_t source_hash;
+    uint64_t strings_offset;
+    uint32_t strings;
+    uint32_t reserved;
+};
+
+struct cache_writer
+{
+    char *path;
+    char *tmp_path;
+    FILE *file;
+    const struct stat *st;
+    const char *source;
+    Table_T strings;
+    Seq_T order;
+    uint32_t statements;
+    bool failed;
+};
+
+struct reader
+{
+    const unsigned char *p;
+    const unsigned char *end;
+    Text_T *strings;
+    uint32_t nstrings;
+    Arena_T arena;
+    Seq_T seqs;
+    int depth;
+    bool failed;
+};
+
+static uint64_t source_hash(const char *source, size_t size)
+{
+    uint64_t h = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        h ^= (unsigned char) source[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/* Identifiers differ in few characters; text_hash clusters them. */
+static unsigned string_hash(const void *x)
+{
+    const Text_T *t = x;
+
+    return source_hash(t->str, t->len);
+}
+
+static void put(struct cache_writer *writer, const void *p, size_t n)
+{
+    if (!writer->failed && fwrite(p, 1, n, writer->file) != n)
+    {
+        writer->failed = true;
+    }
+}
+
+static void put_u8(struct cache_writer *writer, uint8_t v)
+{
+    put(writer, &v, sizeof v);
+}
+
+static void put_u32(struct cache_writer *writer, uint32_t v)
+{
+    put(writer, &v, sizeof v);
+}
+
+static void put_i64(struct cache_writer *writer, int64_t v)
+{
+    put(writer, &v, sizeof v);
+}
+
+static void put_text(struct cache_writer *writer, Text_T text)
+{
+    Text_T *key;
+    uintptr_t index;
+
+    index = (uintptr_t) Table_get(writer->strings, &text);
+    if (index == 0)
+    {
+        NEW(key);
+        *key = Text_box(Text_get(NULL, 0, text), text.len);
+        Seq_addhi(writer->order, key);
+        index = Seq_length(writer->order);
+        Table_put(writer->strings, key, (void *) index);
+    }
+    put_u32(writer, index - 1);
+}
+
+static void put_expression(struct cache_writer *writer,
+                           struct expression *expression);
+static void put_statement(struct cache_writer *writer,
+                          struct statement *statement);
+
+static void put_expressions(struct cache_writer *writer, Seq_T expressions)
+{
+    if (expressions == NULL)
+    {
+        put_u32(writer, NULL_SEQ);
+        return;
+    }
+    put_u32(writer, Seq_length(expressions));
+    for (int i = 0; i < Seq_length(expressions); i++)
+    {
+        put_expression(writer, Seq_get(expressions, i));
+    }
+}
+
+static void put_node_header(struct cache_writer *writer, enum node_type type,
+                            struct token token)
+{
+    put_u8(writer, type);
+    put_u8(writer, token.type);
+    put_text(writer, token.literal);
+}
+
+static void put_expression(struct cache_writer *writer,
+                           struct expression *expression)
+{
+    if (expression == NULL)
+    {
+        put_u8(writer, NULL_NODE);
+        return;
+    }
+    put_node_header(writer, expression->type, expression->token);
+    switch (expression->type)
+    {
+    case IDENT_EXPR:
+    {
+        put_text(writer, ((struct identifier *) expression)->value);
+        break;
+    }
+    case STRING_LITERAL_EXPR:
+    {
+        put_text(writer, ((struct string_literal *) expression)->value);
+        break;
+    }
+    case INT_LITERAL_EXPR:
+    {
+        put_i64(writer, ((struct integer_literal *) expression)->value);
+        put_u8(writer, ((struct integer_literal *) expression)->big);
+        break;
+    }
+    case ARRAY_LITERAL_EXPR:
+    {
+        put_expressions(writer, ((struct array_literal *) expression)->elements);
+        break;
+    }
+    case HASH_LITERAL_EXPR:
+    {
+        struct hash_literal *hash = (struct hash_literal *) expression;
+
+        put_expressions(writer, hash->keys);
+        put_expressions(writer, hash->values);
+        break;
+    }
+    case FUNC_LITERAL_EXPR:
+    {
+        struct function_literal *function = (struct function_literal *) expression;
+
+        put_expressions(writer, function->parameters);
+        put_statement(writer, (struct statement *) function->body);
+        break;
+    }
+    case BOOL_EXPR:
+    {
+        put_u8(writer, ((struct boolean *) expression)->value);
+        break;
+    }
+    case INDEX_EXPR:
+    {
+        struct index_expression *index = (struct index_expression *) expression;
+
+        put_expression(writer, index->left);
+        put_expression(writer, index->index);
+        break;
+    }
+    case SLICE_EXPR:
+    {
+        struct slice_expression *slice = (struct slice_expression *) expression;
+
+        put_expression(writer, slice->left);
+        put_expression(writer, slice->start);
+        put_expression(writer, slice->end);
+        break;
+    }
+    case PREFIX_EXPR:
+    {
+        struct prefix_expression *prefix = (struct prefix_expression *) expression;
+
+        put_text(writer, prefix->op);
+        put_expression(writer, prefix->right);
+        break;
+    }
+    case INFIX_EXPR:
+    {
+        struct infix_expression *infix = (struct infix_expression *) expression;
+
+        put_expression(writer, infix->left);
+        put_text(writer, infix->op);
+        put_expression(writer, infix->right);
+        break;
+    }
+    case IF_EXPR:
+    {
+        struct if_expression *ife = (struct if_expression *) expression;
+
+        put_expression(writer, ife->condition);
+        put_statement(writer, (struct statement *) ife->consequence);
+        put_statement(writer, (struct statement *) ife->alternative);
+        break;
+    }
+    case CALL_EXPR:
+    {
+        struct call_expression *call = (struct call_expression *) expression;
+
+        put_expression(writer, call->function);
+        put_expressions(writer, call->arguments);
+        break;
+    }
+    default:
+    {
+        writer->failed = true;
+        break;
+    }
+    }
+}
+
+static void put_statement(struct cache_writer *writer,
+                          struct statement *statement)
+{
+    if (statement == NULL)
+    {
+        put_u8(writer, NULL_NODE);
+        return;
+    }
+    put_node_header(writer, statement->type, statement->token);
+    switch (statement->type)
+    {
+    case LET_STMT:
+    {
+        struct let_statement *let = (struct let_statement *) statement;
+
+        put_expression(writer, (struct expression *) let->name);
+        put_expression(writer, let->value);
+        break;
+    }
+    case RETURN_STMT:
+    {
+        put_expression(writer, ((struct return_statement *) statement)->return_value);
+        break;
+    }
+    case EXPR_STMT:
+    {
+        put_expression(writer, ((struct expression_statement *) statement)->expression);
+        break;
+    }
+    case BLOCK_STMT:
+    {
+        Seq_T statements = ((struct block_statement *) statement)->statements;
+
+        put_u32(writer, Seq_length(statements));
+        for (int i = 0; i < Seq_length(statements); i++)
+        {
+            put_statement(writer, Seq_get(statements, i));
+        }
+        break;
+    }
+    default:
+    {
+        writer->failed = true;
+        break;
+    }
+    }
+}
+
+/*
+ * Writes to a temporary file that only replaces the cache once the whole
+ * script has been written, so a reader never sees a partial file.
+ */
+struct cache_writer *cache_writer_alloc(const char *path, const struct stat *st,
+                                       const char *source)
+{
+    struct cache_writer *writer;
+    struct cache_header header = { { 0 } };
+    size_t len = strlen(path);
+
+    NEW0(writer);
+    writer->path = ALLOC(len + sizeof CACHE_SUFFIX);
+    memcpy(writer->path, path, len);
+    memcpy(writer->path + len, CACHE_SUFFIX, sizeof CACHE_SUFFIX);
+    writer->tmp_path = ALLOC(len + sizeof CACHE_SUFFIX + 16);
+    sprintf(writer->tmp_path, "%s.%ld", writer->path, (long) getpid());
+    writer->file = fopen(writer->tmp_path, "wb");
+    if (writer->file == NULL)
+    {
+        FREE(writer->tmp_path);
+        FREE(writer->path);
+        FREE(writer);
+        return NULL;
+    }
+    writer->st = st;
+    writer->source = source;
+    writer->strings = Table_new(65536, text_cmp, string_hash);
+    writer->order = Seq_new(1024);
+    /* The header is rewritten once the counts are known. */
+    put(writer, &header, sizeof header);
+    return writer;
+}
+
+void cache_writer_add(struct cache_writer *writer, struct statement *statement)
+{
+    put_statement(writer, statement);
+    writer->statements++;
+}
+
+static void writer_free(struct cache_writer *writer)
+{
+    Text_T *text;
+    char *c;
+
+    for (int i = 0; i < Seq_length(writer->order); i++)
+    {
+        text = Seq_get(writer->order, i);
+        c = (char *) text->str;
+        FREE(c);
+        FREE(text);
+    }
+    Seq_free(&writer->order);
+    Table_free(&writer->strings);
+    FREE(writer->tmp_path);
+    FREE(writer->path);
+    FREE(writer);
+}
+
+void cache_writer_commit(struct cache_writer *writer)
+{
+    const struct stat *st = writer->st;
+    struct cache_header header = { { 0 } };
+    Text_T *text;
+    long offset;
+
+    offset = ftell(writer->file);
+    for (int i = 0; i < Seq_length(writer->order); i++)
+    {
+        text = Seq_get(writer->order, i);
+        put_u32(writer, text->len);
+        put(writer, text->str, text->len);
+        put_u8(writer, '\0');
+    }
+    memcpy(header.magic, CACHE_MAGIC, sizeof header.magic);
+    header.version = CACHE_VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.statements = writer->statements;
+    header.source_size = st->st_size;
+    header.source_mtime = st->st_mtim.tv_sec;
+    header.source_mtime_nsec = st->st_mtim.tv_nsec;
+    header.source_hash = source_hash(writer->source, st->st_size);
+    header.strings_offset = offset;
+    header.strings = Seq_length(writer->order);
+    if (offset < 0 || fseek(writer->file, 0, SEEK_SET) != 0)
+    {
+        writer->failed = true;
+    }
+    put(writer, &header, sizeof header);
+    if (fclose(writer->file) != 0 || writer->failed
+        || rename(writer->tmp_path, writer->path) != 0)
+    {
+        remove(writer->tmp_path);
+    }
+    writer_free(writer);
+}
+
+void cache_writer_abort(struct cache_writer *writer)
+{
+    fclose(writer->file);
+    remove(writer->tmp_path);
+    writer_free(writer);
+}
+
+static bool get(struct reader *reader, void *p, size_t n)
+{
+    if (reader->failed || (size_t) (reader->end - reader->p) < n)
+    {
+        reader->failed = true;
+        memset(p, 0, n);
+        return false;
+    }
+    memcpy(p, reader->p, n);
+    reader->p += n;
+    return true;
+}
+
+static uint8_t get_u8(struct reader *reader)
+{
+    uint8_t v;
+
+    get(reader, &v, sizeof v);
+    return v;
+}
+
+static uint32_t get_u32(struct reader *reader)
+{
+    uint32_t v;
+
+    get(reader, &v, sizeof v);
+    return v;
+}
+
+static int64_t get_i64(struct reader *reader)
+{
+    int64_t v;
+
+    get(reader, &v, sizeof v);
+    return v;
+}
+
+static Text_T get_text(struct reader *reader)
+{
+    uint32_t index = get_u32(reader);
+
+    if (index >= reader->nstrings)
+    {
+        reader->failed = true;
+        return (Text_T) { 0, "" };
+    }
+    return reader->strings[index];
+}
+
+#define ANEW(reader, p) \
+    ((p) = Arena_calloc((reader)->arena, 1, sizeof *(p), __FILE__, __LINE__))
+
+static struct expression *get_expression(struct reader *reader);
+static struct statement *get_statement(struct reader *reader);
+
+static Seq_T get_expressions(struct reader *reader)
+{
+    uint32_t n = get_u32(reader);
+    Seq_T expressions;
+
+    if (n == NULL_SEQ || reader->failed)
+    {
+        return NULL;
+    }
+    /* Every expression takes more than a byte, so n is bounded by the file. */
+    if (n > (size_t) (reader->end - reader->p))
+    {
+        reader->failed = true;
+        return NULL;
+    }
+    expressions = Seq_new(n);
+    Seq_addhi(reader->seqs, expressions);
+    for (uint32_t i = 0; i < n && !reader->failed; i++)
+    {
+        Seq_addhi(expressions, get_expression(reader));
+    }
+    return expressions;
+}
+
+static struct block_statement *get_block(struct reader *reader, bool optional)
+{
+    struct statement *statement = get_statement(reader);
+
+    if ((statement == NULL && !optional)
+        || (statement != NULL && statement->type != BLOCK_STMT))
+    {
+        reader->failed = true;
+        return NULL;
+    }
+    return (struct block_statement *) statement;
+}
+
+/*
+ * Each node is read into the arena in place of its *_alloc function;
+ * the strings it holds live in the mapped file.
+ */
+static struct expression *get_expression(struct reader *reader)
+{
+    struct expression *expression = NULL;
+    struct token token;
+    uint8_t type;
+
+    type = get_u8(reader);
+    if (type == NULL_NODE || reader->failed)
+    {
+        return NULL;
+    }
+    if (++reader->depth > MAX_DEPTH)
+    {
+        reader->failed = true;
+        return NULL;
+    }
+    token.type = get_u8(reader);
+    token.literal = get_text(reader);
+    switch (type)
+    {
+    case IDENT_EXPR:
+    {
+        struct identifier *identifier;
+
+        ANEW(reader, identifier);
+        identifier->value = get_text(reader);
+        expression = (struct expression *) identifier;
+        break;
+    }
+    case STRING_LITERAL_EXPR:
+    {
+        struct string_literal *string;
+
+        ANEW(reader, string);
+        string->value = get_text(reader);
+        expression = (struct expression *) string;
+        break;
+    }
+    case INT_LITERAL_EXPR:
+    {
+        struct integer_literal *integer;
+
+        ANEW(reader, integer);
+        integer->value = get_i64(reader);
+        integer->big = get_u8(reader) != 0;
+        expression = (struct expression *) integer;
+        break;
+    }
+    case ARRAY_LITERAL_EXPR:
+    {
+        struct array_literal *array;
+
+        ANEW(reader, array);
+        array->elements = get_expressions(reader);
+        expression = (struct expression *) array;
+        break;
+    }
+    case HASH_LITERAL_EXPR:
+    {
+        struct hash_literal *hash;
+
+        ANEW(reader, hash);
+        hash->keys = get_expressions(reader);
+        hash->values = get_expressions(reader);
+        if (hash->keys == NULL || hash->values == NULL
+            || Seq_length(hash->keys) != Seq_length(hash->values))
+        {
+            reader->failed = true;
+        }
+        expression = (struct expression *) hash;
+        break;
+    }
+    case FUNC_LITERAL_EXPR:
+    {
+        struct function_literal *function;
+
+        ANEW(reader, function);
+        /* Pinned: the reference the parser would hold is never dropped. */
+        function->cnt = 2;
+        function->parameters = get_expressions(reader);
+        function->body = get_block(reader, false);
+        if (function->parameters == NULL)
+        {
+            reader->failed = true;
+        }
+        for (int i = 0; !reader->failed && i < Seq_length(function->parameters); i++)
+        {
+            struct expression *parameter = Seq_get(function->parameters, i);
+
+            if (parameter == NULL || parameter->type != IDENT_EXPR)
+            {
+                reader->failed = true;
+            }
+        }
+        expression = (struct expression *) function;
+        break;
+    }
+    case BOOL_EXPR:
+    {
+        struct boolean *boolean;
+
+        ANEW(reader, boolean);
+        boolean->value = get_u8(reader) != 0;
+        expression = (struct expression *) boolean;
+        break;
+    }
+    case INDEX_EXPR:
+    {
+        struct index_expression *index;
+
+        ANEW(reader, index);
+        index->left = get_expression(reader);
+        index->index = get_expression(reader);
+        expression = (struct expression *) index;
+        break;
+    }
+    case SLICE_EXPR:
+    {
+        struct slice_expression *slice;
+
+        ANEW(reader, slice);
+        slice->left = get_expression(reader);
+        slice->start = get_expression(reader);
+        slice->end = get_expression(reader);
+        expression = (struct expression *) slice;
+        break;
+    }
+    case PREFIX_EXPR:
+    {
+        struct prefix_expression *prefix;
+
+        ANEW(reader, prefix);
+        prefix->op = get_text(reader);
+        prefix->right = get_expression(reader);
+        expression = (struct expression *) prefix;
+        break;
+    }
+    case INFIX_EXPR:
+    {
+        struct infix_expression *infix;
+
+        ANEW(reader, infix);
+        infix->left = get_expression(reader);
+        infix->op = get_text(reader);
+        infix->right = get_expression(reader);
+        expression = (struct expression *) infix;
+        break;
+    }
+    case IF_EXPR:
+    {
+        struct if_expression *ife;
+
+        ANEW(reader, ife);
+        ife->condition = get_expression(reader);
+        ife->consequence = get_block(reader, false);
+        ife->alternative = get_block(reader, true);
+        expression = (struct expression *) ife;
+        break;
+    }
+    case CALL_EXPR:
+    {
+        struct call_expression *call;
+
+        ANEW(reader, call);
+        call->function = get_expression(reader);
+        call->arguments = get_expressions(reader);
+        if (call->arguments == NULL)
+        {
+            reader->failed = true;
+        }
+        expression = (struct expression *) call;
+        break;
+    }
+    default:
+    {
+        reader->failed = true;
+        reader->depth--;
+        return NULL;
+    }
+    }
+    expression->type = type;
+    expression->token = token;
+    reader->depth--;
+    return expression;
+}
+
+static struct statement *get_statement(struct reader *reader)
+{
+    struct statement *statement = NULL;
+    struct token token;
+    uint8_t type;
+
+    type = get_u8(reader);
+    if (type == NULL_NODE || reader->failed)
+    {
+        return NULL;
+    }
+    if (++reader->depth > MAX_DEPTH)
+    {
+        reader->failed = true;
+        return NULL;
+    }
+    token.type = get_u8(reader);
+    token.literal = get_text(reader);
+    switch (type)
+    {
+    case LET_STMT:
+    {
+        struct let_statement *let;
+
+        ANEW(reader, let);
+        let->name = (struct identifier *) get_expression(reader);
+        let->value = get_expression(reader);
+        if (let->name == NULL || let->name->type != IDENT_EXPR)
+        {
+            reader->failed = true;
+        }
+        statement = (struct statement *) let;
+        break;
+    }
+    case RETURN_STMT:
+    {
+        struct return_statement *ret;
+
+        ANEW(reader, ret);
+        ret->return_value = get_expression(reader);
+        statement = (struct statement *) ret;
+        break;
+    }
+    case EXPR_STMT:
+    {
+        struct expression_statement *expression;
+
+        ANEW(reader, expression);
+        expression->expression = get_expression(reader);
+        statement = (struct statement *) expression;
+        break;
+    }
+    case BLOCK_STMT:
+    {
+        struct block_statement *block;
+        uint32_t n = get_u32(reader);
+
+        ANEW(reader, block);
+        if (n > (size_t) (reader->end - reader->p))
+        {
+            reader->failed = true;
+            n = 0;
+        }
+        block->statements = Seq_new(n);
+        Seq_addhi(reader->seqs, block->statements);
+        for (uint32_t i = 0; i < n && !reader->failed; i++)
+        {
+            Seq_addhi(block->statements, get_statement(reader));
+        }
+        statement = (struct statement *) block;
+        break;
+    }
+    default:
+    {
+        reader->failed = true;
+        reader->depth--;
+        return NULL;
+    }
+    }
+    statement->type = type;
+    statement->token = token;
+    reader->depth--;
+    return statement;
+}
+
+static bool read_strings(struct reader *reader, const unsigned char *base,
+                         const struct cache_header *header)
+{
+    const unsigned char *p = base + header->strings_offset;
+    uint32_t len;
+
+    reader->nstrings = header->strings;
+    if (header->strings > (size_t) (reader->end - p) / (sizeof len + 1))
+    {
+        return false;
+    }
+    reader->strings = Arena_alloc(reader->arena,
+                                  (header->strings + 1) * sizeof (Text_T),
+                                  __FILE__, __LINE__);
+    for (uint32_t i = 0; i < header->strings; i++)
+    {
+        if ((size_t) (reader->end - p) < sizeof len)
+        {
+            return false;
+        }
+        memcpy(&len, p, sizeof len);
+        p += sizeof len;
+        if ((size_t) (reader->end - p) <= len || p[len] != '\0')
+        {
+            return false;
+        }
+        reader->strings[i] = (Text_T) { len, (const char *) p };
+        p += len + 1;
+    }
+    return true;
+}
+
+static void *map_cache(const char *path, size_t *size)
+{
+    struct stat st;
+    void *map;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)
+        || (size_t) st.st_size < sizeof (struct cache_header))
+    {
+        close(fd);
+        return NULL;
+    }
+    *size = st.st_size;
+    map = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    return map == MAP_FAILED ? NULL : map;
+}
+
+/*
+ * The cache is trusted when it was written by this version on a machine
+ * of the same byte order for a source of the same size, and either the
+ * source's mtime is unchanged or its text hashes the same.
+ */
+static bool header_valid(const struct cache_header *header, size_t size,
+                         const struct stat *st, const char *source)
+{
+    if (memcmp(header->magic, CACHE_MAGIC, sizeof header->magic) != 0
+        || header->version != CACHE_VERSION
+        || header->byte_order != BYTE_ORDER_MARK
+        || header->source_size != (uint64_t) st->st_size
+        || header->strings_offset < sizeof *header
+        || header->strings_offset > size)
+    {
+        return false;
+    }
+    if (header->source_mtime == st->st_mtim.tv_sec
+        && header->source_mtime_nsec == st->st_mtim.tv_nsec)
+    {
+        return true;
+    }
+    return header->source_hash == source_hash(source, st->st_size);
+}
+
+struct cached_program *cache_load(const char *path, const struct stat *st,
+                                  const char *source)
+{
+    struct cached_program *cached;
+    struct cache_header header;
+    struct reader reader = { 0 };
+    struct statement *statement;
+    size_t len = strlen(path);
+    char *cache_path;
+    void *map;
+    size_t size;
+
+    cache_path = ALLOC(len + sizeof CACHE_SUFFIX);
+    memcpy(cache_path, path, len);
+    memcpy(cache_path + len, CACHE_SUFFIX, sizeof CACHE_SUFFIX);
+    map = map_cache(cache_path, &size);
+    FREE(cache_path);
+    if (map == NULL)
+    {
+        return NULL;
+    }
+    memcpy(&header, map, sizeof header);
+    if (!header_valid(&header, size, st, source))
+    {
+        munmap(map, size);
+        return NULL;
+    }
+    reader.arena = Arena_new();
+    reader.seqs = Seq_new(256);
+    reader.end = (const unsigned char *) map + size;
+    if (!read_strings(&reader, map, &header))
+    {
+        reader.failed = true;
+    }
+    reader.p = (const unsigned char *) map + sizeof header;
+    reader.end = (const unsigned char *) map + header.strings_offset;
+    NEW0(cached);
+    cached->arena = reader.arena;
+    cached->seqs = reader.seqs;
+    cached->map = map;
+    cached->size = size;
+    ANEW(&reader, cached->program);
+    cached->program->type = PROGRAM;
+    /* Every statement takes a byte at least, so a larger count is corrupt. */
+    if (header.statements > (size_t) (reader.end - reader.p))
+    {
+        reader.failed = true;
+        header.statements = 0;
+    }
+    cached->program->statements = Seq_new(header.statements);
+    Seq_addhi(reader.seqs, cached->program->statements);
+    for (uint32_t i = 0; i < header.statements && !reader.failed; i++)
+    {
+        statement = get_statement(&reader);
+        if (statement == NULL || statement->type == BLOCK_STMT)
+        {
+            reader.failed = true;
+        }
+        Seq_addhi(cached->program->statements, statement);
+    }
+    if (reader.failed || reader.p != reader.end)
+    {
+        cache_unload(cached);
+        return NULL;
+    }
+    return cached;
+}
+
+void cache_unload(struct cached_program *cached)
+{
+    Seq_T seq;
+
+    while (Seq_length(cached->seqs) > 0)
+    {
+        seq = Seq_remhi(cached->seqs);
+        Seq_free(&seq);
+    }
+    Seq_free(&cached->seqs);
+    Arena_dispose(&cached->arena);
+    munmap(cached->map, cached->size);
+    FREE(cached);
+}
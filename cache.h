@@ -0,0 +1,42 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <sys/stat.h>
+#include <arena.h>
+#include <seq.h>
+
+#include "ast.h"
+
+#define CACHE_SUFFIX ".mkc"
+
+/*
+ * A parsed program saved next to its source.  The file holds a header
+ * identifying the source (size, mtime and a hash of its text), the
+ * statements in preorder, and a table of every string they use.
+ *
+ * A loaded program is built in one arena and its strings point straight
+ * into the mapped file.  Its function literals are pinned so the GC
+ * never frees them, and nothing in it may be destroyed individually:
+ * cache_unload releases it all, after the objects using it are gone.
+ */
+struct cached_program
+{
+    struct program *program;
+    Arena_T arena;
+    Seq_T seqs;
+    void *map;
+    size_t size;
+};
+
+struct cache_writer;
+
+struct cached_program *cache_load(const char *path, const struct stat *st,
+                                  const char *source);
+void cache_unload(struct cached_program *cached);
+struct cache_writer *cache_writer_alloc(const char *path, const struct stat *st,
+                                       const char *source);
+void cache_writer_add(struct cache_writer *writer, struct statement *statement);
+void cache_writer_commit(struct cache_writer *writer);
+void cache_writer_abort(struct cache_writer *writer);
+
+#endif
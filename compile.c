@@ -0,0 +1,109 @@
+#include <stdlib.h>
+#include <string.h>
+#include <mem.h>
+#include <str.h>
+
+#include "compile.h"
+#include "lexer.h"
+#include "parser.h"
+#include "evaluator.h"
+#include "scan.h"
+
+struct compiled_program *compiled_program_alloc(const char *source)
+{
+    struct compiled_program *compiled;
+    struct lexer *lexer;
+    struct parser *parser;
+    size_t len;
+    char *copy;
+
+    parser_init();
+    len = strlen(source);
+    copy = ALLOC(len + 1 + SCAN_PADDING);
+    memcpy(copy, source, len + 1);
+    NEW0(compiled);
+    lexer = lexer_alloc(copy);
+    parser = parser_alloc(lexer);
+    compiled->program = parser_parse_program(parser);
+    compiled->errors = Seq_new(Seq_length(parser->errors));
+    for (int i = 0; i < Seq_length(parser->errors); i++)
+    {
+        Seq_addhi(compiled->errors, Str_dup(Seq_get(parser->errors, i), 1, 0, 1));
+    }
+    parser_destroy(parser);
+    lexer_destroy(lexer);
+    FREE(copy);
+    return compiled;
+}
+
+void compiled_program_destroy(struct compiled_program *compiled)
+{
+    char *error;
+
+    if (compiled == NULL)
+    {
+        return;
+    }
+    while (Seq_length(compiled->errors) > 0)
+    {
+        error = Seq_remlo(compiled->errors);
+        FREE(error);
+    }
+    Seq_free(&compiled->errors);
+    program_destroy(compiled->program);
+    FREE(compiled);
+}
+
+struct bind
+{
+    struct interpreter_state *state;
+    struct env_object *env;
+    struct object *error;
+};
+
+static void bind_input(struct object *key, struct object *value, void *cl)
+{
+    struct bind *bind = cl;
+    struct string_object *name = (struct string_object *) key;
+
+    if (bind->error != NULL)
+    {
+        return;
+    }
+    if (name->type != STRING_OBJ)
+    {
+        bind->error = (struct object *) error_object_alloc(
+            bind->state, "input name must be STRING, got %s",
+            object_type_str[name->type]);
+        return;
+    }
+    env_set(bind->env, Text_box(name->value, name->length), value);
+}
+
+struct object *compiled_program_run(struct interpreter_state *state,
+                                    struct compiled_program *compiled,
+                                    struct hash_object *inputs)
+{
+    struct object *object;
+    struct bind bind;
+
+    if (Seq_length(compiled->errors) != 0)
+    {
+        return (struct object *) error_object_alloc(state, "program has parse errors");
+    }
+    bind.state = state;
+    bind.env = env_object_alloc(state, NULL);
+    bind.error = NULL;
+    if (inputs != NULL)
+    {
+        hamt_map(inputs->pairs, bind_input, &bind);
+        if (bind.error != NULL)
+        {
+            return bind.error;
+        }
+    }
+    objects_gc(state, bind.env);
+    object = eval(state, (struct node *) compiled->program, bind.env);
+    output_flush(&state->output);
+    return object;
+}
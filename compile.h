@@ -0,0 +1,35 @@
+#ifndef COMPILE_H
+#define COMPILE_H
+
+#include <seq.h>
+
+#include "ast.h"
+#include "object.h"
+#include "state.h"
+
+/*
+ * A program parsed once and run any number of times.  Running it writes
+ * only the cache in each call expression, which threads may share (see
+ * struct call_cache), so one compiled program may be run by several
+ * interpreters, each on its own thread.
+ */
+struct compiled_program
+{
+    struct program *program;
+    /* Parse errors as strings; the program must not be run unless empty. */
+    Seq_T errors;
+};
+
+struct compiled_program *compiled_program_alloc(const char *source);
+void compiled_program_destroy(struct compiled_program *compiled);
+/*
+ * Runs compiled in a fresh environment in which each string key of
+ * inputs, which may be NULL, is bound to its value.  Running collects
+ * whatever earlier runs on state left behind, so a result is only valid
+ * until the next run, and inputs must not be used after this returns.
+ */
+struct object *compiled_program_run(struct interpreter_state *state,
+                                    struct compiled_program *compiled,
+                                    struct hash_object *inputs);
+
+#endif
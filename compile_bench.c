@@ -0,0 +1,121 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <mem.h>
+
+#include "compile.h"
+#include "state.h"
+
+#define RUNS 20000
+
+/* A pricing rule of the kind a host evaluates once per request. */
+static const char *rule =
+    "let discount = fn(total) { if (total > 1000) { total / 10 } else { if (total > 100) "
+    "{ total / 20 } else { 0 } } };"
+    "let tiers = {\"gold\": 3, \"silver\": 2, \"bronze\": 1};"
+    "let bonus = tiers[tier];"
+    "let total = price * quantity;"
+    "if (region == \"EU\") { total - discount(total) + bonus * 5 } "
+    "else { total - discount(total) + bonus }";
+
+static const char *tiers[] = { "gold", "silver", "bronze" };
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void put_string(struct interpreter_state *state, Table_T pairs,
+                       const char *name, const char *value)
+{
+    Table_put(pairs, string_object_alloc(state, Text_box(name, strlen(name))),
+              string_object_alloc(state, Text_box(value, strlen(value))));
+}
+
+static void put_integer(struct interpreter_state *state, Table_T pairs,
+                        const char *name, long long value)
+{
+    Table_put(pairs, string_object_alloc(state, Text_box(name, strlen(name))),
+              integer_object_alloc(state, value));
+}
+
+static struct hash_object *request(struct interpreter_state *state, int i)
+{
+    Table_T pairs;
+
+    pairs = Table_new(5, object_cmp, object_hash);
+    put_integer(state, pairs, "price", 10 + i % 300);
+    put_integer(state, pairs, "quantity", 1 + i % 7);
+    put_string(state, pairs, "tier", tiers[i % 3]);
+    put_string(state, pairs, "region", i % 2 ? "EU" : "US");
+    return hash_object_alloc(state, pairs);
+}
+
+static int compare(const void *x, const void *y)
+{
+    double a = *(const double *) x;
+    double b = *(const double *) y;
+
+    return (a > b) - (a < b);
+}
+
+static void report(const char *name, double *latencies)
+{
+    double total = 0;
+
+    for (int i = 0; i < RUNS; i++)
+    {
+        total += latencies[i];
+    }
+    qsort(latencies, RUNS, sizeof *latencies, compare);
+    printf("%-22s mean %7.2f us, p50 %7.2f us, p99 %7.2f us\n", name,
+           total / RUNS * 1e6, latencies[RUNS / 2] * 1e6,
+           latencies[RUNS - RUNS / 100] * 1e6);
+}
+
+int main(void)
+{
+    struct interpreter_state *state;
+    struct compiled_program *compiled;
+    struct object *object;
+    double *latencies;
+    double start;
+    long long check = 0;
+
+    state = interpreter_state_alloc();
+    latencies = CALLOC(RUNS, sizeof *latencies);
+    /* What a host had to do before: parse the rule for every request. */
+    for (int i = 0; i < RUNS; i++)
+    {
+        start = now();
+        compiled = compiled_program_alloc(rule);
+        object = compiled_program_run(state, compiled, request(state, i));
+        compiled_program_destroy(compiled);
+        latencies[i] = now() - start;
+        check += ((struct integer_object *) object)->value;
+    }
+    report("parse and run", latencies);
+    compiled = compiled_program_alloc(rule);
+    for (int i = 0; i < RUNS; i++)
+    {
+        start = now();
+        object = compiled_program_run(state, compiled, request(state, i));
+        latencies[i] = now() - start;
+        check -= ((struct integer_object *) object)->value;
+    }
+    report("compile once, run", latencies);
+    if (check != 0)
+    {
+        printf("results differ\n");
+    }
+    compiled_program_destroy(compiled);
+    FREE(latencies);
+    interpreter_state_destroy(state);
+    return check == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
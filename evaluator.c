@@ -1,17 +1,20 @@
+#include <limits.h>
+#include <string.h>
 #include <str.h>
 #include <mem.h>
 
 #include "builtins.h"
 #include "evaluator.h"
 
-static struct object *eval_program(struct program *program, struct env_object *env)
+static struct object *eval_program(struct interpreter_state *state,
+                                   struct program *program, struct env_object *env)
 {
-    struct object *object;
+    struct object *object = (struct object *) &null_object;
     struct return_value *return_value;
 
     for (int i = 0; i < Seq_length(program->statements); i++)
     {
-        object = eval((struct node *) Seq_get(program->statements, i), env);
+        object = eval(state, (struct node *) Seq_get(program->statements, i), env);
         if (object->type == RETURN_VALUE_OBJ)
         {
             return_value = (struct return_value *) object;
@@ -26,20 +29,33 @@ static struct object *eval_program(struct program *program, struct env_object *e
     return object;
 }
 
-static struct object *eval_expression_statement(struct expression_statement *expression_statement,
+static struct object *eval_expression_statement(struct interpreter_state *state,
+                                                struct expression_statement *expression_statement,
                                                 struct env_object *env)
 {
-    return eval((struct node *) expression_statement->expression, env);    
+    return eval(state, (struct node *) expression_statement->expression, env);    
 }
 
-static struct object *eval_integer_literal(struct integer_literal *integer_literal)
+static struct object *eval_integer_literal(struct interpreter_state *state,
+                                           struct integer_literal *integer_literal)
 {
-    return (struct object *) integer_object_alloc(integer_literal->value);
+    char *digits;
+    AP_T value;
+
+    if (integer_literal->big)
+    {
+        digits = Text_get(NULL, 0, integer_literal->token.literal);
+        value = AP_fromstr(digits, 10, NULL);
+        FREE(digits);
+        return integer_object_from_ap(state, value);
+    }
+    return (struct object *) integer_object_alloc(state, integer_literal->value);
 }
 
-static struct object *eval_string_literal(struct string_literal *string_literal)
+static struct object *eval_string_literal(struct interpreter_state *state,
+                                          struct string_literal *string_literal)
 {
-    return (struct object *) string_object_alloc(string_literal->value);
+    return (struct object *) string_object_alloc(state, string_literal->value);
 }
 
 static struct object *eval_boolean(struct boolean *boolean)
@@ -67,25 +83,36 @@ static struct object *eval_bang_operator_expression(struct object *right)
     }
 }
 
-static struct object *eval_minus_prefix_operator_expression(struct object *right)
+static struct object *eval_minus_prefix_operator_expression(struct interpreter_state *state,
+                                                            struct object *right)
 {
     long long value;
-    
-    if (right->type != INTEGER_OBJ)
+    AP_T ap;
+    AP_T negated;
+
+    if (!is_integer(right))
     {
-        return (struct object *) error_object_alloc("unknown operator: -%s", 
+        return (struct object *) error_object_alloc(state, "unknown operator: -%s", 
                                                     object_type_str[right->type]);
     }
+    if (right->type == BIG_INTEGER_OBJ || ((struct integer_object *) right)->value == LLONG_MIN)
+    {
+        ap = integer_to_ap(right);
+        negated = AP_neg(ap);
+        AP_free(&ap);
+        return integer_object_from_ap(state, negated);
+    }
     value = ((struct integer_object *) right)->value;
-    return (struct object *) integer_object_alloc(-value);
+    return (struct object *) integer_object_alloc(state, -value);
 }
 
-static struct object *eval_prefix_expression(struct prefix_expression *prefix_expression, struct env_object *env)
+static struct object *eval_prefix_expression(struct interpreter_state *state,
+                                             struct prefix_expression *prefix_expression, struct env_object *env)
 {
     struct object *right = NULL;
     struct object *object = NULL;
     
-    right = eval((struct node *) prefix_expression->right, env);
+    right = eval(state, (struct node *) prefix_expression->right, env);
     if (right->type == ERROR_OBJ)
     {
         return right;
@@ -96,38 +123,141 @@ static struct object *eval_prefix_expression(struct prefix_expression *prefix_ex
     }
     else if (Text_cmp(prefix_expression->op, (Text_T) { sizeof "-" - 1, "-" }) == 0)
     {
-        object = eval_minus_prefix_operator_expression(right);
+        object = eval_minus_prefix_operator_expression(state, right);
     }
     else
     {
-        object = (struct object *) error_object_alloc("unknown operator: %T%s", &prefix_expression->op,
+        object = (struct object *) error_object_alloc(state, "unknown operator: %T%s", &prefix_expression->op,
                                                       object_type_str[right->type]);
     }
     return object;
 }
 
-static struct object *eval_integer_infix_expression(struct object *left, struct object *right, Text_T op)
+/* AP_div rounds down; Monkey, like C, rounds toward zero. */
+static AP_T ap_div(AP_T x, AP_T y)
+{
+    AP_T q = AP_div(x, y);
+    AP_T r = AP_mod(x, y);
+    AP_T t;
+
+    if (AP_cmpi(r, 0) != 0 && (AP_cmpi(x, 0) < 0) != (AP_cmpi(y, 0) < 0))
+    {
+        t = q;
+        q = AP_addi(t, 1);
+        AP_free(&t);
+    }
+    AP_free(&r);
+    return q;
+}
+
+/* Either operand may be big; the result is big only if it must be. */
+static struct object *eval_big_integer_infix_expression(struct interpreter_state *state,
+                                                        struct object *left, struct object *right,
+                                                        Text_T op)
+{
+    struct object *object;
+    AP_T x;
+    AP_T y;
+
+    if (Text_cmp(op, (Text_T) { sizeof "/" - 1, "/" }) == 0
+        && right->type == INTEGER_OBJ && ((struct integer_object *) right)->value == 0)
+    {
+        return (struct object *) error_object_alloc(state, "division by zero");
+    }
+    x = integer_to_ap(left);
+    y = integer_to_ap(right);
+    if (Text_cmp(op, (Text_T) { sizeof "+" - 1, "+" }) == 0)
+    {
+        object = integer_object_from_ap(state, AP_add(x, y));
+    }
+    else if (Text_cmp(op, (Text_T) { sizeof "-" - 1, "-" }) == 0)
+    {
+        object = integer_object_from_ap(state, AP_sub(x, y));
+    }
+    else if (Text_cmp(op, (Text_T) { sizeof "*" - 1, "*" }) == 0)
+    {
+        object = integer_object_from_ap(state, AP_mul(x, y));
+    }
+    else if (Text_cmp(op, (Text_T) { sizeof "/" - 1, "/" }) == 0)
+    {
+        object = integer_object_from_ap(state, ap_div(x, y));
+    }
+    else if (Text_cmp(op, (Text_T) { sizeof ">" - 1, ">" }) == 0)
+    {
+        object = (struct object *) boolean_object_alloc(AP_cmp(x, y) > 0);
+    }
+    else if (Text_cmp(op, (Text_T) { sizeof "<" - 1, "<" }) == 0)
+    {
+        object = (struct object *) boolean_object_alloc(AP_cmp(x, y) < 0);
+    }
+    else if (Text_cmp(op, (Text_T) { sizeof "==" - 1, "==" }) == 0)
+    {
+        object = (struct object *) boolean_object_alloc(AP_cmp(x, y) == 0);
+    }
+    else if (Text_cmp(op, (Text_T) { sizeof "!=" - 1, "!=" }) == 0)
+    {
+        object = (struct object *) boolean_object_alloc(AP_cmp(x, y) != 0);
+    }
+    else
+    {
+        object = (struct object *) error_object_alloc(state, "unknown operator: %s %T %s", 
+                                                      object_type_str[left->type],
+                                                      &op,
+                                                      object_type_str[right->type]);   
+    }
+    AP_free(&y);
+    AP_free(&x);
+    return object;
+}
+
+/*
+ * __builtin_*_overflow finds overflow without allocating, so only
+ * results that do not fit in a long long are computed again as AP_Ts.
+ */
+static struct object *eval_integer_infix_expression(struct interpreter_state *state,
+                                                    struct object *left, struct object *right, Text_T op)
 {
     long long left_value;
     long long right_value;
+    long long result;
 
     left_value = ((struct integer_object *) left)->value;
     right_value = ((struct integer_object *) right)->value;
     if (Text_cmp(op, (Text_T) { sizeof "+" - 1, "+" }) == 0)
     {
-        return (struct object *) integer_object_alloc(left_value + right_value);
+        if (__builtin_add_overflow(left_value, right_value, &result))
+        {
+            return eval_big_integer_infix_expression(state, left, right, op);
+        }
+        return (struct object *) integer_object_alloc(state, result);
     }
     else if (Text_cmp(op, (Text_T) { sizeof "-" - 1, "-" }) == 0)
     {
-        return (struct object *) integer_object_alloc(left_value - right_value);
+        if (__builtin_sub_overflow(left_value, right_value, &result))
+        {
+            return eval_big_integer_infix_expression(state, left, right, op);
+        }
+        return (struct object *) integer_object_alloc(state, result);
     }
     else if (Text_cmp(op, (Text_T) { sizeof "*" - 1, "*" }) == 0)
     {
-        return (struct object *) integer_object_alloc(left_value * right_value);
+        if (__builtin_mul_overflow(left_value, right_value, &result))
+        {
+            return eval_big_integer_infix_expression(state, left, right, op);
+        }
+        return (struct object *) integer_object_alloc(state, result);
     }
     else if (Text_cmp(op, (Text_T) { sizeof "/" - 1, "/" }) == 0)
     {
-        return (struct object *) integer_object_alloc(left_value / right_value);
+        if (right_value == 0)
+        {
+            return (struct object *) error_object_alloc(state, "division by zero");
+        }
+        if (left_value == LLONG_MIN && right_value == -1)
+        {
+            return eval_big_integer_infix_expression(state, left, right, op);
+        }
+        return (struct object *) integer_object_alloc(state, left_value / right_value);
     }
     else if (Text_cmp(op, (Text_T) { sizeof ">" - 1, ">" }) == 0)
     {
@@ -147,31 +277,41 @@ static struct object *eval_integer_infix_expression(struct object *left, struct
     }
     else
     {
-        return (struct object *) error_object_alloc("unknown operator: %s %T %s", 
+        return (struct object *) error_object_alloc(state, "unknown operator: %s %T %s", 
                                                     object_type_str[left->type],
                                                     &op,
                                                     object_type_str[right->type]);   
     }
 }
 
-static struct object *eval_string_infix_expression(struct object *left, struct object *right, Text_T op)
+static struct object *eval_string_infix_expression(struct interpreter_state *state,
+                                                   struct object *left, struct object *right, Text_T op)
 {
-    char *left_value;
-    char *right_value;
+    struct string_object *left_string = (struct string_object *) left;
+    struct string_object *right_string = (struct string_object *) right;
     char *value;
     struct object *object;
 
-    left_value = ((struct string_object *) left)->value;
-    right_value = ((struct string_object *) right)->value;
     if (Text_cmp(op, (Text_T) { sizeof "+" - 1, "+" }) == 0)
     {
-        value = Str_cat(left_value, 1, 0, right_value, 1, 0);
-        object = (struct object *) string_object_alloc(Text_box(value, Str_len(value, 1, 0)));
-        FREE(value);
+        value = ALLOC(left_string->length + right_string->length + 1);
+        memcpy(value, left_string->value, left_string->length);
+        memcpy(value + left_string->length, right_string->value, right_string->length);
+        value[left_string->length + right_string->length] = '\0';
+        object = (struct object *) string_object_take(state, value,
+                                                      left_string->length + right_string->length);
+    }
+    else if (Text_cmp(op, (Text_T) { sizeof "==" - 1, "==" }) == 0)
+    {
+        object = (struct object *) boolean_object_alloc(string_cmp(left_string, right_string) == 0);
+    }
+    else if (Text_cmp(op, (Text_T) { sizeof "!=" - 1, "!=" }) == 0)
+    {
+        object = (struct object *) boolean_object_alloc(string_cmp(left_string, right_string) != 0);
     }
     else
     {
-        object = (struct object *) error_object_alloc("unknown operator: %s %T %s", 
+        object = (struct object *) error_object_alloc(state, "unknown operator: %s %T %s", 
                                                       object_type_str[left->type],
                                                       &op,
                                                       object_type_str[right->type]);   
@@ -179,30 +319,35 @@ static struct object *eval_string_infix_expression(struct object *left, struct o
     return object;
 }
 
-static struct object *eval_infix_expression(struct infix_expression *infix_expression, struct env_object *env)
+static struct object *eval_infix_expression(struct interpreter_state *state,
+                                            struct infix_expression *infix_expression, struct env_object *env)
 {
     struct object *right = NULL;
     struct object *left = NULL;
     Text_T op = infix_expression->op;
     struct object *object;
 
-    left = eval((struct node *) infix_expression->left, env);
+    left = eval(state, (struct node *) infix_expression->left, env);
     if (left->type == ERROR_OBJ)
     {
         return left;
     }
-    right = eval((struct node *) infix_expression->right, env);
+    right = eval(state, (struct node *) infix_expression->right, env);
     if (right->type == ERROR_OBJ)
     {
         return right;
     }
     if (left->type == INTEGER_OBJ && right->type == INTEGER_OBJ)
     {
-        object = eval_integer_infix_expression(left, right, infix_expression->op);
+        object = eval_integer_infix_expression(state, left, right, infix_expression->op);
+    }
+    else if (is_integer(left) && is_integer(right))
+    {
+        object = eval_big_integer_infix_expression(state, left, right, infix_expression->op);
     }
     else if (left->type == STRING_OBJ && right->type == STRING_OBJ)
     {
-        object = eval_string_infix_expression(left, right, infix_expression->op);
+        object = eval_string_infix_expression(state, left, right, infix_expression->op);
     }
     else if (Text_cmp(op, (Text_T) { sizeof "==" - 1, "==" }) == 0)
     {
@@ -214,14 +359,14 @@ static struct object *eval_infix_expression(struct infix_expression *infix_expre
     }
     else if (left->type != right->type)
     {
-        object = (struct object *) error_object_alloc("type mismatch: %s %T %s", 
+        object = (struct object *) error_object_alloc(state, "type mismatch: %s %T %s", 
                                                       object_type_str[left->type],
                                                       &op,
                                                       object_type_str[right->type]);   
     }
     else
     {
-        object = (struct object *) error_object_alloc("unknown operator: %s %T %s", 
+        object = (struct object *) error_object_alloc(state, "unknown operator: %s %T %s", 
                                                       object_type_str[left->type],
                                                       &op,
                                                       object_type_str[right->type]);   
@@ -229,13 +374,14 @@ static struct object *eval_infix_expression(struct infix_expression *infix_expre
     return object;
 }
 
-static struct object *eval_block_statement(struct block_statement *block_statement, struct env_object *env)
+static struct object *eval_block_statement(struct interpreter_state *state,
+                                           struct block_statement *block_statement, struct env_object *env)
 {
-    struct object *object;
+    struct object *object = (struct object *) &null_object;
 
     for (int i = 0; i < Seq_length(block_statement->statements); i++)
     {
-        object = eval((struct node *) Seq_get(block_statement->statements, i), env);
+        object = eval(state, (struct node *) Seq_get(block_statement->statements, i), env);
         if (object->type == RETURN_VALUE_OBJ || object->type == ERROR_OBJ)
         {
             return object;
@@ -244,23 +390,25 @@ static struct object *eval_block_statement(struct block_statement *block_stateme
     return object;
 }
 
-static struct object *eval_return_statement(struct return_statement *return_statement, struct env_object *env)
+static struct object *eval_return_statement(struct interpreter_state *state,
+                                            struct return_statement *return_statement, struct env_object *env)
 {
     struct object *value;
     
-    value = eval((struct node *) return_statement->return_value, env);
+    value = eval(state, (struct node *) return_statement->return_value, env);
     if (value->type == ERROR_OBJ)
     {
         return value;
     }
-    return (struct object *) return_value_alloc(value);    
+    return (struct object *) return_value_alloc(state, value);    
 }
 
-static struct object *eval_let_statement(struct let_statement *let_statement, struct env_object *env)
+static struct object *eval_let_statement(struct interpreter_state *state,
+                                         struct let_statement *let_statement, struct env_object *env)
 {
     struct object *value;
     
-    value = eval((struct node *) let_statement->value, env);
+    value = eval(state, (struct node *) let_statement->value, env);
     if (value->type == ERROR_OBJ)
     {
         return value;
@@ -269,7 +417,8 @@ static struct object *eval_let_statement(struct let_statement *let_statement, st
     return (struct object *) &null_object;
 }
 
-static struct object *eval_identifier(struct identifier *identifier, struct env_object *env)
+static struct object *eval_identifier(struct interpreter_state *state,
+                                      struct identifier *identifier, struct env_object *env)
 {
     struct object *value;
     
@@ -278,16 +427,16 @@ static struct object *eval_identifier(struct identifier *identifier, struct env_
     {
         return value;
     }
-    value = (struct object *) builtins_get(identifier);
+    value = (struct object *) builtins_get(state, identifier);
     if (value != NULL)
     {
         return value;
     }
-    return (struct object *) error_object_alloc("identifier not found: %T", 
+    return (struct object *) error_object_alloc(state, "identifier not found: %T", 
                                                 &identifier->value);
 }
 
-static bool is_truthy(struct object *object)
+bool is_truthy(struct object *object)
 {
     if (object == (struct object *) &true_object)
     {
@@ -307,34 +456,37 @@ static bool is_truthy(struct object *object)
     }
 }
 
-static struct object *eval_if_expression(struct if_expression *if_expression, struct env_object *env)
+static struct object *eval_if_expression(struct interpreter_state *state,
+                                         struct if_expression *if_expression, struct env_object *env)
 {
     struct object *condition;
     struct object *object =  (struct object *) &null_object;
     
-    condition = eval((struct node *) if_expression->condition, env);
+    condition = eval(state, (struct node *) if_expression->condition, env);
     if (condition->type == ERROR_OBJ)
     {
         return condition;
     }
     if (is_truthy(condition))
     {
-        object = eval((struct node *) if_expression->consequence, env);
+        object = eval(state, (struct node *) if_expression->consequence, env);
     }
     else if (if_expression->alternative != NULL)
     {
-        object = eval((struct node *) if_expression->alternative, env);
+        object = eval(state, (struct node *) if_expression->alternative, env);
     }
     return object;
 }
 
-static struct object *eval_function_literal(struct function_literal *function_literal,
+static struct object *eval_function_literal(struct interpreter_state *state,
+                                            struct function_literal *function_literal,
                                             struct env_object *env)
 {
-    return (struct object *) function_object_alloc(function_literal, env);
+    return (struct object *) function_object_alloc(state, function_literal, env);
 }
 
-static Seq_T eval_expressions(Seq_T args, struct env_object *env)
+static Seq_T eval_expressions(struct interpreter_state *state,
+                              Seq_T args, struct env_object *env)
 {
     struct object *evaluated;
     Seq_T result;
@@ -342,7 +494,7 @@ static Seq_T eval_expressions(Seq_T args, struct env_object *env)
     result = Seq_new(Seq_length(args));
     for (int i = 0; i < Seq_length(args); i++)
     {
-        evaluated = eval((struct node *) Seq_get(args, i), env);
+        evaluated = eval(state, (struct node *) Seq_get(args, i), env);
         if (evaluated->type == ERROR_OBJ)
         {
             while (Seq_length(result) > 0)
@@ -357,16 +509,18 @@ static Seq_T eval_expressions(Seq_T args, struct env_object *env)
     return result;
 }
 
-static struct env_object *extend_function_env(struct function_object *function, Seq_T args)
+static struct env_object *extend_function_env(struct interpreter_state *state,
+                                              struct function_object *function,
+                                              struct object **argv)
 {
     struct env_object *env;
     struct identifier *param;
 
-    env = env_object_alloc(function->env);
+    env = env_object_alloc(state, function->env);
     for (int i = 0; i < Seq_length(function->value->parameters); i++)
     {
         param = (struct identifier *) Seq_get(function->value->parameters, i);
-        env_set(env, param->value, (struct object *) Seq_get(args, i));
+        env_set(env, param->value, argv[i]);
     }
     return env;
 }
@@ -384,7 +538,139 @@ struct object *unwrap_return_value(struct object *object)
     return object;
 }
 
-static struct object *apply_function(struct object *object, Seq_T args)
+/*
+ * Call arguments are evaluated into slots on this stack rather than into
+ * a Seq per call.  Slots never move once handed out, so a builtin that
+ * calls back into the evaluator keeps its arguments; when a chunk is
+ * full a larger one is chained on, and the last one emptied is kept so
+ * that a call sequence straddling two chunks does not allocate.
+ */
+struct arg_chunk
+{
+    struct arg_chunk *prev;
+    int size;
+    int top;
+    struct object *slots[];
+};
+
+#define ARG_CHUNK_SIZE 256
+
+static struct arg_chunk *arg_chunk_alloc(int size)
+{
+    struct arg_chunk *chunk;
+
+    chunk = ALLOC(sizeof *chunk + size * sizeof chunk->slots[0]);
+    chunk->prev = NULL;
+    chunk->size = size;
+    chunk->top = 0;
+    return chunk;
+}
+
+void evaluator_init(struct interpreter_state *state)
+{
+    state->args = arg_chunk_alloc(ARG_CHUNK_SIZE);
+    state->spare_args = NULL;
+}
+
+void evaluator_destroy(struct interpreter_state *state)
+{
+    struct arg_chunk *chunk;
+
+    while ((chunk = state->args) != NULL)
+    {
+        state->args = chunk->prev;
+        FREE(chunk);
+    }
+    FREE(state->spare_args);
+}
+
+static struct object **args_push(struct interpreter_state *state, int n)
+{
+    struct arg_chunk *chunk = state->args;
+    struct arg_chunk *next;
+    struct object **slots;
+
+    if (chunk->top + n > chunk->size)
+    {
+        next = state->spare_args;
+        state->spare_args = NULL;
+        if (next == NULL || next->size < n)
+        {
+            FREE(next);
+            next = arg_chunk_alloc(2 * chunk->size > n ? 2 * chunk->size : n);
+        }
+        next->prev = chunk;
+        state->args = chunk = next;
+    }
+    slots = &chunk->slots[chunk->top];
+    chunk->top += n;
+    return slots;
+}
+
+static void args_pop(struct interpreter_state *state, int n)
+{
+    struct arg_chunk *chunk = state->args;
+
+    chunk->top -= n;
+    if (n > 0 && chunk->top == 0 && chunk->prev != NULL)
+    {
+        state->args = chunk->prev;
+        FREE(state->spare_args);
+        state->spare_args = chunk;
+    }
+}
+
+static struct object *call_fixed(struct interpreter_state *state,
+                                 struct builtin_object *builtin, struct object **argv)
+{
+    switch (builtin->arity)
+    {
+    case 1:
+    {
+        return builtin->fixed.one(state, argv[0], builtin->cl);
+    }
+    case 2:
+    {
+        return builtin->fixed.two(state, argv[0], argv[1], builtin->cl);
+    }
+    default:
+    {
+        return builtin->fixed.three(state, argv[0], argv[1], argv[2], builtin->cl);
+    }
+    }
+}
+
+static struct object *wrong_arity(struct interpreter_state *state,
+                                  struct builtin_object *builtin, int got)
+{
+    return (struct object *) error_object_alloc(state, "wrong number of arguments. got=%d, want=%d",
+                                                got, builtin->arity);
+}
+
+/* Arguments to a fixed arity builtin never need a Seq. */
+static struct object *eval_fixed_call(struct interpreter_state *state,
+                                      struct builtin_object *builtin,
+                                      Seq_T arguments, struct env_object *env)
+{
+    struct object *argv[3];
+
+    if (Seq_length(arguments) != builtin->arity)
+    {
+        return wrong_arity(state, builtin, Seq_length(arguments));
+    }
+    for (int i = 0; i < builtin->arity; i++)
+    {
+        argv[i] = eval(state, (struct node *) Seq_get(arguments, i), env);
+        if (argv[i]->type == ERROR_OBJ)
+        {
+            return argv[i];
+        }
+    }
+    return call_fixed(state, builtin, argv);
+}
+
+struct object *apply_function(struct interpreter_state *state,
+                              struct object *object, int argc, struct object **argv)
 {
     struct env_object *env;
     struct function_object *function;
@@ -394,54 +680,185 @@ static struct object *apply_function(struct object *object, Seq_T args)
     if (object->type == FUNC_OBJ)
     {
         function = (struct function_object *) object;
-        env = extend_function_env(function, args);
-        evaluated = eval((struct node *) function->value->body, env);
+        if (argc < Seq_length(function->value->parameters))
+        {
+            return (struct object *) error_object_alloc(state, "wrong number of arguments. got=%d, want=%d",
+                                                        argc, Seq_length(function->value->parameters));
+        }
+        env = extend_function_env(state, function, argv);
+        evaluated = eval(state, (struct node *) function->value->body, env);
         return unwrap_return_value(evaluated);
     }
     else if (object->type == BUILTIN_OBJ)
     {
         builtin = (struct builtin_object *) object;
-        return builtin->value(args);
+        if (builtin->arity == 0)
+        {
+            return builtin->native(state, argc, argv, builtin->cl);
+        }
+        if (argc != builtin->arity)
+        {
+            return wrong_arity(state, builtin, argc);
+        }
+        return call_fixed(state, builtin, argv);
     }
-    return (struct object *) error_object_alloc("not a function: %s", 
+    return (struct object *) error_object_alloc(state, "not a function: %s", 
                                                 object_type_str[object->type]);
 }
 
-static struct object *eval_call_expression(struct call_expression *call_expression,
+/* Copies cache, unless it is empty or being written. */
+static bool call_cache_read(struct call_cache *cache, struct call_cache *copy)
+{
+    unsigned sequence;
+
+    sequence = __atomic_load_n(&cache->sequence, __ATOMIC_ACQUIRE);
+    if (sequence == 0 || sequence % 2 != 0)
+    {
+        return false;
+    }
+    copy->depth = __atomic_load_n(&cache->depth, __ATOMIC_RELAXED);
+    copy->slot = __atomic_load_n(&cache->slot, __ATOMIC_RELAXED);
+    copy->builtin = __atomic_load_n(&cache->builtin, __ATOMIC_RELAXED);
+    copy->builtins_version = __atomic_load_n(&cache->builtins_version, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&cache->sequence, __ATOMIC_RELAXED) == sequence;
+}
+
+/* Gives up if another thread is writing; the cache is only a hint. */
+static void call_cache_write(struct call_cache *cache, int depth, int slot,
+                             struct builtin_object *builtin, unsigned builtins_version)
+{
+    unsigned sequence;
+
+    sequence = __atomic_load_n(&cache->sequence, __ATOMIC_RELAXED);
+    if (sequence % 2 != 0
+        || !__atomic_compare_exchange_n(&cache->sequence, &sequence, sequence + 1, false,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+        return;
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&cache->depth, depth, __ATOMIC_RELAXED);
+    __atomic_store_n(&cache->slot, slot, __ATOMIC_RELAXED);
+    __atomic_store_n(&cache->builtin, builtin, __ATOMIC_RELAXED);
+    __atomic_store_n(&cache->builtins_version, builtins_version, __ATOMIC_RELAXED);
+    __atomic_store_n(&cache->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+/*
+ * The function a call names, looked for first where the call found it
+ * last.  A binding found there is still the one meant if no environment
+ * nearer the caller binds the name, and a builtin is if none binds it
+ * at all, so only those nearer environments are searched, and those
+ * are mostly call frames holding a few parameters.
+ */
+static struct object *eval_callee(struct interpreter_state *state,
+                                  struct call_expression *call_expression,
+                                  struct env_object *env)
+{
+    struct identifier *identifier;
+    struct call_cache cache;
+    struct env_object *scope;
+    struct object *builtin;
+    Text_T name;
+    int depth;
+    int slot;
+
+    if (call_expression->function->type != IDENT_EXPR)
+    {
+        return eval(state, (struct node *) call_expression->function, env);
+    }
+    identifier = (struct identifier *) call_expression->function;
+    name = identifier->value;
+    if (call_cache_read(&call_expression->cache, &cache))
+    {
+        /* A builtin's depth is -1, so every environment is searched. */
+        scope = env;
+        for (depth = 0; scope != NULL && depth != cache.depth; depth++)
+        {
+            if (env_slot(scope, name) >= 0)
+            {
+                break;
+            }
+            scope = scope->outer;
+        }
+        if (cache.builtin != NULL)
+        {
+            if (scope == NULL && cache.builtins_version == state->builtins_version)
+            {
+                return (struct object *) cache.builtin;
+            }
+        }
+        else if (scope != NULL && depth == cache.depth && cache.slot < scope->count
+                 && scope->names[cache.slot].len == name.len
+                 && memcmp(scope->names[cache.slot].str, name.str, name.len) == 0)
+        {
+            return scope->values[cache.slot];
+        }
+    }
+    for (scope = env, depth = 0; scope != NULL; scope = scope->outer, depth++)
+    {
+        if ((slot = env_slot(scope, name)) >= 0)
+        {
+            call_cache_write(&call_expression->cache, depth, slot, NULL, 0);
+            return scope->values[slot];
+        }
+    }
+    builtin = builtins_get(state, identifier);
+    if (builtin != NULL)
+    {
+        call_cache_write(&call_expression->cache, -1, 0, (struct builtin_object *) builtin,
+                         state->builtins_version);
+        return builtin;
+    }
+    return (struct object *) error_object_alloc(state, "identifier not found: %T", &name);
+}
+
+static struct object *eval_call_expression(struct interpreter_state *state,
+                                           struct call_expression *call_expression,
                                            struct env_object *env)
 {
     struct object *object;
-    struct object *arg;
-    struct object *evaluated;
-    Seq_T args;
+    struct object *evaluated = NULL;
+    struct object **argv;
+    int argc;
     
-    object = eval((struct node *) call_expression->function, env);
+    object = eval_callee(state, call_expression, env);
     if (object->type == ERROR_OBJ)
     {
         return object;
     }
-    args = eval_expressions(call_expression->arguments, env);
-    if (Seq_length(args) == 1)
+    if (object->type == BUILTIN_OBJ && ((struct builtin_object *) object)->arity > 0)
     {
-        arg = (struct object *) Seq_get(args, 0);
-        if (arg->type == ERROR_OBJ)
+        return eval_fixed_call(state, (struct builtin_object *) object,
+                               call_expression->arguments, env);
+    }
+    argc = Seq_length(call_expression->arguments);
+    argv = args_push(state, argc);
+    for (int i = 0; i < argc; i++)
+    {
+        argv[i] = eval(state, (struct node *) Seq_get(call_expression->arguments, i), env);
+        if (argv[i]->type == ERROR_OBJ)
         {
-            Seq_free(&args);
-            return arg;
+            evaluated = argv[i];
+            goto cleanup;
         }
     }
-    evaluated = apply_function(object, args);
-    Seq_free(&args);
+    evaluated = apply_function(state, object, argc, argv);
+
+cleanup:
+    args_pop(state, argc);
     return evaluated;
 }
 
-static struct object *eval_array_literal(struct array_literal *array_literal,
+static struct object *eval_array_literal(struct interpreter_state *state,
+                                         struct array_literal *array_literal,
                                          struct env_object *env)
 {
     struct object *element;
     Seq_T elements;
     
-    elements = eval_expressions(array_literal->elements, env);
+    elements = eval_expressions(state, array_literal->elements, env);
     if (Seq_length(elements) == 1)
     {
         element = (struct object *) Seq_get(elements, 0);
@@ -451,21 +868,23 @@ static struct object *eval_array_literal(struct array_literal *array_literal,
             return element;
         }
     }
-    return (struct object *) array_object_alloc(elements);
+    return (struct object *) array_object_alloc(state, elements);
 }
 
-static struct object *eval_hash_literal(struct hash_literal *hash_literal,
+static struct object *eval_hash_literal(struct interpreter_state *state,
+                                        struct hash_literal *hash_literal,
                                         struct env_object *env)
 {
     struct object *object = NULL;
     struct object *key;
     struct object *value;
-    Table_T pairs;
+    struct hamt_node *pairs = NULL;
+    bool added;
+    int length = 0;
 
-    pairs = Table_new(Seq_length(hash_literal->keys), object_cmp, object_hash);
     for (int i = 0; i < Seq_length(hash_literal->keys); i++)
     {
-        key = eval((struct node *) Seq_get(hash_literal->keys, i), env);
+        key = eval(state, (struct node *) Seq_get(hash_literal->keys, i), env);
         if (key->type == ERROR_OBJ)
         {
             object = key;
@@ -473,53 +892,67 @@ static struct object *eval_hash_literal(struct hash_literal *hash_literal,
         }
         if (!is_object_hash_key(key))
         {
-            object = (struct object *) error_object_alloc("unusable as hash key, got %s", 
+            object = (struct object *) error_object_alloc(state, "unusable as hash key, got %s", 
                                                           object_type_str[key->type]);
             goto cleanup;
         }
-        value = eval((struct node *) Seq_get(hash_literal->values, i), env);
+        value = eval(state, (struct node *) Seq_get(hash_literal->values, i), env);
         if (value->type == ERROR_OBJ)
         {
             object = value;
             goto cleanup;
         }
-        Table_put(pairs, key, value);
+        pairs = hamt_put(pairs, key, value, &added);
+        length += added;
     }
     
 cleanup:
     if (object != NULL && object->type == ERROR_OBJ)
     {
-        Table_free(&pairs);
+        hamt_free(pairs);
         return object;
     }
-    return (struct object *) hash_object_alloc(pairs);
+    return (struct object *) hash_object_take(state, pairs, length);
 }
 
-static struct object *eval_array_index_expression(struct object *left, struct object *index)
+static struct object *eval_sequence_index_expression(struct interpreter_state *state,
+                                                     struct object *left, struct object *index)
 {
-    struct array_object *array = (struct array_object *) left;
     long long index_value = ((struct integer_object *) index)->value;
-    struct object *object;
 
-    if (index_value < 0 || index_value > Seq_length(array->elements) - 1)
+    if (index_value < 0 || index_value > sequence_length(left) - 1)
     {
         return (struct object *) &null_object;
     }
-    object = (struct object *) Seq_get(array->elements, index_value);
-    return object;
+    return sequence_get(state, left, index_value);
 }
 
-static struct object *eval_hash_index_expression(struct object *left, struct object *index)
+/* A one byte string, sharing the indexed string's buffer. */
+static struct object *eval_string_index_expression(struct interpreter_state *state,
+                                                   struct object *left, struct object *index)
+{
+    struct string_object *string = (struct string_object *) left;
+    long long index_value = ((struct integer_object *) index)->value;
+
+    if (index_value < 0 || index_value > string->length - 1)
+    {
+        return (struct object *) &null_object;
+    }
+    return (struct object *) string_slice_alloc(state, string, index_value, 1);
+}
+
+static struct object *eval_hash_index_expression(struct interpreter_state *state,
+                                                 struct object *left, struct object *index)
 {
     struct hash_object *hash = (struct hash_object *) left;
     struct object *object;
 
     if (!is_object_hash_key(index))
     {
-        return (struct object *) error_object_alloc("unusable as hash key, got %s", 
+        return (struct object *) error_object_alloc(state, "unusable as hash key, got %s", 
                                                     object_type_str[index->type]);
     }
-    object = (struct object *) Table_get(hash->pairs, index);
+    object = hamt_get(hash->pairs, index);
     if (object == NULL)
     {
         return (struct object *) &null_object;
@@ -527,58 +960,162 @@ static struct object *eval_hash_index_expression(struct object *left, struct obj
     return object;
 }
 
-static struct object *eval_index_expression(struct index_expression *index_expression,
+static struct object *eval_index_expression(struct interpreter_state *state,
+                                            struct index_expression *index_expression,
                                             struct env_object *env)
 {
     struct object *left = NULL;
     struct object *index = NULL;
     struct object *object;
 
-    left = eval((struct node *) index_expression->left, env);
+    left = eval(state, (struct node *) index_expression->left, env);
     if (left->type == ERROR_OBJ)
     {
         return left;
     }
-    index = eval((struct node *) index_expression->index, env);
+    index = eval(state, (struct node *) index_expression->index, env);
     if (index->type == ERROR_OBJ)
     {
         return index;
     }
-    if (left->type == ARRAY_OBJ && index->type == INTEGER_OBJ)
+    if (is_sequence(left) && index->type == INTEGER_OBJ)
+    {
+        object = eval_sequence_index_expression(state, left, index);
+    }
+    else if (left->type == STRING_OBJ && index->type == INTEGER_OBJ)
+    {
+        object = eval_string_index_expression(state, left, index);
+    }
+    else if ((is_sequence(left) || left->type == STRING_OBJ) && index->type == BIG_INTEGER_OBJ)
     {
-        object = eval_array_index_expression(left, index);
+        /* A big integer never fits a long long, so it is past either end. */
+        object = (struct object *) &null_object;
     }
     else if (left->type == HASH_OBJ)
     {
-        object = eval_hash_index_expression(left, index);
+        object = eval_hash_index_expression(state, left, index);
     }
     else
     {
-        object = (struct object *) error_object_alloc("index operator not supported: %s", 
+        object = (struct object *) error_object_alloc(state, "index operator not supported: %s", 
                                                       object_type_str[left->type]);
     }
     return object;
 }
     
-struct object *eval(struct node *node, struct env_object *env)
+/* Evaluates a slice bound to an integer clamped to [0, length]; missing is dflt. */
+static struct object *eval_slice_bound(struct interpreter_state *state,
+                                       struct expression *bound, struct env_object *env,
+                                       int length, int dflt, int *value)
+{
+    struct object *object;
+    long long bound_value;
+
+    if (bound == NULL)
+    {
+        *value = dflt;
+        return NULL;
+    }
+    object = eval(state, (struct node *) bound, env);
+    if (object->type == ERROR_OBJ)
+    {
+        return object;
+    }
+    if (object->type != INTEGER_OBJ)
+    {
+        return (struct object *) error_object_alloc(state, "slice bounds must be INTEGER, got %s",
+                                                    object_type_str[object->type]);
+    }
+    bound_value = ((struct integer_object *) object)->value;
+    *value = bound_value < 0 ? 0 : bound_value > length ? length : bound_value;
+    return NULL;
+}
+
+/*
+ * left[start:end] is the part of a string or sequence from start up to
+ * end.  Bounds are clamped, as substr's are, and end before start gives
+ * an empty result.  String slices share the sliced string's buffer.
+ */
+static struct object *eval_slice_expression(struct interpreter_state *state,
+                                            struct slice_expression *slice_expression,
+                                            struct env_object *env)
+{
+    struct object *left;
+    struct object *error;
+    struct array_object *array;
+    long long *ints;
+    Seq_T elements;
+    int length;
+    int start;
+    int end;
+
+    left = eval(state, (struct node *) slice_expression->left, env);
+    if (left->type == ERROR_OBJ)
+    {
+        return left;
+    }
+    if (left->type == STRING_OBJ)
+    {
+        length = ((struct string_object *) left)->length;
+    }
+    else if (is_sequence(left))
+    {
+        length = sequence_length(left);
+    }
+    else
+    {
+        return (struct object *) error_object_alloc(state, "slice operator not supported: %s",
+                                                    object_type_str[left->type]);
+    }
+    if ((error = eval_slice_bound(state, slice_expression->start, env, length, 0, &start)) != NULL
+        || (error = eval_slice_bound(state, slice_expression->end, env, length, length, &end)) != NULL)
+    {
+        return error;
+    }
+    if (end < start)
+    {
+        end = start;
+    }
+    if (left->type == STRING_OBJ)
+    {
+        return (struct object *) string_slice_alloc(state, (struct string_object *) left,
+                                                    start, end - start);
+    }
+    array = (struct array_object *) left;
+    if (left->type == ARRAY_OBJ && array->ints != NULL && end > start)
+    {
+        ints = ALLOC((end - start) * sizeof *ints);
+        memcpy(ints, array->ints + start, (end - start) * sizeof *ints);
+        return (struct object *) int_array_object_alloc(state, ints, end - start);
+    }
+    elements = Seq_new(end - start);
+    for (int i = start; i < end; i++)
+    {
+        Seq_addhi(elements, sequence_get(state, left, i));
+    }
+    return (struct object *) array_object_alloc(state, elements);
+}
+
+struct object *eval(struct interpreter_state *state,
+                    struct node *node, struct env_object *env)
 {
     switch (node->type)
     {
     case PROGRAM:
     {
-        return eval_program((struct program *) node, env);
+        return eval_program(state, (struct program *) node, env);
     }
     case BLOCK_STMT:
     {
-        return eval_block_statement((struct block_statement *) node, env);
+        return eval_block_statement(state, (struct block_statement *) node, env);
     }
     case IF_EXPR:
     {
-        return eval_if_expression((struct if_expression *) node, env);
+        return eval_if_expression(state, (struct if_expression *) node, env);
     }
     case INT_LITERAL_EXPR:
     {
-        return eval_integer_literal((struct integer_literal *) node);
+        return eval_integer_literal(state, (struct integer_literal *) node);
     }
     case BOOL_EXPR:
     {
@@ -586,51 +1123,55 @@ struct object *eval(struct node *node, struct env_object *env)
     }
     case STRING_LITERAL_EXPR:
     {
-        return eval_string_literal((struct string_literal *) node);
+        return eval_string_literal(state, (struct string_literal *) node);
     }
     case ARRAY_LITERAL_EXPR:
     {
-        return eval_array_literal((struct array_literal *) node, env);
+        return eval_array_literal(state, (struct array_literal *) node, env);
     }
     case HASH_LITERAL_EXPR:
     {
-        return eval_hash_literal((struct hash_literal *) node, env);
+        return eval_hash_literal(state, (struct hash_literal *) node, env);
     }
     case INDEX_EXPR:
     {
-        return eval_index_expression((struct index_expression *) node, env);
+        return eval_index_expression(state, (struct index_expression *) node, env);
+    }
+    case SLICE_EXPR:
+    {
+        return eval_slice_expression(state, (struct slice_expression *) node, env);
     }
     case  EXPR_STMT:
     {
-        return eval_expression_statement((struct expression_statement *) node, env);
+        return eval_expression_statement(state, (struct expression_statement *) node, env);
     }
     case PREFIX_EXPR:
     {
-        return eval_prefix_expression((struct prefix_expression *) node, env);
+        return eval_prefix_expression(state, (struct prefix_expression *) node, env);
     }
     case INFIX_EXPR:
     {
-        return eval_infix_expression((struct infix_expression *) node, env);
+        return eval_infix_expression(state, (struct infix_expression *) node, env);
     }
     case RETURN_STMT:
     {
-        return eval_return_statement((struct return_statement *) node, env);
+        return eval_return_statement(state, (struct return_statement *) node, env);
     }
     case LET_STMT:
     {
-        return eval_let_statement((struct let_statement *) node, env);
+        return eval_let_statement(state, (struct let_statement *) node, env);
     }
     case IDENT_EXPR:
     {
-        return eval_identifier((struct identifier *) node, env);
+        return eval_identifier(state, (struct identifier *) node, env);
     }
     case FUNC_LITERAL_EXPR:
     {
-        return eval_function_literal((struct function_literal *) node, env);
+        return eval_function_literal(state, (struct function_literal *) node, env);
     }
     case CALL_EXPR:
     {
-        return eval_call_expression((struct call_expression *) node, env);
+        return eval_call_expression(state, (struct call_expression *) node, env);
     }
     default:
     {
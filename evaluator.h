@@ -4,6 +4,13 @@
 #include "ast.h"
 #include "object.h"
 
-struct object *eval(struct node *node, struct env_object *env);
+void evaluator_init(struct interpreter_state *state);
+void evaluator_destroy(struct interpreter_state *state);
+struct object *eval(struct interpreter_state *state, struct node *node,
+                    struct env_object *env);
+/* Calls a function or builtin object with argc arguments from argv. */
+struct object *apply_function(struct interpreter_state *state,
+                              struct object *object, int argc, struct object **argv);
+bool is_truthy(struct object *object);
 
 #endif
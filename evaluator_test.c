@@ -1,13 +1,24 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
 #include <string.h>
+#include <limits.h>
+#include <unistd.h>
 #include <mem.h>
 #include <str.h>
 
+#include "aggregate.h"
 #include "parser.h"
+#include "sort.h"
 #include "evaluator.h"
 #include "object.h"
-#include "builtins.h"
+#include "state.h"
+#include "batch.h"
+#include "compile.h"
 
+static struct interpreter_state *state;
 static struct env_object *env;
 
 static struct object *test_eval(const char *input)
@@ -20,7 +31,7 @@ static struct object *test_eval(const char *input)
     lexer = lexer_alloc(input);
     parser = parser_alloc(lexer);
     program = parser_parse_program(parser);
-    object = eval((struct node *) program, env);
+    object = eval(state, (struct node *) program, env);
     program_destroy(program);
     lexer_destroy(lexer);
     parser_destroy(parser);
@@ -46,6 +57,25 @@ static int test_integer_object(struct object *object, long long expected)
     return 0;
 }
 
+static int test_error_object(struct object *object, const char *expected)
+{
+    struct error_object *error_object;
+
+    if (object->type != ERROR_OBJ)
+    {
+        Fmt_print("object is not error got=%s\n", object_type_str[object->type]);
+        return -1;
+    }
+    error_object = (struct error_object *) object;
+    if (strcmp(error_object->value, expected) != 0)
+    {
+        Fmt_print("object has wrong value got=%s, want=%s\n",
+                  error_object->value, expected);
+        return -1;
+    }
+    return 0;
+}
+
 static int test_boolean_object(struct object *object, bool expected)
 {
     struct boolean_object *boolean_object;
@@ -65,6 +95,22 @@ static int test_boolean_object(struct object *object, bool expected)
     return 0;
 }
 
+/* Compares how object prints with expected; input names it if not. */
+static int test_inspect(struct object *object, const char *input, const char *expected)
+{
+    char *inspect;
+    int success = 0;
+
+    inspect = object_inspect(object);
+    if (strcmp(inspect, expected) != 0)
+    {
+        Fmt_print("%s got=%s, want=%s\n", input, inspect, expected);
+        success = -1;
+    }
+    FREE(inspect);
+    return success;
+}
+
 static int test_null_object(struct object *object)
 {
     if (object != (struct object *) &null_object)
@@ -196,7 +242,6 @@ static int test_eval_array_expressions(void)
     const char *input = "[1, 2 * 2, 3 + 3]";
     struct object *object;
     struct object *element;
-    struct array_object *array_object;
 
     object = test_eval(input);
     if (object->type != ARRAY_OBJ)
@@ -204,24 +249,23 @@ static int test_eval_array_expressions(void)
         Fmt_print("object is not array got=%s\n", object_type_str[object->type]);
         return -1;
     }
-    array_object = (struct array_object *) object;
-    if (Seq_length(array_object->elements) != 3)
+    if (sequence_length(object) != 3)
     {
         Fmt_print("array has wrong number of elements, got=%d\n",
-                  Seq_length(array_object->elements));
+                  (int) sequence_length(object));
         return -1;        
     }
-    element = (struct object *) Seq_get(array_object->elements, 0);
+    element = sequence_get(state, object, 0);
     if (test_integer_object(element, 1) != 0)
     {
         return -1;
     }
-    element = (struct object *) Seq_get(array_object->elements, 1);
+    element = sequence_get(state, object, 1);
     if (test_integer_object(element, 4) != 0)
     {
         return -1;
     }
-    element = (struct object *) Seq_get(array_object->elements, 2);
+    element = sequence_get(state, object, 2);
     if (test_integer_object(element, 6) != 0)
     {
         return -1;
@@ -250,10 +294,10 @@ static int test_eval_hash_expressions(void)
     struct object *value;
     struct hash_object *hash_object;
 
-    expected[0].key = (struct object *) string_object_alloc((Text_T) {sizeof "one" - 1, "one"});
-    expected[1].key = (struct object *) string_object_alloc((Text_T) {sizeof "two" - 1, "two"});
-    expected[2].key = (struct object *) string_object_alloc((Text_T) {sizeof "three" - 1, "three"});
-    expected[3].key = (struct object *) integer_object_alloc(4);
+    expected[0].key = (struct object *) string_object_alloc(state, (Text_T) {sizeof "one" - 1, "one"});
+    expected[1].key = (struct object *) string_object_alloc(state, (Text_T) {sizeof "two" - 1, "two"});
+    expected[2].key = (struct object *) string_object_alloc(state, (Text_T) {sizeof "three" - 1, "three"});
+    expected[3].key = (struct object *) integer_object_alloc(state, 4);
     expected[4].key = (struct object *) &true_object;
     expected[5].key = (struct object *) &false_object;
     object = test_eval(input);
@@ -263,15 +307,15 @@ static int test_eval_hash_expressions(void)
         return -1;
     }
     hash_object = (struct hash_object *) object;
-    if (Table_length(hash_object->pairs) != 6)
+    if (hash_object->length != 6)
     {
         Fmt_print("hash has wrong number of elements, got=%d\n",
-                  Table_length(hash_object->pairs));
+                  hash_object->length);
         return -1;        
     }
     for (int i = 0; i < sizeof expected / sizeof expected[0]; i++)
     {
-        value = (struct object *) Table_get(hash_object->pairs, expected[i].key);
+        value = hamt_get(hash_object->pairs, expected[i].key);
         if (value == NULL)
         {
             Fmt_print("no pair for given key\n");
@@ -517,14 +561,14 @@ static int test_error_handling(void)
               },
               {
                   "first(1)",
-                  "argument to 'first' must be ARRAY, got INTEGER"
+                  "argument to 'first' must be ARRAY or RANGE, got INTEGER"
               },
               {
                   "last(1)",
-                  "argument to 'last' must be ARRAY, got INTEGER"
+                  "argument to 'last' must be ARRAY or RANGE, got INTEGER"
               },
               {    "rest(1)",
-                   "argument to 'rest' must be ARRAY, got INTEGER"
+                   "argument to 'rest' must be ARRAY or RANGE, got INTEGER"
               },
               {
                   "push([])",
@@ -538,6 +582,26 @@ static int test_error_handling(void)
                   "{ []: 1 + 1 }",
                   "unusable as hash key, got ARRAY"
               },
+              {
+                  "fn(x, y) { x + y }(1)",
+                  "wrong number of arguments. got=1, want=2"
+              },
+              {
+                  "map(1, len)",
+                  "first argument to 'map' must be ARRAY, RANGE or LINES, got INTEGER"
+              },
+              {
+                  "map([1], 2)",
+                  "not a function: INTEGER"
+              },
+              {
+                  "reduce([1, 2], 0, fn(acc, x) { acc + true })",
+                  "type mismatch: INTEGER + BOOLEAN"
+              },
+              {
+                  "filter([1], fn(x) { -true })",
+                  "unknown operator: -BOOLEAN"
+              },
               /*{
                   "{\"name\": \"Monkey\"}[fn(x) { x }];",
                   "unusable as hash key, got FUNC",
@@ -655,6 +719,11 @@ static int test_function_application(void)
               {"let add = fn(x, y) { x + y; }; add(5, 5);", 10},
               {"let add = fn(x, y) { x + y; }; add(5 + 5, add(5, 5));", 20},
               {"fn(x) { x; }(5)", 5},
+              /* Deep enough to spill the argument stack into more chunks. */
+              {"let sum = fn(n, a, b, c, d) { if (n == 0) { a + b + c + d } "
+               "else { sum(n - 1, a + 1, b, c, d) + 0 } }; sum(500, 0, 1, 2, 3);", 506},
+              {"let f = fn(a, b, c) { a + b + c }; let g = fn(n) { if (n == 0) { 0 } "
+               "else { f(n, g(n - 1), f(1, 1, 1)) } }; g(300);", 46050},
           };
     struct object *object;
 
@@ -669,6 +738,89 @@ static int test_function_application(void)
     return 0;
 }
 
+/* Calls remember where they found their function, which must never change what they call. */
+static int test_call_caches(void)
+{
+    struct test
+    {
+        const char *input;
+        const char *expected;
+    } tests[] =
+          {
+              /* The same call finds a global, then a local shadowing it, then the global. */
+              {"let cc_g = fn() { 1 }; let cc_h = fn(k) { if (k) { let cc_g = fn() { 2 }; 0 } "
+               "else { 0 }; cc_g() }; [cc_h(false), cc_h(true), cc_h(false)]", "[1, 2, 1]"},
+              {"let cc_f = fn() { 1 }; let cc_c = fn() { cc_f() }; let cc_x = cc_c(); "
+               "let cc_f = fn() { 2 }; [cc_x, cc_c()]", "[1, 2]"},
+              /* A builtin, unless an enclosing frame takes its name. */
+              {"let cc_o = fn(k) { if (k) { let rest = fn(x) { 42 }; 0 } else { 0 }; "
+               "fn() { rest([1, 2]) } }; let cc_w = cc_o(false); let cc_z = cc_o(true); "
+               "[cc_w(), cc_z(), cc_w()]", "[[2], 42, [2]]"},
+              {"let cc_b = fn(f) { f([1, 2, 3]) }; [cc_b(len), cc_b(first), cc_b(fn(x) { 7 })]",
+               "[3, 1, 7]"},
+              /* Closures from the same literal find the name in different environments. */
+              {"let cc_mk = fn(f) { fn() { f() } }; let cc_p = cc_mk(fn() { 3 }); "
+               "let cc_q = cc_mk(fn() { 4 }); [cc_p(), cc_q(), cc_p()]", "[3, 4, 3]"},
+              /* Frames with more bindings than fit inline. */
+              {"let cc_many = fn(a, b, c, d, e, f, g, h, i, j) { let k = fn(x) { x * 2 }; "
+               "let l = 5; k(l) + a + j }; cc_many(1, 2, 3, 4, 5, 6, 7, 8, 9, 10)", "21"},
+              {"let cc_fib = fn(n) { if (n < 2) { n } else { cc_fib(n - 1) + cc_fib(n - 2) } }; "
+               "cc_fib(20)", "6765"},
+              {"let cc_u = fn() { cc_undefined() }; cc_u()", "identifier not found: cc_undefined"},
+          };
+    struct object *object;
+    int success = 0;
+
+    for (int i = 0; i < sizeof tests / sizeof tests[0]; i++)
+    {
+        object = test_eval(tests[i].input);
+        if (test_inspect(object, tests[i].input, tests[i].expected) != 0)
+        {
+            success = -1;
+        }
+    }
+    return success;
+}
+
+/*
+ * Values only reachable through an array's first element or an outer
+ * environment must survive a collection, and so must printing the
+ * functions with nested or empty bodies.
+ */
+static int test_gc(void)
+{
+    struct test
+    {
+        const char *input;
+        const char *expected;
+    } tests[] =
+          {
+              {"gc_arr[0]", "[1, 2]"},
+              {"gc_c()", "11"},
+              {"gc_f", "fn() {\nfn()\n"},
+              {"gc_g", "fn() {\n\n"},
+              {"gc_h", "fn() {\nfn(a)a\n"},
+          };
+    struct object *object;
+    int success = 0;
+
+    test_eval("let gc_arr = [[1, 2], 3]; let gc_mk = fn(x) { fn(y) { fn() { x + y } } }; "
+              "let gc_c = gc_mk(5)(6); let gc_f = fn() { fn() {} }; let gc_g = fn() {}; "
+              "let gc_h = fn() { fn(a) { a } };");
+    objects_gc(state, env);
+    /* Reuse whatever a faulty collection freed. */
+    test_eval("[[7, 8], [9, 10], fn(z) { fn() { z } }(12), fn(z) { fn() { z } }(13)]");
+    for (int i = 0; i < sizeof tests / sizeof tests[0]; i++)
+    {
+        object = test_eval(tests[i].input);
+        if (test_inspect(object, tests[i].input, tests[i].expected) != 0)
+        {
+            success = -1;
+        }
+    }
+    return success;
+}
+
 static int test_builtin_functions(void)
 {
     struct test
@@ -696,9 +848,18 @@ static int test_builtin_functions(void)
               {"rest([1, 2, 3])", ARRAY_OBJ, 2, {2, 3}},
               {"push([], 1)", ARRAY_OBJ, 1, {1}},
               {"push([1, 2], 3)", ARRAY_OBJ, 3, {1, 2, 3}},
+              {"map([], fn(x) { x * 2 })", ARRAY_OBJ, 0},
+              {"map([1, 2, 3], fn(x) { x * 2 })", ARRAY_OBJ, 3, {2, 4, 6}},
+              {"map([[1], [2, 3]], len)", ARRAY_OBJ, 2, {1, 2}},
+              {"filter([1, 2, 3, 4, 5], fn(x) { x > 2 })", ARRAY_OBJ, 3, {3, 4, 5}},
+              {"filter([1, 2, 3], fn(x) { if (x == 2) { return false; } x })", ARRAY_OBJ, 2, {1, 3}},
+              {"reduce([1, 2, 3, 4], 10, fn(acc, x) { acc + x })", INTEGER_OBJ, 20},
+              {"reduce([], 7, fn(acc, x) { acc + x })", INTEGER_OBJ, 7},
+              {"each([1, 2], fn(x) { x })", NULL_OBJ},
+              {"let n = 2000; let count = fn(i, acc) { if (i == 0) { acc } else { count(i - 1, push(acc, i)) } };"
+               "len(map(count(n, []), fn(x) { x + 1 }))", INTEGER_OBJ, 2000},
            };
     struct object *object;
-    struct array_object *array_object;
 
     for (int i = 0; i < sizeof tests / sizeof tests[0]; i++)
     {
@@ -717,16 +878,15 @@ static int test_builtin_functions(void)
                 Fmt_print("object is not array got=%s\n", object_type_str[object->type]);
                 return -1;
             }
-            array_object = (struct array_object *) object;
-            if (Seq_length(array_object->elements) != tests[i].value)
+            if (sequence_length(object) != tests[i].value)
             {
                 Fmt_print("wrong number of elements. want=%d, got=%d", tests[i].value,
-                          Seq_length(array_object->elements));
+                          (int) sequence_length(object));
                 return -1;
             }
             for (int j = 0; j < tests[i].elements[j]; j++)
             {
-                if (test_integer_object(Seq_get(array_object->elements, j), tests[i].elements[j]) != 0)
+                if (test_integer_object(sequence_get(state, object, j), tests[i].elements[j]) != 0)
                 {
                     return -1;
                 }
@@ -743,13 +903,945 @@ static int test_builtin_functions(void)
     return 0;
 }
 
+#define THREADS 4
+
+struct thread_result
+{
+    int id;
+    long long value;
+};
+
+/* Each thread gets its own interpreter; none of them may see another. */
+static void *run_interpreter(void *arg)
+{
+    const char *input =
+        "let fib = fn(x) { if (x < 2) { x } else { fib(x - 1) + fib(x - 2) } };"
+        "let map = fn(arr, f) { if (len(arr) == 0) { [] } "
+        "else { push(map(rest(arr), f), f(first(arr))) } };"
+        "let sum = fn(arr) { if (len(arr) == 0) { 0 } else { first(arr) + sum(rest(arr)) } };"
+        "sum(map([1, 2, 3, 4, 5, 6, 7, 8, 9, 10], fib)) + id;";
+    struct thread_result *result = arg;
+    struct interpreter_state *state;
+    struct env_object *env;
+    struct lexer *lexer;
+    struct parser *parser;
+    struct program *program;
+    struct object *object;
+
+    state = interpreter_state_alloc();
+    env = env_object_alloc(state, NULL);
+    env_set(env, (Text_T) { sizeof "id" - 1, "id" },
+            (struct object *) integer_object_alloc(state, result->id));
+    for (int i = 0; i < 20; i++)
+    {
+        lexer = lexer_alloc(input);
+        parser = parser_alloc(lexer);
+        program = parser_parse_program(parser);
+        object = eval(state, (struct node *) program, env);
+        result->value = object->type == INTEGER_OBJ
+            ? ((struct integer_object *) object)->value : -1;
+        program_destroy(program);
+        parser_destroy(parser);
+        lexer_destroy(lexer);
+        objects_gc(state, env);
+    }
+    interpreter_state_destroy(state);
+    return NULL;
+}
+
+static int test_concurrent_interpreters(void)
+{
+    pthread_t threads[THREADS];
+    struct thread_result results[THREADS];
+    int created = 0;
+    int success = 0;
+
+    for (int i = 0; i < THREADS; i++)
+    {
+        results[i].id = i;
+        results[i].value = 0;
+        if (pthread_create(&threads[i], NULL, run_interpreter, &results[i]) != 0)
+        {
+            Fmt_print("pthread_create failed\n");
+            success = -1;
+            break;
+        }
+        created++;
+    }
+    for (int i = 0; i < created; i++)
+    {
+        pthread_join(threads[i], NULL);
+        /* fib(1) + ... + fib(10) = 143 */
+        if (results[i].value != 143 + i)
+        {
+            printf("thread %d got=%lld, want=%lld\n", i, results[i].value, 143LL + i);
+            success = -1;
+        }
+    }
+    return success;
+}
+
+static struct hash_object *inputs(struct interpreter_state *state, long long x, long long y)
+{
+    Table_T pairs;
+
+    pairs = Table_new(2, object_cmp, object_hash);
+    Table_put(pairs, string_object_alloc(state, (Text_T) { 1, "x" }),
+              integer_object_alloc(state, x));
+    Table_put(pairs, string_object_alloc(state, (Text_T) { 1, "y" }),
+              integer_object_alloc(state, y));
+    return hash_object_alloc(state, pairs);
+}
+
+struct compiled_run
+{
+    struct compiled_program *compiled;
+    int id;
+    int failures;
+};
+
+/* Every thread runs the same compiled program in its own interpreter. */
+static void *run_compiled(void *arg)
+{
+    struct compiled_run *run = arg;
+    struct interpreter_state *state;
+    struct object *object;
+
+    state = interpreter_state_alloc();
+    for (long long i = 0; i < 200; i++)
+    {
+        object = compiled_program_run(state, run->compiled, inputs(state, i, run->id));
+        if (object->type != INTEGER_OBJ
+            || ((struct integer_object *) object)->value != 2 * i + run->id + 55)
+        {
+            run->failures++;
+        }
+    }
+    interpreter_state_destroy(state);
+    return NULL;
+}
+
+static int test_compiled_program(void)
+{
+    const char *input =
+        "let fib = fn(n) { if (n < 2) { n } else { fib(n - 1) + fib(n - 2) } };"
+        "let twice = fn(v) { v * 2 }; twice(x) + y + fib(10)";
+    struct interpreter_state *state;
+    struct compiled_program *compiled;
+    struct compiled_program *broken;
+    struct compiled_run runs[THREADS];
+    pthread_t threads[THREADS];
+    struct object *object;
+    Table_T pairs;
+    int created = 0;
+    int success = -1;
+
+    state = interpreter_state_alloc();
+    compiled = compiled_program_alloc(input);
+    broken = compiled_program_alloc("let = 1;");
+    if (Seq_length(compiled->errors) != 0 || Seq_length(broken->errors) == 0)
+    {
+        printf("compiled program errors wrong\n");
+        goto cleanup;
+    }
+    for (long long i = 0; i < 50; i++)
+    {
+        object = compiled_program_run(state, compiled, inputs(state, i, -i));
+        if (test_integer_object(object, i + 55) != 0)
+        {
+            goto cleanup;
+        }
+    }
+    /* Nothing from earlier runs survives. */
+    if (objects_allocated(state) > 1000)
+    {
+        printf("compiled runs leaked %d objects\n", objects_allocated(state));
+        goto cleanup;
+    }
+    object = compiled_program_run(state, compiled, NULL);
+    if (test_error_object(object, "identifier not found: x") != 0)
+    {
+        goto cleanup;
+    }
+    pairs = Table_new(1, object_cmp, object_hash);
+    Table_put(pairs, integer_object_alloc(state, 1), integer_object_alloc(state, 1));
+    object = compiled_program_run(state, compiled, hash_object_alloc(state, pairs));
+    if (test_error_object(object, "input name must be STRING, got INTEGER") != 0)
+    {
+        goto cleanup;
+    }
+    object = compiled_program_run(state, broken, NULL);
+    if (test_error_object(object, "program has parse errors") != 0)
+    {
+        goto cleanup;
+    }
+    for (int i = 0; i < THREADS; i++)
+    {
+        runs[i].compiled = compiled;
+        runs[i].id = i;
+        runs[i].failures = 0;
+        if (pthread_create(&threads[i], NULL, run_compiled, &runs[i]) != 0)
+        {
+            Fmt_print("pthread_create failed\n");
+            break;
+        }
+        created++;
+    }
+    for (int i = 0; i < created; i++)
+    {
+        pthread_join(threads[i], NULL);
+        if (runs[i].failures != 0)
+        {
+            printf("thread %d got %d wrong results\n", i, runs[i].failures);
+            goto cleanup;
+        }
+    }
+    if (created == THREADS)
+    {
+        success = 0;
+    }
+
+cleanup:
+    compiled_program_destroy(broken);
+    compiled_program_destroy(compiled);
+    interpreter_state_destroy(state);
+    return success;
+}
+
+static int test_ranges(void)
+{
+    struct test
+    {
+        const char *input;
+        const char *expected;
+    } tests[] =
+          {
+              {"range(3)", "range(0, 3, 1)"},
+              {"len(range(0, 10, 3))", "4"},
+              {"len(range(10, 0, -3))", "4"},
+              {"len(range(5, 5))", "0"},
+              {"len(range(0, 10, -1))", "0"},
+              {"len(range(-9223372036854775807, 9223372036854775807, 2))", "9223372036854775807"},
+              {"range(10, 0, -3)[3]", "1"},
+              {"range(10)[10]", "null"},
+              {"range(10)[-1]", "null"},
+              {"first(range(4, 8))", "4"},
+              {"last(range(4, 8, 3))", "7"},
+              {"first(range(0))", "null"},
+              {"rest(range(0, 10, 2))", "range(2, 10, 2)"},
+              {"len(rest(range(9223372036854775806, 9223372036854775807, 9)))", "0"},
+              {"rest(range(0))", "null"},
+              {"map(range(1, 4), fn(x) { x * x })", "[1, 4, 9]"},
+              {"filter(range(10), fn(x) { x > 6 })", "[7, 8, 9]"},
+              {"reduce(range(1, 100001), 0, fn(a, x) { a + x })", "5000050000"},
+              {"let total = fn(r, a) { if (len(r) == 0) { a } else { total(rest(r), a + first(r)) } }; "
+               "total(range(100), 0)", "4950"},
+              {"range(1, 2, 0)", "step of 'range' must not be 0"},
+              {"range(\"a\")", "arguments to 'range' must be INTEGER, got STRING"},
+              {"range()", "wrong number of arguments. got=0, want=1 to 3"},
+          };
+    struct object *object;
+    int success = 0;
+
+    for (int i = 0; i < sizeof tests / sizeof tests[0]; i++)
+    {
+        object = test_eval(tests[i].input);
+        if (test_inspect(object, tests[i].input, tests[i].expected) != 0)
+        {
+            success = -1;
+        }
+    }
+    return success;
+}
+
+static int test_aggregates(void)
+{
+    struct test
+    {
+        const char *input;
+        const char *expected;
+    } tests[] =
+          {
+              {"let xs = [3, -1, 4, 1, 5, 9, 2, 6, 5]; [sum(xs), min(xs), max(xs), dot(xs, xs)]",
+               "[34, -1, 9, 198]"},
+              {"sum(map(range(1, 1001), fn(x) { x }))", "500500"},
+              {"sum(range(10))", "45"},
+              {"max(range(10, 0, -3))", "10"},
+              {"dot(range(4), [1, 1, 1, 1])", "6"},
+              {"sum([])", "0"},
+              {"min([])", "null"},
+              {"sum([9223372036854775807, 1])", "9223372036854775808"},
+              {"let xs = push([1, 2], 3); [rest(xs), xs[2], len(xs), first(rest(rest(xs)))]",
+               "[[2, 3], 3, 3, 3]"},
+              {"push([1, 2], \"x\")", "[1, 2, x]"},
+              {"sum([1, \"a\"])", "elements of 'sum' must be INTEGER, got STRING"},
+              {"max(1)", "argument to 'max' must be ARRAY or RANGE, got INTEGER"},
+              {"dot([1, 2], [1])", "arguments to 'dot' must have the same length, got=2 and 1"},
+          };
+    const struct aggregator *scalar = aggregator_get(SCALAR_AGGREGATOR);
+    const struct aggregator *avx2 = aggregator_get(AVX2_AGGREGATOR);
+    long long a[67];
+    long long b[67];
+    struct object *object;
+    int success = 0;
+
+    /* Earlier tests bind functions named sum, which would hide the builtin. */
+    env = env_object_alloc(state, NULL);
+    for (int i = 0; i < sizeof tests / sizeof tests[0]; i++)
+    {
+        object = test_eval(tests[i].input);
+        if (test_inspect(object, tests[i].input, tests[i].expected) != 0)
+        {
+            success = -1;
+        }
+    }
+    if (avx2 == NULL)
+    {
+        return success;
+    }
+    /* Every length around the vector width, with values that overflow. */
+    for (int i = 0; i < 67; i++)
+    {
+        a[i] = (i % 3 == 0 ? LLONG_MAX - i : -(long long) i * 7919) ^ ((long long) i << 40);
+        b[i] = i % 5 == 0 ? LLONG_MIN + i : (long long) i * 104729;
+    }
+    for (int n = 1; n <= 67; n++)
+    {
+        if (avx2->sum(a, n) != scalar->sum(a, n)
+            || avx2->min(a + 67 - n, n) != scalar->min(a + 67 - n, n)
+            || avx2->max(b, n) != scalar->max(b, n)
+            || avx2->dot(a, b, n) != scalar->dot(a, b, n))
+        {
+            printf("avx2 and scalar aggregates differ for n=%d\n", n);
+            success = -1;
+        }
+    }
+    return success;
+}
+
+static int int_cmp(const void *x, const void *y)
+{
+    long long a = *(const long long *) x;
+    long long b = *(const long long *) y;
+
+    return (a > b) - (a < b);
+}
+
+static int test_sort(void)
+{
+    struct test
+    {
+        const char *input;
+        const char *expected;
+    } tests[] =
+          {
+              {"sort([3, -1, 4, 1, 5, 9, 2, 6, 5])", "[-1, 1, 2, 3, 4, 5, 5, 6, 9]"},
+              {"sort([\"pear\", \"apple\", \"fig\"])", "[apple, fig, pear]"},
+              {"sort([3, 1, 2], fn(a, b) { a > b })", "[3, 2, 1]"},
+              {"sort(range(5, 0, -1))", "[1, 2, 3, 4, 5]"},
+              {"sort([])", "[]"},
+              {"let xs = [2, 1]; sort(xs); xs", "[2, 1]"},
+              {"sort_stable([[1, \"b\"], [0, \"x\"], [1, \"a\"], [0, \"y\"]], "
+               "fn(a, b) { a[0] < b[0] })", "[[0, x], [0, y], [1, b], [1, a]]"},
+              {"let keyed = map(range(100), fn(i) { [9 - i / 10, i] }); "
+               "let sorted = sort_stable(keyed, fn(a, b) { a[0] < b[0] }); "
+               "[first(sorted), last(sorted)]", "[[0, 90], [9, 9]]"},
+              {"len(sort(map(range(1000), fn(x) { x * 7919 - x / 3 * 23757 }), fn(a, b) { true }))",
+               "1000"},
+              {"sort([1, \"a\"])", "elements of 'sort' must all be INTEGER or all STRING, got INTEGER"},
+              {"sort(1)", "first argument to 'sort' must be ARRAY or RANGE, got INTEGER"},
+              {"sort([2, 1], fn(a, b) { a + true })", "type mismatch: INTEGER + BOOLEAN"},
+              {"sort()", "wrong number of arguments. got=0, want=1 or 2"},
+          };
+    long long *expected;
+    long long *ints;
+    struct object *object;
+    unsigned seed = 12345;
+    int success = 0;
+
+    for (int i = 0; i < sizeof tests / sizeof tests[0]; i++)
+    {
+        object = test_eval(tests[i].input);
+        if (test_inspect(object, tests[i].input, tests[i].expected) != 0)
+        {
+            success = -1;
+        }
+    }
+    /* Enough elements, and duplicates, to reach the partitioning and heapsort paths. */
+    for (int n = 0; n < 3000; n += 1 + n / 2)
+    {
+        ints = ALLOC((n + 1) * sizeof *ints);
+        expected = ALLOC((n + 1) * sizeof *expected);
+        for (int i = 0; i < n; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            ints[i] = expected[i] = n % 3 == 0 ? i % 7 : (long long) (seed >> 8) - (1 << 22);
+        }
+        qsort(expected, n, sizeof *expected, int_cmp);
+        sort_ints(ints, n);
+        if (n > 0 && memcmp(ints, expected, n * sizeof *ints) != 0)
+        {
+            printf("sort_ints wrong for n=%d\n", n);
+            success = -1;
+        }
+        FREE(expected);
+        FREE(ints);
+    }
+    return success;
+}
+
+static int test_strings(void)
+{
+    struct test
+    {
+        const char *input;
+        const char *expected;
+    } tests[] =
+          {
+              {"split(\"a,b,,c\", \",\")", "[a, b, , c]"},
+              {"split(\"a::b::\", \"::\")", "[a, b, ]"},
+              {"split(\"abc\", \"\")", "[a, b, c]"},
+              {"len(split(\"\", \",\"))", "1"},
+              {"join(split(\"x y z\", \" \"), \"-\")", "x-y-z"},
+              {"join([], \",\")", ""},
+              {"substr(\"monkey\", 2)", "nkey"},
+              {"substr(\"monkey\", 1, 3)", "onk"},
+              {"substr(\"monkey\", -5, 100)", "monkey"},
+              {"len(substr(\"monkey\", 9, 1))", "0"},
+              {"index_of(\"hello world\", \"o w\")", "4"},
+              {"index_of(\"hello\", \"lo!\")", "-1"},
+              {"index_of(\"hello\", \"\")", "0"},
+              {"replace(\"a-b-c\", \"-\", \"--\")", "a--b--c"},
+              {"replace(\"aaaa\", \"aa\", \"b\")", "bb"},
+              {"replace(\"abc\", \"x\", \"y\")", "abc"},
+              {"[starts_with(\"monkey\", \"mon\"), starts_with(\"mon\", \"monkey\")]",
+               "[true, false]"},
+              {"len(\"ab\" + \"cde\")", "5"},
+              {"[\"ab\" == \"a\" + \"b\", \"ab\" != \"ab\", \"a\" == \"ab\"]", "[true, false, false]"},
+              {"{\"ab\": 1}[\"a\" + \"b\"]", "1"},
+              {"split(1, \",\")", "first argument to 'split' must be STRING, got INTEGER"},
+              {"join([\"a\", 1], \",\")", "elements of 'join' must be STRING, got INTEGER"},
+              {"replace(\"a\", \"\", \"b\")", "second argument to 'replace' must not be empty"},
+              {"substr(\"a\")", "wrong number of arguments. got=1, want=2 or 3"},
+          };
+    struct object *object;
+    int success = 0;
+
+    for (int i = 0; i < sizeof tests / sizeof tests[0]; i++)
+    {
+        object = test_eval(tests[i].input);
+        if (test_inspect(object, tests[i].input, tests[i].expected) != 0)
+        {
+            success = -1;
+        }
+    }
+    return success;
+}
+
+static int test_slices(void)
+{
+    struct test
+    {
+        const char *input;
+        const char *expected;
+    } tests[] =
+          {
+              {"\"monkey\"[0]", "m"},
+              {"[\"monkey\"[5], \"monkey\"[6], \"monkey\"[-1]]", "[y, null, null]"},
+              {"\"monkey\"[1:3]", "on"},
+              {"\"monkey\"[3:]", "key"},
+              {"\"monkey\"[:3] + \"!\"", "mon!"},
+              {"\"monkey\"[:]", "monkey"},
+              {"len(\"monkey\"[4:2])", "0"},
+              {"\"monkey\"[-3:100]", "monkey"},
+              {"\"monkey\"[1:][1:][1:4]", "key"},
+              {"\"monkey\"[1:4] == \"onk\"", "true"},
+              {"{\"key\": 1}[\"monkey\"[3:]]", "1"},
+              {"split(\"monkey\"[1:5], \"k\")", "[on, e]"},
+              {"[1, 2, 3, 4][1:3]", "[2, 3]"},
+              {"[1, true, \"a\"][1:]", "[true, a]"},
+              {"[1, 2][2:]", "[]"},
+              {"range(10)[7:]", "[7, 8, 9]"},
+              {"1[0:1]", "slice operator not supported: INTEGER"},
+              {"\"monkey\"[true:]", "slice bounds must be INTEGER, got BOOLEAN"},
+          };
+    struct string_object *string;
+    struct object *object;
+    int success = 0;
+
+    for (int i = 0; i < sizeof tests / sizeof tests[0]; i++)
+    {
+        object = test_eval(tests[i].input);
+        if (test_inspect(object, tests[i].input, tests[i].expected) != 0)
+        {
+            success = -1;
+        }
+    }
+    /* Only the slice is reachable after the let, but it keeps its parent. */
+    test_eval("let slice_parent = \"mon\" + \"key\"; let slice = slice_parent[2:5];"
+              "let slice_parent = 0;");
+    objects_gc(state, env);
+    string = (struct string_object *) test_eval("slice");
+    if (string->parent == NULL || strcmp(string_object_cstr(string), "nke") != 0)
+    {
+        Fmt_print("slice was copied or lost its parent, got=%s\n", string_object_cstr(string));
+        success = -1;
+    }
+    return success;
+}
+
+static int test_hash_builtins(void)
+{
+    struct test
+    {
+        const char *input;
+        const char *expected;
+    } tests[] =
+          {
+              {"let h = {\"a\": 1, \"b\": 2}; [len(h), h[\"a\"], has(h, \"b\"), has(h, \"c\")]",
+               "[2, 1, true, false]"},
+              {"let h = {\"a\": 1}; let g = set(h, \"b\", 2); [len(h), len(g), g[\"b\"], has(h, \"b\")]",
+               "[1, 2, 2, false]"},
+              {"let h = {\"a\": 1}; let g = set(h, \"a\", 3); [h[\"a\"], g[\"a\"], len(g)]",
+               "[1, 3, 1]"},
+              {"let h = {1: 1, 2: 2}; let g = delete(h, 1); [len(h), len(g), g[1], g[2]]",
+               "[2, 1, null, 2]"},
+              {"len(delete({1: 1}, 2))", "1"},
+              {"delete({1: 1}, 1)", "{}"},
+              {"let m = merge({1: 1, 2: 2}, {2: 3, 4: 4}); [len(m), m[1], m[2], m[4]]",
+               "[3, 1, 3, 4]"},
+              {"merge({}, {true: 1})", "{true:1}"},
+              {"let h = {1: \"a\", 2: \"b\", 3: \"c\"}; "
+               "let ks = keys(h); let vs = values(h); [len(ks), sum(ks), h[ks[1]] == vs[1]]",
+               "[3, 6, true]"},
+              {"keys({})", "[]"},
+              /* Both keys hash to 1, so they share a collision node. */
+              {"let h = set(set({}, 1, \"a\"), 4294967297, \"b\"); "
+               "[len(h), h[1], h[4294967297], delete(h, 1)[4294967297], len(delete(h, 4294967297))]",
+               "[2, a, b, b, 1]"},
+              {"let big = reduce(range(5000), {}, fn(h, i) { set(h, i, i * i) }); "
+               "let small = reduce(range(0, 5000, 2), big, fn(h, i) { delete(h, i) }); "
+               "[len(big), len(small), big[4998], small[4998], small[4999], sum(keys(small))]",
+               "[5000, 2500, 24980004, null, 24990001, 6250000]"},
+              {"let h = reduce(range(100), {}, fn(h, i) { set(h, \"k\" + substr(\"0123456789\", i - i / 10 * 10, 1) + "
+               "substr(\"0123456789\", i / 10, 1), i) }); [len(h), h[\"k37\"], len(merge(h, h))]",
+               "[100, 73, 100]"},
+              {"keys(1)", "first argument to 'keys' must be HASH, got INTEGER"},
+              {"merge({}, [])", "second argument to 'merge' must be HASH, got ARRAY"},
+              {"set({}, [], 1)", "second argument to 'set' is unusable as hash key, got ARRAY"},
+          };
+    struct object *object;
+    int success = 0;
+
+    for (int i = 0; i < sizeof tests / sizeof tests[0]; i++)
+    {
+        object = test_eval(tests[i].input);
+        if (test_inspect(object, tests[i].input, tests[i].expected) != 0)
+        {
+            success = -1;
+        }
+    }
+    return success;
+}
+
+static int test_big_integers(void)
+{
+    struct test
+    {
+        const char *input;
+        const char *expected;
+    } tests[] =
+          {
+              {"9223372036854775807 + 1", "9223372036854775808"},
+              /* Literals past a long long are big integers, not wrapped ones. */
+              {"9223372036854775808", "9223372036854775808"},
+              {"99999999999999999999", "99999999999999999999"},
+              {"-9223372036854775808", "-9223372036854775808"},
+              {"9223372036854775808 - 1 == 9223372036854775807", "true"},
+              {"[18446744073709551616, 100000000000000000000000000000]",
+               "[18446744073709551616, 100000000000000000000000000000]"},
+              {"fn() { 99999999999999999999 }", "fn() {\n99999999999999999999\n"},
+              {"-9223372036854775807 - 2", "-9223372036854775809"},
+              {"4294967296 * 4294967296", "18446744073709551616"},
+              {"let f = fn(n) { if (n < 2) { 1 } else { n * f(n - 1) } }; f(30)",
+               "265252859812191058636308480000000"},
+              {"let f = fn(n) { if (n < 2) { 1 } else { n * f(n - 1) } }; f(30) / f(28)", "870"},
+              {"(9223372036854775807 + 1) - 1", "9223372036854775807"},
+              {"-(-9223372036854775807 - 1)", "9223372036854775808"},
+              {"(-9223372036854775807 - 1) / -1", "9223372036854775808"},
+              {"-(9223372036854775807 + 1) / 3", "-3074457345618258602"},
+              {"(9223372036854775807 + 8) / -3", "-3074457345618258605"},
+              {"[-7 / 2, 7 / -2]", "[-3, -3]"},
+              {"let b = 9223372036854775807 * 2; [b > 1, b < 1, b == b + 0, b != b, b + 1 > b]",
+               "[true, false, true, false, true]"},
+              {"(9223372036854775807 + 1) - 1 == 9223372036854775807", "true"},
+              {"{9223372036854775807 * 3: 1}[9223372036854775807 * 3]", "1"},
+              {"1 / 0", "division by zero"},
+              {"(9223372036854775807 + 1) / 0", "division by zero"},
+              {"(9223372036854775807 + 1) + true", "type mismatch: BIG INTEGER + BOOLEAN"},
+              {"sum([9223372036854775807, 9223372036854775807, -9223372036854775807])",
+               "9223372036854775807"},
+              {"sum([9223372036854775807, 1, 2])", "9223372036854775810"},
+              {"dot([4294967296, 1], [4294967296, 3])", "18446744073709551619"},
+              {"range(9223372036854775807 + 1)",
+               "arguments to 'range' must be INTEGER, got BIG INTEGER"},
+              /* Any big index is out of range. */
+              {"[[1, 2, 3][99999999999999999999], range(5)[-99999999999999999999], "
+               "\"monkey\"[9223372036854775807 + 1]]", "[null, null, null]"},
+          };
+    struct object *object;
+    int success = 0;
+
+    for (int i = 0; i < sizeof tests / sizeof tests[0]; i++)
+    {
+        object = test_eval(tests[i].input);
+        if (test_inspect(object, tests[i].input, tests[i].expected) != 0)
+        {
+            success = -1;
+        }
+    }
+    return success;
+}
+
+/* Monkey strings have no escapes, so j makes JSON quotes from single ones. */
+#define JSON_QUOTES "let q = substr(json_stringify(\"\"), 0, 1); let j = fn(s) { json_parse(replace(s, \"'\", q)) }; "
+
+static int test_json(void)
+{
+    struct test
+    {
+        const char *input;
+        const char *expected;
+    } tests[] =
+          {
+              {JSON_QUOTES "let h = j(\"{'a': [1, 2, 3], 'b': {'c': true, 'd': null}, 'e': 'x'}\"); "
+               "[len(h), h[\"a\"], h[\"b\"][\"c\"], h[\"b\"][\"d\"], h[\"e\"]]",
+               "[3, [1, 2, 3], true, null, x]"},
+              {JSON_QUOTES "j(\" [ ] \")", "[]"},
+              {JSON_QUOTES "j(\"{}\")", "{}"},
+              {JSON_QUOTES "j(\"{'a': 1, 'a': 2}\")", "{a:2}"},
+              {JSON_QUOTES "j(\"[18446744073709551616, -9223372036854775808, -0]\")",
+               "[18446744073709551616, -9223372036854775808, 0]"},
+              {JSON_QUOTES "let s = j(\"'a\\nb\\u00e9'\"); [len(s), s[1] == substr(json_parse(json_stringify(s)), 1, 1)]",
+               "[5, true]"},
+              {JSON_QUOTES "len(j(\"'\\ud83d\\ude00'\"))", "4"},
+              {"json_stringify([1, \"a\", true, if (false) { 1 }, {1: range(3)}, [[]], {}])",
+               "[1,\"a\",true,null,{\"1\":[0,1,2]},[[]],{}]"},
+              {JSON_QUOTES "json_stringify(j(\"['a\\nb\\\\\\u0001\\/']\"))", "[\"a\\nb\\\\\\u0001/\"]"},
+              {"json_stringify(9223372036854775807 * 4)", "36893488147419103228"},
+              {JSON_QUOTES "let t = json_stringify(j(\"{'k': [1, 'v', {'n': null}]}\")); json_stringify(json_parse(t)) == t",
+               "true"},
+              {JSON_QUOTES "j(\"[1, 2\")", "invalid JSON at byte 5: expected ',' or ']'"},
+              {JSON_QUOTES "j(\"[1.5]\")", "invalid JSON at byte 2: numbers must be integers"},
+              {JSON_QUOTES "j(\"01\")", "invalid JSON at byte 0: leading zero in number"},
+              {JSON_QUOTES "j(\"[1] x\")", "invalid JSON at byte 4: unexpected data after value"},
+              {JSON_QUOTES "j(\"{'a' 1}\")", "invalid JSON at byte 5: expected ':'"},
+              {JSON_QUOTES "j(\"{1: 1}\")", "invalid JSON at byte 1: expected string key"},
+              {JSON_QUOTES "j(\"'ab\")", "invalid JSON at byte 3: unterminated string"},
+              {JSON_QUOTES "j(\"'\\x'\")", "invalid JSON at byte 1: invalid escape in string"},
+              {JSON_QUOTES "j(\"tru\")", "invalid JSON at byte 0: expected value"},
+              {JSON_QUOTES "j(\"\")", "invalid JSON at byte 0: expected value"},
+              {"json_parse(join(map(range(20000), fn(i) { \"[\" }), \"\"))",
+               "invalid JSON at byte 10000: nested too deeply"},
+              {"json_parse(1)", "first argument to 'json_parse' must be STRING, got INTEGER"},
+              {"json_stringify([fn(x) { x }])",
+               "first argument to 'json_stringify' holds FUNC, which JSON cannot represent"},
+          };
+    struct object *object;
+    int success = 0;
+
+    for (int i = 0; i < sizeof tests / sizeof tests[0]; i++)
+    {
+        object = test_eval(tests[i].input);
+        if (test_inspect(object, tests[i].input, tests[i].expected) != 0)
+        {
+            success = -1;
+        }
+    }
+    return success;
+}
+
+static int test_files(void)
+{
+    /* In order, as each test sees the files the ones before it wrote. */
+    struct test
+    {
+        const char *input;
+        const char *expected;
+    } tests[] =
+          {
+              {"write_file(io_path, \"a\nb\nc\")", "5"},
+              {"reduce(read_lines(io_path), \"\", fn(s, line) { s + \"[\" + line + \"]\" })",
+               "[a][b][c]"},
+              {"append_file(io_path, [\"d\", \"e\"])", "4"},
+              {"map(read_lines(io_path), len)", "[1, 1, 2, 1]"},
+              {"let lines = read_lines(io_path); [len(map(lines, len)), len(map(lines, len))]",
+               "[4, 0]"},
+              {"write_file(io_path + \"2\", filter(read_lines(io_path), fn(line) { len(line) == 1 }))",
+               "6"},
+              {"each(read_lines(io_path + \"2\"), fn(line) { line })", "null"},
+              /* Written below, as Monkey strings cannot hold a carriage return. */
+              {"map(read_lines(io_path + \"3\"), len)", "[1, 0, 1]"},
+              {"join(map(read_lines(io_path + \"2\"), fn(line) { line }), \",\")", "a,b,e"},
+              /* Longer than the read buffer, which grows to hold it. */
+              {"write_file(io_path, join(map(range(100000), fn(i) { \"xy\" }), \"\"))", "200000"},
+              {"map(read_lines(io_path), len)", "[200000]"},
+              {"write_file(io_path, \"\")", "0"},
+              {"map(read_lines(io_path), len)", "[]"},
+              {"read_lines(\"/nonexistent/monkey\")",
+               "cannot open /nonexistent/monkey: No such file or directory"},
+              {"append_file(\"/nonexistent/monkey\", \"\")",
+               "cannot open /nonexistent/monkey: No such file or directory"},
+              {"read_lines(1)", "first argument to 'read_lines' must be STRING, got INTEGER"},
+              {"write_file(io_path, 1)",
+               "second argument to 'write_file' must be STRING, ARRAY or LINES, got INTEGER"},
+              {"write_file(io_path, [\"a\", 1])",
+               "elements of second argument to 'write_file' must be STRING, got INTEGER"},
+              {"pmap(read_lines(io_path), len)",
+               "first argument to 'pmap' must be ARRAY or RANGE, got LINES"},
+              /* Loops free each call's garbage, but not what they return. */
+              {"let h = reduce(range(100000), {}, fn(h, i) { set(h, i - i / 3 * 3, [i, \"x\" + \"y\"]) }); "
+               "[len(h), h[0], h[1][1], h[2][0]]",
+               "[3, [99999, xy], xy, 99998]"},
+              {"let pairs = map(range(100000), fn(i) { [i, fn() { i }] }); [len(pairs), pairs[77777][1]()]",
+               "[100000, 77777]"},
+              {"let odd = filter(range(100000), fn(i) { let half = [i / 2]; half[0] * 2 != i }); "
+               "[len(odd), sum(odd)]",
+               "[50000, 2500000000]"},
+          };
+    char path[64];
+    char name[72];
+    char *input;
+    struct object *object;
+    FILE *file;
+    int success = 0;
+    int n;
+
+    snprintf(path, sizeof path, "/tmp/monkey_test_%d", (int) getpid());
+    snprintf(name, sizeof name, "%s3", path);
+    file = fopen(name, "w");
+    fputs("x\r\n\r\ny", file);
+    fclose(file);
+    input = Str_catv("let io_path = \"", 1, 0, path, 1, 0, "\";", 1, 0, NULL);
+    test_eval(input);
+    FREE(input);
+    for (int i = 0; i < sizeof tests / sizeof tests[0]; i++)
+    {
+        object = test_eval(tests[i].input);
+        if (test_inspect(object, tests[i].input, tests[i].expected) != 0)
+        {
+            success = -1;
+        }
+    }
+    n = objects_allocated(state);
+    test_eval("each(range(100000), fn(i) { [i, i] })");
+    if (objects_allocated(state) - n > 100000)
+    {
+        Fmt_print("each kept its garbage, made %d objects\n", objects_allocated(state) - n);
+        success = -1;
+    }
+    remove(path);
+    for (char c = '2'; c <= '3'; c++)
+    {
+        snprintf(name, sizeof name, "%s%c", path, c);
+        remove(name);
+    }
+    return success;
+}
+
+static int test_output(void)
+{
+    static const char expected[] = "nk\n1\n[2]\n{true:3}\n";
+    struct output saved;
+    struct object *object;
+    char text[sizeof expected];
+    char *ordered;
+    char *written;
+    size_t length;
+    FILE *file;
+    long size;
+    int success = 0;
+
+    output_flush(&state->output);
+    saved = state->output;
+    file = tmpfile();
+    output_init(&state->output, file);
+    object = test_eval("puts(\"monkey\"[2:4], 1, [2], {true: 3}); flush(1)");
+    if (test_inspect(object, "flush(1)", "wrong number of arguments. got=1, want=0") != 0)
+    {
+        success = -1;
+    }
+    if (ftell(file) != 0)
+    {
+        Fmt_print("puts was not buffered, wrote %d bytes\n", (int) ftell(file));
+        success = -1;
+    }
+    test_eval("flush()");
+    rewind(file);
+    if (fread(text, 1, sizeof text, file) != sizeof expected - 1
+        || memcmp(text, expected, sizeof expected - 1) != 0)
+    {
+        Fmt_print("puts wrote the wrong text\n");
+        success = -1;
+    }
+    /* Longer than the buffer, and from pmap's threads. */
+    test_eval("puts(join(map(range(50000), fn(i) { \"ab\" }), \"\")); "
+              "pmap(range(5000), fn(i) { puts(i) }); flush()");
+    fseek(file, 0, SEEK_END);
+    size = ftell(file) - (sizeof expected - 1);
+    if (size != 100001 + 5000 + 10 + 90 * 2 + 900 * 3 + 4000 * 4)
+    {
+        Fmt_print("puts wrote %d bytes, want=%d\n", (int) size,
+                  100001 + 5000 + 10 + 90 * 2 + 900 * 3 + 4000 * 4);
+        success = -1;
+    }
+    /* Nesting is written as it is walked, with nothing built per level. */
+    size = ftell(file);
+    test_eval("puts(reduce(range(2000), 0, fn(a, x) { [a] })); flush()");
+    fseek(file, size + 1999, SEEK_SET);
+    if (fread(text, 1, 5, file) != 5 || memcmp(text, "[0]]]", 5) != 0
+        || fseek(file, 0, SEEK_END) != 0 || ftell(file) - size != 2000 + 1 + 2000 + 1)
+    {
+        Fmt_print("puts wrote nested arrays wrong\n");
+        success = -1;
+    }
+    /* Each slice's lines come after what came before the pmap, and in order. */
+    state->threads = 4;
+    size = ftell(file);
+    test_eval("puts(\"before\"); pmap(range(8192), fn(x) { puts(x) }); puts(\"after\"); flush()");
+    state->threads = 0;
+    ordered = ALLOC(7 + 8192 * 5 + 6);
+    length = sprintf(ordered, "before\n");
+    for (int i = 0; i < 8192; i++)
+    {
+        length += sprintf(ordered + length, "%d\n", i);
+    }
+    length += sprintf(ordered + length, "after\n");
+    written = ALLOC(length);
+    fseek(file, size, SEEK_SET);
+    if (fread(written, 1, length, file) != length || memcmp(written, ordered, length) != 0
+        || ftell(file) != size + length)
+    {
+        Fmt_print("pmap's puts came out of order\n");
+        success = -1;
+    }
+    FREE(written);
+    FREE(ordered);
+    output_free(&state->output);
+    state->output = saved;
+    fclose(file);
+    return success;
+}
+
+static int test_pmap(void)
+{
+    struct test
+    {
+        const char *input;
+        const char *expected;
+    } tests[] =
+          {
+              {"reduce(pmap(xs, fn(x) { x * x }), 0, fn(a, b) { a + b }) == "
+               "reduce(map(xs, fn(x) { x * x }), 0, fn(a, b) { a + b })", "true"},
+              {"let k = 3; last(pmap(xs, fn(x) { [x, x + k] }))", "[4999, 5002]"},
+              {"len(pmap(xs, fn(x) { len(pmap([x, x], fn(y) { y })) }))", "5000"},
+              {"pmap(xs, fn(x) { if (x == 4000) { x + true } else { x } })",
+               "type mismatch: INTEGER + BOOLEAN"},
+              {"pmap(xs, fn(x) { if (x > 1500) { -true } else { x + true } })",
+               "type mismatch: INTEGER + BOOLEAN"},
+              {"pmap([1, 2, 3], fn(x) { x * 2 })", "[2, 4, 6]"},
+              {"reduce(pmap(range(5000), fn(x) { x * 2 }), 0, fn(a, b) { a + b })", "24995000"},
+              {"pmap(1, len)", "first argument to 'pmap' must be ARRAY or RANGE, got INTEGER"},
+          };
+    struct object *object;
+    Seq_T elements;
+    int success = 0;
+
+    elements = Seq_new(5000);
+    for (int i = 0; i < 5000; i++)
+    {
+        Seq_addhi(elements, integer_object_alloc(state, i));
+    }
+    env_set(env, (Text_T) { 2, "xs" }, (struct object *) array_object_alloc(state, elements));
+    /* More threads than CPUs still checks the slicing on one CPU. */
+    state->threads = 4;
+    for (int i = 0; i < sizeof tests / sizeof tests[0]; i++)
+    {
+        object = test_eval(tests[i].input);
+        if (test_inspect(object, tests[i].input, tests[i].expected) != 0)
+        {
+            success = -1;
+        }
+    }
+    state->threads = 0;
+    return success;
+}
+
+static int test_batch(void)
+{
+    FILE *in = tmpfile();
+    FILE *out = tmpfile();
+    char line[64];
+    int success = -1;
+    int i;
+
+    if (in == NULL || out == NULL)
+    {
+        printf("tmpfile failed\n");
+        goto cleanup;
+    }
+    for (i = 0; i < 500; i++)
+    {
+        /* Uneven work so workers finish out of order. */
+        fprintf(in, "puts(\"p%d\"); let f = fn(n) { if (n < 1) { %d } else { f(n - 1) } }; "
+                "f(%d)\n", i, i, (i * 37) % 50);
+    }
+    fputs("1 +\n", in);
+    fflush(in);
+    rewind(in);
+    if (batch_run_fd(fileno(in), 3, out) != EXIT_FAILURE)
+    {
+        printf("batch_run_fd did not report the parse error\n");
+        goto cleanup;
+    }
+    rewind(out);
+    /* Each program's puts comes just before its result. */
+    for (i = 0; fgets(line, sizeof line, out) != NULL && i < 500; i++)
+    {
+        if (line[0] != 'p' || atoi(line + 1) != i)
+        {
+            printf("batch output %d wrong, got=%s", i, line);
+            goto cleanup;
+        }
+        if (fgets(line, sizeof line, out) == NULL || atoi(line) != i)
+        {
+            printf("batch result %d wrong, got=%s", i, line);
+            goto cleanup;
+        }
+    }
+    if (i != 500 || strncmp(line, "parse error", sizeof "parse error" - 1) != 0)
+    {
+        printf("batch results wrong at %d: %s", i, line);
+        goto cleanup;
+    }
+    success = 0;
+
+cleanup:
+    if (in != NULL)
+    {
+        fclose(in);
+    }
+    if (out != NULL)
+    {
+        fclose(out);
+    }
+    return success;
+}
+
 int main(void)
 {
-    lexer_init();
-    parser_init();
-    builtins_init();
-    objects_init();
-    env = env_object_alloc(NULL);
+    state = interpreter_state_alloc();
+    env = env_object_alloc(state, NULL);
     int rc = EXIT_SUCCESS;
 
     if (test_eval_integer_expressions() != 0)
@@ -827,15 +1919,95 @@ int main(void)
         printf("test_function_application failed\n");
         goto cleanup;
     }
+    if (test_call_caches() != 0)
+    {
+        printf("test_call_caches failed\n");
+        goto cleanup;
+    }
+    if (test_gc() != 0)
+    {
+        printf("test_gc failed\n");
+        goto cleanup;
+    }
     if (test_builtin_functions() != 0)
     {
         printf("test_builtin_functions failed\n");
         goto cleanup;
     }
+    if (test_concurrent_interpreters() != 0)
+    {
+        printf("test_concurrent_interpreters failed\n");
+        goto cleanup;
+    }
+    if (test_ranges() != 0)
+    {
+        printf("test_ranges failed\n");
+        goto cleanup;
+    }
+    if (test_aggregates() != 0)
+    {
+        printf("test_aggregates failed\n");
+        goto cleanup;
+    }
+    if (test_sort() != 0)
+    {
+        printf("test_sort failed\n");
+        goto cleanup;
+    }
+    if (test_strings() != 0)
+    {
+        printf("test_strings failed\n");
+        goto cleanup;
+    }
+    if (test_slices() != 0)
+    {
+        printf("test_slices failed\n");
+        goto cleanup;
+    }
+    if (test_hash_builtins() != 0)
+    {
+        printf("test_hash_builtins failed\n");
+        goto cleanup;
+    }
+    if (test_big_integers() != 0)
+    {
+        printf("test_big_integers failed\n");
+        goto cleanup;
+    }
+    if (test_json() != 0)
+    {
+        printf("test_json failed\n");
+        goto cleanup;
+    }
+    if (test_files() != 0)
+    {
+        printf("test_files failed\n");
+        goto cleanup;
+    }
+    if (test_output() != 0)
+    {
+        printf("test_output failed\n");
+        goto cleanup;
+    }
+    if (test_pmap() != 0)
+    {
+        printf("test_pmap failed\n");
+        goto cleanup;
+    }
+    if (test_compiled_program() != 0)
+    {
+        printf("test_compiled_program failed\n");
+        goto cleanup;
+    }
+    if (test_batch() != 0)
+    {
+        printf("test_batch failed\n");
+        goto cleanup;
+    }
     printf("Tests successful\n");
     rc = EXIT_SUCCESS;
 
 cleanup:
-    objects_destroy();
+    interpreter_state_destroy(state);
     return rc;
 }
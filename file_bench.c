@@ -0,0 +1,124 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <mem.h>
+
+#include "compile.h"
+#include "object.h"
+#include "state.h"
+
+#define LINES 2000000
+
+static const struct
+{
+    const char *name;
+    const char *source;
+} programs[] =
+  {
+      { "count, read_lines", "reduce(read_lines(path), 0, fn(n, line) { n + 1 })" },
+      { "grep, read_lines", "len(filter(read_lines(path), fn(line) { "
+        "starts_with(substr(line, 25), \"user=7\") }))" },
+      { "copy, read_lines", "write_file(path + \".copy\", read_lines(path))" },
+      /* How files were read before read_lines: whole, as an input. */
+      { "count, split", "len(split(log, \"\n\")) - 1" },
+  };
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Lines like "2024-03-01 12:00:07 INFO user=1234 action=login took=17ms". */
+static int make_log(const char *path)
+{
+    static const char *levels[] = { "INFO", "WARN", "ERROR", "DEBUG" };
+    FILE *file;
+    int length = 0;
+
+    file = fopen(path, "w");
+    for (int i = 0; i < LINES; i++)
+    {
+        length += fprintf(file, "2024-03-01 12:%02d:%02d %s user=%d action=login took=%dms\n",
+                          i / 60 % 60, i % 60, levels[i * 7 % 4], i * 31 % 10000, i % 997);
+    }
+    fclose(file);
+    return length;
+}
+
+static char *read_log(const char *path, int length)
+{
+    FILE *file;
+    char *log;
+
+    log = ALLOC(length);
+    file = fopen(path, "r");
+    length = fread(log, 1, length, file);
+    fclose(file);
+    return log;
+}
+
+static long max_rss_mb(void)
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024;
+}
+
+int main(void)
+{
+    struct interpreter_state *state;
+    struct compiled_program *compiled;
+    struct hash_object *inputs;
+    struct object *object;
+    Table_T pairs;
+    char path[64];
+    char *inspect;
+    char *log = NULL;
+    int length;
+    double start;
+    double secs;
+
+    snprintf(path, sizeof path, "/tmp/file_bench_%d", (int) getpid());
+    state = interpreter_state_alloc();
+    length = make_log(path);
+    printf("%d lines, %d bytes, peak %ld MB\n", LINES, length, max_rss_mb());
+    for (int i = 0; i < sizeof programs / sizeof programs[0]; i++)
+    {
+        objects_gc(state, env_object_alloc(state, NULL));
+        pairs = Table_new(3, object_cmp, object_hash);
+        Table_put(pairs, string_object_alloc(state, (Text_T) { 4, "path" }),
+                  string_object_alloc(state, (Text_T) { strlen(path), path }));
+        if (strcmp(programs[i].name, "count, split") == 0)
+        {
+            log = read_log(path, length);
+            Table_put(pairs, string_object_alloc(state, (Text_T) { 3, "log" }),
+                      string_object_alloc(state, (Text_T) { length, log }));
+        }
+        inputs = hash_object_alloc(state, pairs);
+        compiled = compiled_program_alloc(programs[i].source);
+        start = now();
+        object = compiled_program_run(state, compiled, inputs);
+        secs = now() - start;
+        /* Peak memory only grows, so the runs holding the whole file come last. */
+        inspect = object_inspect(object);
+        printf("%-18s %.4f s, %6.1f MB/s, peak %ld MB  (%s)\n", programs[i].name, secs,
+               length / secs / 1e6, max_rss_mb(), inspect);
+        FREE(inspect);
+        compiled_program_destroy(compiled);
+    }
+    FREE(log);
+    remove(path);
+    strcat(path, ".copy");
+    remove(path);
+    interpreter_state_destroy(state);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,342 @@
+#include <string.h>
+#include <mem.h>
+
+#include "hamt.h"
+#include "object.h"
+
+/* Each level of the trie indexes its 32 slots with 5 bits of the hash. */
+#define BITS 5
+#define MASK ((1u << BITS) - 1)
+/* Keys whose hashes are equal in every bit end up in a collision node. */
+#define HASH_BITS 32
+
+/* A pair, or, when key is NULL, a child node in value. */
+struct entry
+{
+    struct object *key;
+    void *value;
+};
+
+/*
+ * bitmap has a bit set for every used slot, and entries holds them in
+ * slot order.  A collision node has no bitmap and holds two or more
+ * pairs whose keys hash alike.
+ */
+struct hamt_node
+{
+    int refs;
+    unsigned bitmap;
+    int count;
+    struct entry entries[];
+};
+
+/* object_hash leaves the high bits of short strings empty, so they are mixed in. */
+static unsigned hash_of(struct object *key)
+{
+    unsigned h = object_hash(key);
+
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+static int slot_index(unsigned bitmap, unsigned bit)
+{
+    return __builtin_popcount(bitmap & (bit - 1));
+}
+
+static struct hamt_node *node_alloc(unsigned bitmap, int count)
+{
+    struct hamt_node *node;
+
+    node = ALLOC(sizeof *node + count * sizeof node->entries[0]);
+    node->refs = 1;
+    node->bitmap = bitmap;
+    node->count = count;
+    return node;
+}
+
+struct hamt_node *hamt_ref(struct hamt_node *trie)
+{
+    if (trie != NULL)
+    {
+        __atomic_add_fetch(&trie->refs, 1, __ATOMIC_RELAXED);
+    }
+    return trie;
+}
+
+void hamt_free(struct hamt_node *trie)
+{
+    if (trie == NULL || __atomic_sub_fetch(&trie->refs, 1, __ATOMIC_ACQ_REL) > 0)
+    {
+        return;
+    }
+    for (int i = 0; i < trie->count; i++)
+    {
+        if (trie->entries[i].key == NULL)
+        {
+            hamt_free(trie->entries[i].value);
+        }
+    }
+    FREE(trie);
+}
+
+/*
+ * node, with room for extra more entries, if no one else holds it;
+ * otherwise a copy that holds node's children too, and node is
+ * released.
+ */
+static struct hamt_node *own(struct hamt_node *node, int extra)
+{
+    struct hamt_node *copy;
+
+    if (__atomic_load_n(&node->refs, __ATOMIC_ACQUIRE) == 1)
+    {
+        if (extra > 0)
+        {
+            RESIZE(node, sizeof *node + (node->count + extra) * sizeof node->entries[0]);
+        }
+        return node;
+    }
+    copy = node_alloc(node->bitmap, node->count + extra);
+    copy->count = node->count;
+    memcpy(copy->entries, node->entries, node->count * sizeof node->entries[0]);
+    for (int i = 0; i < copy->count; i++)
+    {
+        if (copy->entries[i].key == NULL)
+        {
+            hamt_ref(copy->entries[i].value);
+        }
+    }
+    hamt_free(node);
+    return copy;
+}
+
+static struct hamt_node *insert_entry(struct hamt_node *node, int i, struct entry entry)
+{
+    node = own(node, 1);
+    memmove(&node->entries[i + 1], &node->entries[i],
+            (node->count - i) * sizeof node->entries[0]);
+    node->entries[i] = entry;
+    node->count++;
+    return node;
+}
+
+static struct hamt_node *remove_entry(struct hamt_node *node, int i)
+{
+    node = own(node, 0);
+    node->count--;
+    memmove(&node->entries[i], &node->entries[i + 1],
+            (node->count - i) * sizeof node->entries[0]);
+    return node;
+}
+
+/* A node at shift holding two pairs with different keys. */
+static struct hamt_node *pair_node(struct entry e1, unsigned h1, struct entry e2, unsigned h2,
+                                   int shift)
+{
+    struct hamt_node *node;
+    unsigned b1;
+    unsigned b2;
+
+    if (shift >= HASH_BITS)
+    {
+        node = node_alloc(0, 2);
+        node->entries[0] = e1;
+        node->entries[1] = e2;
+        return node;
+    }
+    b1 = 1u << (h1 >> shift & MASK);
+    b2 = 1u << (h2 >> shift & MASK);
+    if (b1 == b2)
+    {
+        node = node_alloc(b1, 1);
+        node->entries[0].key = NULL;
+        node->entries[0].value = pair_node(e1, h1, e2, h2, shift + BITS);
+        return node;
+    }
+    node = node_alloc(b1 | b2, 2);
+    node->entries[b1 < b2 ? 0 : 1] = e1;
+    node->entries[b1 < b2 ? 1 : 0] = e2;
+    return node;
+}
+
+static struct hamt_node *put_pair(struct hamt_node *node, unsigned hash, int shift,
+                                  struct entry pair, bool *added)
+{
+    struct entry *entry;
+    unsigned bit;
+    int i;
+
+    if (node->bitmap == 0)
+    {
+        for (i = 0; i < node->count; i++)
+        {
+            if (object_cmp(node->entries[i].key, pair.key) == 0)
+            {
+                node = own(node, 0);
+                node->entries[i].value = pair.value;
+                *added = false;
+                return node;
+            }
+        }
+        *added = true;
+        return insert_entry(node, node->count, pair);
+    }
+    bit = 1u << (hash >> shift & MASK);
+    i = slot_index(node->bitmap, bit);
+    if ((node->bitmap & bit) == 0)
+    {
+        node = insert_entry(node, i, pair);
+        node->bitmap |= bit;
+        *added = true;
+        return node;
+    }
+    node = own(node, 0);
+    entry = &node->entries[i];
+    if (entry->key == NULL)
+    {
+        entry->value = put_pair(entry->value, hash, shift + BITS, pair, added);
+    }
+    else if (object_cmp(entry->key, pair.key) == 0)
+    {
+        entry->value = pair.value;
+        *added = false;
+    }
+    else
+    {
+        entry->value = pair_node(*entry, hash_of(entry->key), pair, hash, shift + BITS);
+        entry->key = NULL;
+        *added = true;
+    }
+    return node;
+}
+
+struct hamt_node *hamt_put(struct hamt_node *trie, struct object *key, struct object *value,
+                           bool *added)
+{
+    struct entry pair = { key, value };
+    unsigned hash = hash_of(key);
+
+    *added = true;
+    if (trie == NULL)
+    {
+        trie = node_alloc(1u << (hash & MASK), 1);
+        trie->entries[0] = pair;
+        return trie;
+    }
+    return put_pair(trie, hash, 0, pair, added);
+}
+
+/*
+ * key is in node, so it is always removed.  Only the root can be left
+ * empty, as every other node holds a child or at least two pairs.
+ */
+static struct hamt_node *remove_key(struct hamt_node *node, unsigned hash, int shift,
+                                    struct object *key)
+{
+    struct hamt_node *child;
+    unsigned bit;
+    int i;
+
+    if (node->bitmap == 0)
+    {
+        for (i = 0; object_cmp(node->entries[i].key, key) != 0; i++)
+        {
+        }
+        return remove_entry(node, i);
+    }
+    bit = 1u << (hash >> shift & MASK);
+    i = slot_index(node->bitmap, bit);
+    if (node->entries[i].key != NULL)
+    {
+        if (node->count == 1)
+        {
+            hamt_free(node);
+            return NULL;
+        }
+        node = remove_entry(node, i);
+        node->bitmap &= ~bit;
+        return node;
+    }
+    node = own(node, 0);
+    child = remove_key(node->entries[i].value, hash, shift + BITS, key);
+    /* A child left with one pair is folded back in, so the trie stays shallow. */
+    if (child->count == 1 && child->entries[0].key != NULL)
+    {
+        node->entries[i] = child->entries[0];
+        hamt_free(child);
+    }
+    else
+    {
+        node->entries[i].value = child;
+    }
+    return node;
+}
+
+struct hamt_node *hamt_remove(struct hamt_node *trie, struct object *key, bool *removed)
+{
+    *removed = hamt_get(trie, key) != NULL;
+    if (!*removed)
+    {
+        return trie;
+    }
+    return remove_key(trie, hash_of(key), 0, key);
+}
+
+struct object *hamt_get(struct hamt_node *trie, struct object *key)
+{
+    unsigned hash = hash_of(key);
+    struct entry *entry;
+    unsigned bit;
+
+    for (int shift = 0; trie != NULL; shift += BITS)
+    {
+        if (trie->bitmap == 0)
+        {
+            for (int i = 0; i < trie->count; i++)
+            {
+                if (object_cmp(trie->entries[i].key, key) == 0)
+                {
+                    return trie->entries[i].value;
+                }
+            }
+            return NULL;
+        }
+        bit = 1u << (hash >> shift & MASK);
+        if ((trie->bitmap & bit) == 0)
+        {
+            return NULL;
+        }
+        entry = &trie->entries[slot_index(trie->bitmap, bit)];
+        if (entry->key != NULL)
+        {
+            return object_cmp(entry->key, key) == 0 ? entry->value : NULL;
+        }
+        trie = entry->value;
+    }
+    return NULL;
+}
+
+void hamt_map(struct hamt_node *trie,
+              void apply(struct object *key, struct object *value, void *cl), void *cl)
+{
+    if (trie == NULL)
+    {
+        return;
+    }
+    for (int i = 0; i < trie->count; i++)
+    {
+        if (trie->entries[i].key == NULL)
+        {
+            hamt_map(trie->entries[i].value, apply, cl);
+        }
+        else
+        {
+            apply(trie->entries[i].key, trie->entries[i].value, cl);
+        }
+    }
+}
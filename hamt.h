@@ -0,0 +1,29 @@
+#ifndef HAMT_H
+#define HAMT_H
+
+#include <stdbool.h>
+
+struct object;
+struct hamt_node;
+
+/*
+ * A persistent hash array mapped trie from hashable objects to objects;
+ * NULL is the empty trie.  Nodes are reference counted and shared
+ * between tries.  hamt_put and hamt_remove take the reference they are
+ * passed and return one to the result: nodes no one else holds are
+ * updated in place, and the path to the change is copied otherwise, so
+ * hamt_ref first keeps the original intact.
+ */
+struct hamt_node *hamt_ref(struct hamt_node *trie);
+void hamt_free(struct hamt_node *trie);
+/* The value of key, or NULL. */
+struct object *hamt_get(struct hamt_node *trie, struct object *key);
+/* Adds or replaces key's value; *added tells which. */
+struct hamt_node *hamt_put(struct hamt_node *trie, struct object *key, struct object *value,
+                           bool *added);
+struct hamt_node *hamt_remove(struct hamt_node *trie, struct object *key, bool *removed);
+/* Calls apply on every pair, in hash order. */
+void hamt_map(struct hamt_node *trie,
+              void apply(struct object *key, struct object *value, void *cl), void *cl);
+
+#endif
@@ -0,0 +1,108 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <mem.h>
+
+#include "compile.h"
+#include "object.h"
+#include "state.h"
+
+#define TRANSITIONS 20000
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* How a transition changed one field before set: a literal copying every other field. */
+static char *literal_program(int fields)
+{
+    char *source;
+    char *p;
+
+    p = source = ALLOC(64 * (size_t) fields + 128);
+    p += sprintf(p, "len(reduce(range(%d), h, fn(h, i) { {", TRANSITIONS);
+    for (int i = 0; i < fields - 1; i++)
+    {
+        p += sprintf(p, "\"f%d\": h[\"f%d\"], ", i, i);
+    }
+    sprintf(p, "\"f%d\": i} }))", fields - 1);
+    return source;
+}
+
+static char *set_program(int fields)
+{
+    char *source;
+
+    source = ALLOC(128);
+    sprintf(source, "len(reduce(range(%d), h, fn(h, i) { set(h, \"f%d\", i) }))",
+            TRANSITIONS, fields - 1);
+    return source;
+}
+
+static double run(struct interpreter_state *state, const char *source, int fields)
+{
+    struct compiled_program *compiled;
+    struct hash_object *inputs;
+    struct object *object;
+    Table_T pairs;
+    Table_T h;
+    char name[16];
+    double start;
+    double secs;
+
+    /* Collect the last run's garbage now, so it is not timed. */
+    objects_gc(state, env_object_alloc(state, NULL));
+    h = Table_new(fields, object_cmp, object_hash);
+    for (int i = 0; i < fields; i++)
+    {
+        snprintf(name, sizeof name, "f%d", i);
+        Table_put(h, string_object_alloc(state, Text_box(name, strlen(name))),
+                  integer_object_alloc(state, i));
+    }
+    pairs = Table_new(1, object_cmp, object_hash);
+    Table_put(pairs, string_object_alloc(state, (Text_T) { 1, "h" }),
+              hash_object_alloc(state, h));
+    inputs = hash_object_alloc(state, pairs);
+    compiled = compiled_program_alloc(source);
+    start = now();
+    object = compiled_program_run(state, compiled, inputs);
+    secs = now() - start;
+    if (object->type != INTEGER_OBJ || ((struct integer_object *) object)->value != fields)
+    {
+        printf("failed: %.60s\n", object_inspect(object));
+    }
+    compiled_program_destroy(compiled);
+    return secs;
+}
+
+int main(void)
+{
+    static const int sizes[] = { 8, 64, 512 };
+    struct interpreter_state *state;
+    char *source;
+    double base;
+    double secs;
+
+    state = interpreter_state_alloc();
+    printf("%d transitions, each changing one field\n", TRANSITIONS);
+    for (int i = 0; i < sizeof sizes / sizeof sizes[0]; i++)
+    {
+        source = literal_program(sizes[i]);
+        base = run(state, source, sizes[i]);
+        FREE(source);
+        source = set_program(sizes[i]);
+        secs = run(state, source, sizes[i]);
+        FREE(source);
+        printf("%4d fields: literal %.4f s, set %.4f s, speedup %.1f\n", sizes[i], base, secs,
+               base / secs);
+    }
+    interpreter_state_destroy(state);
+    return EXIT_SUCCESS;
+}
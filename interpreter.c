@@ -1,10 +1,53 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "repl.h"
+#include "script.h"
+#include "batch.h"
 
-int main(void)
+static void usage(void)
 {
+    fprintf(stderr, "usage: interpreter [script | - | -b [-j workers] directory | -b [-j workers] -]\n");
+}
+
+/* Batch mode: -b [-j workers] directory, or - for one program per line. */
+static int batch(int argc, char *argv[])
+{
+    int workers = 0;
+    int i = 2;
+
+    if (i + 1 < argc && strcmp(argv[i], "-j") == 0)
+    {
+        workers = atoi(argv[i + 1]);
+        i += 2;
+    }
+    if (i + 1 != argc)
+    {
+        usage();
+        return EXIT_FAILURE;
+    }
+    if (strcmp(argv[i], "-") == 0)
+    {
+        return batch_run_fd(0, workers, stdout);
+    }
+    return batch_run_dir(argv[i], workers, stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1)
+    {
+        if (strcmp(argv[1], "-b") == 0)
+        {
+            return batch(argc, argv);
+        }
+        if (strcmp(argv[1], "-") == 0)
+        {
+            return script_run_fd(0);
+        }
+        return script_run_file(argv[1]);
+    }
     printf("Hello! This is the Monkey programming language!\n");
     printf("Feel free to type in commands\n");
     repl_start();
@@ -0,0 +1,735 @@
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <mem.h>
+#include <seq.h>
+
+#include "json.h"
+
+/* Deeper nesting than this is an error rather than a stack overflow. */
+#define MAX_DEPTH 10000
+
+struct reader
+{
+    struct interpreter_state *state;
+    struct string_object *text;
+    const char *p;
+    const char *end;
+    int depth;
+    /* The elements of every array being read, innermost last. */
+    struct object **stack;
+    int top;
+    int size;
+    struct object *error;
+};
+
+struct writer
+{
+    char *data;
+    size_t length;
+    size_t size;
+    /* The first value found that JSON cannot hold. */
+    struct object *unwritable;
+};
+
+struct pair_writer
+{
+    struct writer *writer;
+    int count;
+};
+
+static struct object *read_value(struct reader *reader);
+static void write_value(struct writer *writer, struct object *value);
+
+static struct object *fail(struct reader *reader, const char *what)
+{
+    if (reader->error == NULL)
+    {
+        reader->error = (struct object *) error_object_alloc(reader->state, "invalid JSON at byte %d: %s",
+                                                             (int) (reader->p - reader->text->value),
+                                                             what);
+    }
+    return NULL;
+}
+
+static void skip_space(struct reader *reader)
+{
+    while (reader->p < reader->end
+           && (*reader->p == ' ' || *reader->p == '\n' || *reader->p == '\r' || *reader->p == '\t'))
+    {
+        reader->p++;
+    }
+}
+
+static bool is_digit(const char *p, const char *end)
+{
+    return p < end && *p >= '0' && *p <= '9';
+}
+
+static void push(struct reader *reader, struct object *value)
+{
+    if (reader->top == reader->size)
+    {
+        reader->size *= 2;
+        RESIZE(reader->stack, reader->size * sizeof *reader->stack);
+    }
+    reader->stack[reader->top++] = value;
+}
+
+static struct object *read_word(struct reader *reader, const char *word, struct object *value)
+{
+    size_t n = strlen(word);
+
+    if (reader->end - reader->p < n || memcmp(reader->p, word, n) != 0)
+    {
+        return fail(reader, "expected value");
+    }
+    reader->p += n;
+    return value;
+}
+
+/* Integers that do not fit in a long long are handed to AP_fromstr. */
+static struct object *read_number(struct reader *reader)
+{
+    const char *start = reader->p;
+    unsigned long long magnitude = 0;
+    bool overflow = false;
+    bool negative;
+    char *digits;
+    AP_T big;
+    int d;
+
+    negative = *reader->p == '-';
+    reader->p += negative;
+    if (!is_digit(reader->p, reader->end))
+    {
+        return fail(reader, "expected value");
+    }
+    if (*reader->p == '0' && is_digit(reader->p + 1, reader->end))
+    {
+        return fail(reader, "leading zero in number");
+    }
+    while (is_digit(reader->p, reader->end))
+    {
+        d = *reader->p++ - '0';
+        overflow = overflow || magnitude > (ULLONG_MAX - d) / 10;
+        magnitude = magnitude * 10 + d;
+    }
+    if (reader->p < reader->end
+        && (*reader->p == '.' || *reader->p == 'e' || *reader->p == 'E'))
+    {
+        return fail(reader, "numbers must be integers");
+    }
+    if (!overflow && magnitude <= (unsigned long long) LLONG_MAX + negative)
+    {
+        return (struct object *) integer_object_alloc(reader->state,
+                                                      negative ? -(long long) (magnitude - 1) - 1
+                                                      : (long long) magnitude);
+    }
+    digits = ALLOC(reader->p - start + 1);
+    memcpy(digits, start, reader->p - start);
+    digits[reader->p - start] = '\0';
+    big = AP_fromstr(digits, 10, NULL);
+    FREE(digits);
+    return integer_object_from_ap(reader->state, big);
+}
+
+/* The four hex digits at p as a number, or -1. */
+static int hex4(const char *p, const char *end)
+{
+    int c = 0;
+
+    if (end - p < 4)
+    {
+        return -1;
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        c <<= 4;
+        if (p[i] >= '0' && p[i] <= '9')
+        {
+            c |= p[i] - '0';
+        }
+        else if ((p[i] | 0x20) >= 'a' && (p[i] | 0x20) <= 'f')
+        {
+            c |= (p[i] | 0x20) - 'a' + 10;
+        }
+        else
+        {
+            return -1;
+        }
+    }
+    return c;
+}
+
+static char *put_utf8(char *q, unsigned c)
+{
+    if (c < 0x80)
+    {
+        *q++ = c;
+    }
+    else if (c < 0x800)
+    {
+        *q++ = 0xc0 | c >> 6;
+        *q++ = 0x80 | (c & 0x3f);
+    }
+    else if (c < 0x10000)
+    {
+        *q++ = 0xe0 | c >> 12;
+        *q++ = 0x80 | (c >> 6 & 0x3f);
+        *q++ = 0x80 | (c & 0x3f);
+    }
+    else
+    {
+        *q++ = 0xf0 | c >> 18;
+        *q++ = 0x80 | (c >> 12 & 0x3f);
+        *q++ = 0x80 | (c >> 6 & 0x3f);
+        *q++ = 0x80 | (c & 0x3f);
+    }
+    return q;
+}
+
+/* Decodes the escapes between p and end; no escape makes its string longer. */
+static struct object *unescape(struct reader *reader, const char *p, const char *end)
+{
+    char *value;
+    const char *escape;
+    char *q;
+    int c;
+    int low;
+
+    q = value = ALLOC(end - p + 1);
+    while (p < end)
+    {
+        if (*p != '\\')
+        {
+            *q++ = *p++;
+            continue;
+        }
+        escape = p++;
+        switch (*p++)
+        {
+        case '"':
+        case '\\':
+        case '/':
+        {
+            *q++ = p[-1];
+            break;
+        }
+        case 'b':
+        {
+            *q++ = '\b';
+            break;
+        }
+        case 'f':
+        {
+            *q++ = '\f';
+            break;
+        }
+        case 'n':
+        {
+            *q++ = '\n';
+            break;
+        }
+        case 'r':
+        {
+            *q++ = '\r';
+            break;
+        }
+        case 't':
+        {
+            *q++ = '\t';
+            break;
+        }
+        case 'u':
+        {
+            if ((c = hex4(p, end)) < 0)
+            {
+                goto error;
+            }
+            p += 4;
+            /* A surrogate pair is one code point; a lone surrogate is kept as it is. */
+            if (c >= 0xd800 && c < 0xdc00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u'
+                && (low = hex4(p + 2, end)) >= 0xdc00 && low < 0xe000)
+            {
+                c = 0x10000 + ((c - 0xd800) << 10) + (low - 0xdc00);
+                p += 6;
+            }
+            q = put_utf8(q, c);
+            break;
+        }
+        default:
+        {
+            goto error;
+        }
+        }
+    }
+    *q = '\0';
+    return (struct object *) string_object_take(reader->state, value, q - value);
+
+error:
+    FREE(value);
+    reader->p = escape;
+    return fail(reader, "invalid escape in string");
+}
+
+static struct object *read_string(struct reader *reader)
+{
+    const char *start = ++reader->p;
+    const char *p = start;
+    bool escaped = false;
+
+    while (p < reader->end && *p != '"')
+    {
+        if ((unsigned char) *p < 0x20)
+        {
+            reader->p = p;
+            return fail(reader, "control character in string");
+        }
+        if (*p == '\\')
+        {
+            escaped = true;
+            p++;
+        }
+        p++;
+    }
+    if (p >= reader->end)
+    {
+        reader->p = reader->end;
+        return fail(reader, "unterminated string");
+    }
+    reader->p = p + 1;
+    if (escaped)
+    {
+        return unescape(reader, start, p);
+    }
+    return (struct object *) string_slice_alloc(reader->state, reader->text,
+                                                start - reader->text->value, p - start);
+}
+
+static struct object *read_array(struct reader *reader)
+{
+    int base = reader->top;
+    struct object *value;
+    Seq_T elements;
+
+    reader->p++;
+    skip_space(reader);
+    if (reader->p < reader->end && *reader->p == ']')
+    {
+        reader->p++;
+        return (struct object *) array_object_alloc(reader->state, Seq_new(0));
+    }
+    for (;;)
+    {
+        if ((value = read_value(reader)) == NULL)
+        {
+            reader->top = base;
+            return NULL;
+        }
+        push(reader, value);
+        skip_space(reader);
+        if (reader->p < reader->end && *reader->p == ',')
+        {
+            reader->p++;
+        }
+        else if (reader->p < reader->end && *reader->p == ']')
+        {
+            reader->p++;
+            break;
+        }
+        else
+        {
+            reader->top = base;
+            return fail(reader, "expected ',' or ']'");
+        }
+    }
+    elements = Seq_new(reader->top - base);
+    for (int i = base; i < reader->top; i++)
+    {
+        Seq_addhi(elements, reader->stack[i]);
+    }
+    reader->top = base;
+    return (struct object *) array_object_alloc(reader->state, elements);
+}
+
+/* Pairs go straight into a trie; a repeated key keeps its last value. */
+static struct object *read_object(struct reader *reader)
+{
+    struct hamt_node *pairs = NULL;
+    struct object *key;
+    struct object *value;
+    bool added;
+    int length = 0;
+
+    reader->p++;
+    skip_space(reader);
+    if (reader->p < reader->end && *reader->p == '}')
+    {
+        reader->p++;
+        return (struct object *) hash_object_take(reader->state, NULL, 0);
+    }
+    for (;;)
+    {
+        skip_space(reader);
+        if (reader->p == reader->end || *reader->p != '"')
+        {
+            fail(reader, "expected string key");
+            goto error;
+        }
+        if ((key = read_string(reader)) == NULL)
+        {
+            goto error;
+        }
+        skip_space(reader);
+        if (reader->p == reader->end || *reader->p != ':')
+        {
+            fail(reader, "expected ':'");
+            goto error;
+        }
+        reader->p++;
+        if ((value = read_value(reader)) == NULL)
+        {
+            goto error;
+        }
+        pairs = hamt_put(pairs, key, value, &added);
+        length += added;
+        skip_space(reader);
+        if (reader->p < reader->end && *reader->p == ',')
+        {
+            reader->p++;
+        }
+        else if (reader->p < reader->end && *reader->p == '}')
+        {
+            reader->p++;
+            break;
+        }
+        else
+        {
+            fail(reader, "expected ',' or '}'");
+            goto error;
+        }
+    }
+    return (struct object *) hash_object_take(reader->state, pairs, length);
+
+error:
+    hamt_free(pairs);
+    return NULL;
+}
+
+static struct object *read_value(struct reader *reader)
+{
+    struct object *value;
+
+    skip_space(reader);
+    if (reader->p == reader->end)
+    {
+        return fail(reader, "expected value");
+    }
+    if (reader->depth == MAX_DEPTH)
+    {
+        return fail(reader, "nested too deeply");
+    }
+    reader->depth++;
+    switch (*reader->p)
+    {
+    case '{':
+    {
+        value = read_object(reader);
+        break;
+    }
+    case '[':
+    {
+        value = read_array(reader);
+        break;
+    }
+    case '"':
+    {
+        value = read_string(reader);
+        break;
+    }
+    case 't':
+    {
+        value = read_word(reader, "true", (struct object *) &true_object);
+        break;
+    }
+    case 'f':
+    {
+        value = read_word(reader, "false", (struct object *) &false_object);
+        break;
+    }
+    case 'n':
+    {
+        value = read_word(reader, "null", (struct object *) &null_object);
+        break;
+    }
+    default:
+    {
+        value = read_number(reader);
+        break;
+    }
+    }
+    reader->depth--;
+    return value;
+}
+
+struct object *json_parse(struct interpreter_state *state, struct string_object *text)
+{
+    struct reader reader;
+    struct object *value;
+
+    reader.state = state;
+    reader.text = text;
+    reader.p = text->value;
+    reader.end = text->value + text->length;
+    reader.depth = 0;
+    reader.size = 64;
+    reader.stack = ALLOC(reader.size * sizeof *reader.stack);
+    reader.top = 0;
+    reader.error = NULL;
+    value = read_value(&reader);
+    skip_space(&reader);
+    if (value != NULL && reader.p != reader.end)
+    {
+        value = fail(&reader, "unexpected data after value");
+    }
+    FREE(reader.stack);
+    return value != NULL ? value : reader.error;
+}
+
+static void reserve(struct writer *writer, size_t n)
+{
+    if (writer->length + n <= writer->size)
+    {
+        return;
+    }
+    writer->size = 2 * writer->size > writer->length + n ? 2 * writer->size : writer->length + n;
+    RESIZE(writer->data, writer->size);
+}
+
+static void write_bytes(struct writer *writer, const char *s, size_t n)
+{
+    reserve(writer, n);
+    memcpy(writer->data + writer->length, s, n);
+    writer->length += n;
+}
+
+static void write_char(struct writer *writer, char c)
+{
+    reserve(writer, 1);
+    writer->data[writer->length++] = c;
+}
+
+static void write_integer(struct writer *writer, long long value)
+{
+    /* "-9223372036854775808" and sprintf's NUL. */
+    reserve(writer, 21);
+    writer->length += sprintf(writer->data + writer->length, "%lld", value);
+}
+
+/* Copies the runs between characters that need escapes in one go. */
+static void write_string(struct writer *writer, const char *s, int n)
+{
+    static const char hex[] = "0123456789abcdef";
+    char escape[6] = { '\\', 'u', '0', '0' };
+    unsigned char c;
+    int run = 0;
+
+    write_char(writer, '"');
+    for (int i = 0; i < n; i++)
+    {
+        c = s[i];
+        if (c >= 0x20 && c != '"' && c != '\\')
+        {
+            continue;
+        }
+        write_bytes(writer, s + run, i - run);
+        run = i + 1;
+        switch (c)
+        {
+        case '"':
+        case '\\':
+        {
+            escape[1] = c;
+            write_bytes(writer, escape, 2);
+            break;
+        }
+        case '\n':
+        {
+            write_bytes(writer, "\\n", 2);
+            break;
+        }
+        case '\r':
+        {
+            write_bytes(writer, "\\r", 2);
+            break;
+        }
+        case '\t':
+        {
+            write_bytes(writer, "\\t", 2);
+            break;
+        }
+        default:
+        {
+            escape[1] = 'u';
+            escape[4] = hex[c >> 4];
+            escape[5] = hex[c & 0xf];
+            write_bytes(writer, escape, 6);
+            break;
+        }
+        }
+    }
+    write_bytes(writer, s + run, n - run);
+    write_char(writer, '"');
+}
+
+static void write_pair(struct object *key, struct object *value, void *cl)
+{
+    struct pair_writer *pairs = cl;
+    struct writer *writer = pairs->writer;
+    char *name;
+
+    if (pairs->count++ > 0)
+    {
+        write_char(writer, ',');
+    }
+    if (key->type == STRING_OBJ)
+    {
+        write_string(writer, ((struct string_object *) key)->value,
+                     ((struct string_object *) key)->length);
+    }
+    else
+    {
+        name = object_inspect(key);
+        write_string(writer, name, strlen(name));
+        FREE(name);
+    }
+    write_char(writer, ':');
+    write_value(writer, value);
+}
+
+static void write_value(struct writer *writer, struct object *value)
+{
+    struct array_object *array;
+    struct pair_writer pairs;
+    char *digits;
+
+    if (writer->unwritable != NULL)
+    {
+        return;
+    }
+    switch (value->type)
+    {
+    case INTEGER_OBJ:
+    {
+        write_integer(writer, ((struct integer_object *) value)->value);
+        break;
+    }
+    case BIG_INTEGER_OBJ:
+    {
+        digits = object_inspect(value);
+        write_bytes(writer, digits, strlen(digits));
+        FREE(digits);
+        break;
+    }
+    case BOOLEAN_OBJ:
+    {
+        if (((struct boolean_object *) value)->value)
+        {
+            write_bytes(writer, "true", 4);
+        }
+        else
+        {
+            write_bytes(writer, "false", 5);
+        }
+        break;
+    }
+    case NULL_OBJ:
+    {
+        write_bytes(writer, "null", 4);
+        break;
+    }
+    case STRING_OBJ:
+    {
+        write_string(writer, ((struct string_object *) value)->value,
+                     ((struct string_object *) value)->length);
+        break;
+    }
+    case ARRAY_OBJ:
+    {
+        array = (struct array_object *) value;
+        write_char(writer, '[');
+        for (int i = 0; i < array->length; i++)
+        {
+            if (i > 0)
+            {
+                write_char(writer, ',');
+            }
+            if (array->ints != NULL)
+            {
+                write_integer(writer, array->ints[i]);
+            }
+            else
+            {
+                write_value(writer, (struct object *) Seq_get(array->elements, i));
+            }
+        }
+        write_char(writer, ']');
+        break;
+    }
+    case RANGE_OBJ:
+    {
+        write_char(writer, '[');
+        for (long long i = 0; i < ((struct range_object *) value)->length; i++)
+        {
+            if (i > 0)
+            {
+                write_char(writer, ',');
+            }
+            write_integer(writer, range_get((struct range_object *) value, i));
+        }
+        write_char(writer, ']');
+        break;
+    }
+    case HASH_OBJ:
+    {
+        pairs.writer = writer;
+        pairs.count = 0;
+        write_char(writer, '{');
+        hamt_map(((struct hash_object *) value)->pairs, write_pair, &pairs);
+        write_char(writer, '}');
+        break;
+    }
+    default:
+    {
+        writer->unwritable = value;
+        break;
+    }
+    }
+}
+
+struct object *json_stringify(struct interpreter_state *state, struct object *value)
+{
+    struct writer writer;
+
+    writer.size = 64;
+    writer.data = ALLOC(writer.size);
+    writer.length = 0;
+    writer.unwritable = NULL;
+    write_value(&writer, value);
+    if (writer.unwritable != NULL || writer.length > INT_MAX)
+    {
+        FREE(writer.data);
+        if (writer.unwritable != NULL)
+        {
+            return (struct object *) error_object_alloc(state, "first argument to 'json_stringify' holds %s, which JSON cannot represent",
+                                                        object_type_str[writer.unwritable->type]);
+        }
+        return (struct object *) error_object_alloc(state, "result of 'json_stringify' is too long, got %d bytes or more",
+                                                    INT_MAX);
+    }
+    /* The buffer may be twice what is needed, and the string keeps it. */
+    RESIZE(writer.data, writer.length + 1);
+    writer.data[writer.length] = '\0';
+    return (struct object *) string_object_take(state, writer.data, writer.length);
+}
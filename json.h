@@ -0,0 +1,20 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include "object.h"
+
+/*
+ * The one JSON value text holds, or an error object.  Objects become
+ * hashes, and numbers become integers, big ones if they must; numbers
+ * with a fraction or exponent are errors, as Monkey has no floats.
+ * Strings without escapes are slices of text, so they keep it alive.
+ */
+struct object *json_parse(struct interpreter_state *state, struct string_object *text);
+/*
+ * value as a JSON string, or an error object if it holds something
+ * JSON cannot: a function, builtin or error.  Ranges are written as
+ * arrays, and integer and boolean hash keys as strings.
+ */
+struct object *json_stringify(struct interpreter_state *state, struct object *value);
+
+#endif
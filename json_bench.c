@@ -0,0 +1,125 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <mem.h>
+
+#include "compile.h"
+#include "object.h"
+#include "state.h"
+
+/* The literal program is compiled whole, so it is timed on less. */
+#define LITERAL_MB 10
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * An array of records like {"id": 7, "name": "user7", "tags": ["a",
+ * "b"], "score": 49, "active": true}.  It has no escapes or nulls, so it
+ * is a Monkey literal too.
+ */
+static char *make_json(size_t bytes, int *length, int *records)
+{
+    static const char *tags[] = { "admin", "staff", "guest", "beta" };
+    char *json;
+    char *p;
+    int i;
+
+    p = json = ALLOC(bytes + 256);
+    *p++ = '[';
+    for (i = 0; p - json < bytes; i++)
+    {
+        p += sprintf(p, "%s{\"id\": %d, \"name\": \"user%d\", \"tags\": [\"%s\", \"%s\"], "
+                     "\"score\": %d, \"active\": %s}",
+                     i > 0 ? ", " : "", i, i * 31 % 100000, tags[i % 4], tags[i * 7 % 4],
+                     i * 49 % 1000003, i % 3 ? "true" : "false");
+    }
+    *p++ = ']';
+    *p = '\0';
+    *length = p - json;
+    *records = i;
+    return json;
+}
+
+/* records is what the program should return, or -1 for any integer. */
+static double run(struct interpreter_state *state, const char *source, const char *json,
+                  int length, int records)
+{
+    struct compiled_program *compiled;
+    struct hash_object *inputs;
+    struct object *object;
+    Table_T pairs;
+    double start;
+    double secs;
+
+    /* A fresh input each time; the last run's garbage is collected untimed. */
+    objects_gc(state, env_object_alloc(state, NULL));
+    pairs = Table_new(1, object_cmp, object_hash);
+    Table_put(pairs, string_object_alloc(state, (Text_T) { 4, "json" }),
+              string_object_alloc(state, (Text_T) { length, json }));
+    inputs = hash_object_alloc(state, pairs);
+    start = now();
+    compiled = compiled_program_alloc(source);
+    object = compiled_program_run(state, compiled, inputs);
+    secs = now() - start;
+    if (object->type != INTEGER_OBJ
+        || (records >= 0 && ((struct integer_object *) object)->value != records))
+    {
+        printf("failed: %.60s\n", object_inspect(object));
+    }
+    compiled_program_destroy(compiled);
+    return secs;
+}
+
+/* How JSON was read before json_parse: spliced into a program as a literal. */
+static double run_literal(struct interpreter_state *state, const char *json, int length,
+                          int records)
+{
+    char *source;
+    double secs;
+
+    source = ALLOC(length + 16);
+    sprintf(source, "len(%s)", json);
+    secs = run(state, source, "", 0, records);
+    FREE(source);
+    return secs;
+}
+
+int main(int argc, char *argv[])
+{
+    struct interpreter_state *state;
+    char *json;
+    int length;
+    int records;
+    double base;
+    double secs;
+    int mb;
+
+    mb = argc > 1 ? atoi(argv[1]) : 100;
+    state = interpreter_state_alloc();
+    json = make_json(LITERAL_MB * 1000000, &length, &records);
+    printf("%d records, %d bytes\n", records, length);
+    base = run_literal(state, json, length, records);
+    secs = run(state, "len(json_parse(json))", json, length, records);
+    printf("literal %.4f s, json_parse %.4f s, speedup %.1f\n", base, secs, base / secs);
+    FREE(json);
+
+    json = make_json(mb * (size_t) 1000000, &length, &records);
+    printf("%d records, %d bytes\n", records, length);
+    secs = run(state, "len(json_parse(json))", json, length, records);
+    printf("json_parse %.4f s, %.1f MB/s\n", secs, length / secs / 1e6);
+    base = secs;
+    secs = run(state, "len(json_stringify(json_parse(json)))", json, length, -1) - base;
+    printf("json_stringify %.4f s, %.1f MB/s\n", secs, length / secs / 1e6);
+    FREE(json);
+    interpreter_state_destroy(state);
+    return EXIT_SUCCESS;
+}
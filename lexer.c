@@ -2,126 +2,224 @@
 #include <string.h>
 #include <stdbool.h>
 #include <mem.h>
-#include <table.h>
 #include "lexer.h"
 #include "token.h"
-#include "util.h"
+#include "scan.h"
+#include "source.h"
 
-static Table_T keywords;
-
-static bool is_letter(char ch)
-{
-    return ('a' <= ch && ch <= 'z') || ('A' <= ch && ch <= 'Z') || ch == '_';
-}
-
-static bool is_digit(char ch)
-{
-    return '0' <= ch && ch <= '9';
-}
+#define SOURCE_CHUNK (64 * 1024)
 
+/*
+ * The keyword set is fixed, so a switch on length and first character
+ * selects the only possible candidate and one memcmp confirms it.
+ */
 static enum token_type lookup_ident(Text_T *ident)
 {
+    const char *str = ident->str;
+    const char *keyword;
     enum token_type type;
 
-    type = (enum token_type) Table_get(keywords, ident);
-    if (type != ILLEGAL)
+    switch (ident->len)
+    {
+    case 2:
+    {
+        if (str[0] == 'f')
+        {
+            keyword = "fn";
+            type = FUNCTION;
+        }
+        else if (str[0] == 'i')
+        {
+            keyword = "if";
+            type = IF;
+        }
+        else
+        {
+            return IDENT;
+        }
+        break;
+    }
+    case 3:
+    {
+        keyword = "let";
+        type = LET;
+        break;
+    }
+    case 4:
+    {
+        if (str[0] == 't')
+        {
+            keyword = "true";
+            type = TRUE;
+        }
+        else if (str[0] == 'e')
+        {
+            keyword = "else";
+            type = ELZE;
+        }
+        else
+        {
+            return IDENT;
+        }
+        break;
+    }
+    case 5:
+    {
+        keyword = "false";
+        type = FALSE;
+        break;
+    }
+    case 6:
+    {
+        keyword = "return";
+        type = RET;
+        break;
+    }
+    default:
+    {
+        return IDENT;
+    }
+    }
+    if (memcmp(str, keyword, ident->len) == 0)
     {
         return type;
     }
     return IDENT;
 }
 
+/* Text_box without the out-of-line call and argument checks. */
+static Text_T text_box(const char *str, int len)
+{
+    Text_T text;
+
+    text.len = len;
+    text.str = str;
+    return text;
+}
+
 static void read_char(struct lexer *lexer)
 {
-    if (lexer->read_position >= lexer->input_length)
-    {
-        lexer->ch = '\0';
-    }
-    else
+    lexer->ch = *++lexer->position;
+}
+
+/*
+ * Called when a scan stops on '\0'.  If that is the end of a source
+ * buffer, refills it keeping the text from *start and rebases *start, p
+ * and the lexer's position.  Returns whether there is more to scan.
+ */
+static bool refill(struct lexer *lexer, const char **start, const char **p)
+{
+    size_t offset = *p - *start;
+    bool more;
+
+    if (lexer->source == NULL || *p != lexer->source->limit)
     {
-        lexer->ch = lexer->input[lexer->read_position];
+        return false;
     }
-    lexer->position = lexer->read_position;
-    lexer->read_position++;
+    more = source_refill(lexer->source, start);
+    *p = *start + offset;
+    lexer->position = *start;
+    return more;
 }
 
+/* Only called when the current character is not the sentinel. */
 static char peek_char(struct lexer *lexer)
 {
-    if (lexer->read_position >= lexer->input_length)
+    const char *start = lexer->position;
+    const char *p = start + 1;
+
+    if (*p == '\0')
     {
-        return '\0';
+        refill(lexer, &start, &p);
     }
-    else
+    return *p;
+}
+
+/*
+ * Most runs are short, so the first SHORT_RUN characters are matched
+ * inline and only longer runs are handed to the vector scanner.
+ */
+#define SHORT_RUN 4
+
+static const char *scan_run(const char *p, enum char_class class,
+                            const char *(*scan)(const char *))
+{
+    for (int i = 0; i < SHORT_RUN; i++, p++)
     {
-        return lexer->input[lexer->read_position];
+        if (!(char_class[(unsigned char) *p] & class))
+        {
+            return p;
+        }
     }
-    lexer->position = lexer->read_position;
-    lexer->read_position++;
+    return scan(p);
 }
 
 static Text_T read_identifier(struct lexer *lexer)
 {
-    int position = lexer->position;
-    
-    while (is_letter(lexer->ch))
+    const char *start = lexer->position;
+    const char *p;
+
+    p = scan_run(start + 1, LETTER, lexer->scan->letters);
+    while (*p == '\0' && refill(lexer, &start, &p))
     {
-        read_char(lexer);
+        p = scan_run(p, LETTER, lexer->scan->letters);
     }
-
-    return Text_box(lexer->input + position, lexer->position - position);
+    lexer->position = p;
+    lexer->ch = *p;
+    return text_box(start, p - start);
 }
 
 static Text_T read_number(struct lexer *lexer)
 {
-    int position = lexer->position;
-    
-    while (is_digit(lexer->ch))
+    const char *start = lexer->position;
+    const char *p;
+
+    p = scan_run(start + 1, DIGIT, lexer->scan->digits);
+    while (*p == '\0' && refill(lexer, &start, &p))
     {
-        read_char(lexer);
+        p = scan_run(p, DIGIT, lexer->scan->digits);
     }
-
-    return Text_box(lexer->input + position, lexer->position - position);
+    lexer->position = p;
+    lexer->ch = *p;
+    return text_box(start, p - start);
 }
 
 static Text_T read_string(struct lexer *lexer)
 {
-    int position = lexer->position + 1;
+    const char *start = lexer->position + 1;
+    const char *p = start;
 
-    do
+    for (int i = 0; i < SHORT_RUN; i++, p++)
     {
-        read_char(lexer);
-    } while (lexer->ch != '"' && lexer->ch != '\0');
-
-    return Text_box(lexer->input + position, lexer->position - position);
-}
+        if (*p == '"' || *p == '\0')
+        {
+            goto done;
+        }
+    }
+    p = lexer->scan->string(p);
 
-static void skip_whitespace(struct lexer *lexer)
-{
-    while (lexer->ch == ' ' || lexer->ch == '\t' || lexer->ch == '\n'
-           || lexer->ch == '\r')
+done:
+    while (*p == '\0' && refill(lexer, &start, &p))
     {
-        read_char(lexer);
+        p = lexer->scan->string(p);
     }
+    lexer->position = p;
+    lexer->ch = *p;
+    return text_box(start, p - start);
 }
 
-void lexer_init(void)
+static void skip_whitespace(struct lexer *lexer)
 {
-    static struct token tokens[] =
-        {
-            {LET, {sizeof "let" - 1, "let"}},
-            {FUNCTION, {sizeof "fn" - 1, "fn"}},
-            {TRUE, {sizeof "true" - 1, "true"}},
-            {FALSE, {sizeof "false" - 1, "false"}},
-            {IF, {sizeof "if" - 1, "if"}},
-            {ELZE, {sizeof "else" - 1, "else"}},
-            {RET, {sizeof "return" - 1, "return"}}
-        };
-    
-    keywords = Table_new(0, text_cmp, text_hash);
-    for (int i = 0; i < (sizeof tokens / sizeof tokens[0]); i++)
-    {
-        Table_put(keywords, &tokens[i].literal, (void *) tokens[i].type);
+    const char *p;
+
+    p = scan_run(lexer->position, SPACE, lexer->scan->space);
+    /* Whitespace is never kept across a refill, so the run starts at p. */
+    while (*p == '\0' && refill(lexer, &p, &p))
+    {
+        p = scan_run(p, SPACE, lexer->scan->space);
     }
+    lexer->position = p;
+    lexer->ch = *p;
 }
 
 struct lexer *lexer_alloc(const char *input)
@@ -129,16 +227,30 @@ struct lexer *lexer_alloc(const char *input)
     struct lexer *lexer;
 
     NEW0(lexer);
-    lexer->input_length = strlen(input);
     lexer->input = input;
-    lexer->position = 0;
-    lexer->read_position = 0;
-    read_char(lexer);
+    lexer->position = input;
+    lexer->ch = *input;
+    lexer->scan = scanner_best();
+    return lexer;
+}
+
+struct lexer *lexer_alloc_fd(int fd)
+{
+    struct lexer *lexer;
+    struct source *source;
+
+    source = source_alloc(fd, SOURCE_CHUNK);
+    lexer = lexer_alloc(source->buffer);
+    lexer->source = source;
     return lexer;
 }
 
 void lexer_destroy(struct lexer *lexer)
 {
+    if (lexer->source != NULL)
+    {
+        source_destroy(lexer->source);
+    }
     FREE(lexer);
 }
 
@@ -156,25 +268,25 @@ struct token lexer_next_token(struct lexer *lexer)
         {
             read_char(lexer);
             token.type = EQ;
-            token.literal = Text_box("==", sizeof "==" - 1);
+            token.literal = text_box("==", sizeof "==" - 1);
         }
         else
         {
             token.type = ASSIGN;
-            token.literal = Text_box("=", sizeof "=" - 1);
+            token.literal = text_box("=", sizeof "=" - 1);
         }
         break;
     }
     case '+':
     {
         token.type = PLUS;
-        token.literal = Text_box("+", sizeof "+" - 1);
+        token.literal = text_box("+", sizeof "+" - 1);
         break;
     }
     case '-':
     {
         token.type = MINUS;
-        token.literal = Text_box("-", sizeof "-" - 1);
+        token.literal = text_box("-", sizeof "-" - 1);
         break;
     }
     case '!':
@@ -183,104 +295,108 @@ struct token lexer_next_token(struct lexer *lexer)
         {
             read_char(lexer);
             token.type = NOT_EQ;
-            token.literal = Text_box("!=", sizeof "!=" - 1);
+            token.literal = text_box("!=", sizeof "!=" - 1);
         }
         else
         {
             token.type = BANG;
-            token.literal = Text_box("!", sizeof "!" - 1);
+            token.literal = text_box("!", sizeof "!" - 1);
         }
         break;
     }
     case '/':
     {
         token.type = SLASH;
-        token.literal = Text_box("/", sizeof "/" - 1);
+        token.literal = text_box("/", sizeof "/" - 1);
         break;
     }
     case '*':
     {
         token.type = ASTERISK;
-        token.literal = Text_box("*", sizeof "*" - 1);
+        token.literal = text_box("*", sizeof "*" - 1);
         break;
     }
     case '<':
     {
         token.type = LT;
-        token.literal = Text_box("<", sizeof "<" - 1);
+        token.literal = text_box("<", sizeof "<" - 1);
         break;
     }
     case '>':
     {
         token.type = GT;
-        token.literal = Text_box(">", sizeof ">" - 1);
+        token.literal = text_box(">", sizeof ">" - 1);
         break;
     }
     case ';':
     {
         token.type = SEMICOLON;
-        token.literal = Text_box(";", sizeof ";" - 1);
+        token.literal = text_box(";", sizeof ";" - 1);
         break;
     }
     case '(':
     {
         token.type = LPAREN;
-        token.literal = Text_box("(", sizeof "(" - 1);
+        token.literal = text_box("(", sizeof "(" - 1);
         break;
     }
     case ')':
     {
         token.type = RPAREN;
-        token.literal = Text_box(")", sizeof ")" - 1);
+        token.literal = text_box(")", sizeof ")" - 1);
         break;
     }
     case ',':
     {
         token.type = COMMA;
-        token.literal = Text_box(",", sizeof "," - 1);
+        token.literal = text_box(",", sizeof "," - 1);
         break;
     }
     case '{':
     {
         token.type = LBRACE;
-        token.literal = Text_box("{", sizeof "{" - 1);
+        token.literal = text_box("{", sizeof "{" - 1);
         break;
     }
     case '}':
     {
         token.type = RBRACE;
-        token.literal = Text_box("}", sizeof "}" - 1);
+        token.literal = text_box("}", sizeof "}" - 1);
         break;
     }
     case '[':
     {
         token.type = LBRAKET;
-        token.literal = Text_box("[", sizeof "[" - 1);
+        token.literal = text_box("[", sizeof "[" - 1);
         break;
     }
     case ']':
     {
         token.type = RBRAKET;
-        token.literal = Text_box("]", sizeof "]"- 1);
+        token.literal = text_box("]", sizeof "]"- 1);
         break;
     }
     case ':':
     {
         token.type = COLON;
-        token.literal = Text_box(":", sizeof ":" - 1);
+        token.literal = text_box(":", sizeof ":" - 1);
         break;
     }
     case '"':
     {
         token.type = STRING;
         token.literal = read_string(lexer);
+        if (lexer->ch == '\0')
+        {
+            return token;
+        }
         break;
     }
     case '\0':
     {
         token.type = END;
-        token.literal = Text_box("", sizeof "");
-        break;
+        token.literal = text_box("", sizeof "");
+        return token;
     }
     default:
     {
@@ -299,7 +415,7 @@ struct token lexer_next_token(struct lexer *lexer)
         else
         {
             token.type = ILLEGAL;
-            token.literal = Text_box(lexer->input + lexer->position, 1);
+            token.literal = text_box(lexer->position, 1);
         }
     }
     }
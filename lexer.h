@@ -1,17 +1,26 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include "scan.h"
+#include "source.h"
+
+/*
+ * The input must be terminated by a '\0' sentinel.  Every scan loop
+ * stops at the sentinel, so none of them need a bounds check.  When
+ * reading from a source, a sentinel at the end of its buffer triggers a
+ * refill; token literals stay valid until the next token but one.
+ */
 struct lexer
 {
-    int input_length;
     const char *input;
-    int position;
-    int read_position;
+    const char *position;
     char ch;
+    const struct scanner *scan;
+    struct source *source;
 };
 
-void lexer_init(void);
 struct lexer *lexer_alloc(const char *input);
+struct lexer *lexer_alloc_fd(int fd);
 void lexer_destroy(struct lexer *lexer);
 struct token lexer_next_token(struct lexer *lexer);
 #endif
@@ -0,0 +1,123 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <mem.h>
+
+#include "token.h"
+#include "lexer.h"
+#include "scan.h"
+
+#define INPUT_SZ (8 * 1024 * 1024)
+#define ROUNDS 20
+
+/* The same program lexer_test checks. */
+static const char *program = "let five = 5;"
+    "let ten = 10;"
+    "let add = fn(x, y) {"
+    "x + y;"
+    "};"
+    "let result = add(five, ten);"
+    "!-/*5;"
+    "5 < 10 > 5;"
+    "if (5 < 10) {"
+    "return true;"
+    "} else {"
+    "return false;"
+    "}"
+    "10 == 10;"
+    "10 != 9;"
+    "\"foobar\""
+    "\"foo bar\""
+    "[1, 2];"
+    "{\"foo\": \"bar\"}\n";
+
+/* Generated data: indentation, long keys and strings, wide numbers. */
+static const char *data = "        {\n"
+    "            \"transaction_identifier\": \"c0ffee-4b1d-4e5f-9a8b-7c6d5e4f3a2b1c0d\",\n"
+    "            \"account_balance_in_cents\": 12345678901234,\n"
+    "            \"description\": \"monthly subscription renewal for premium service tier\",\n"
+    "            \"category\": merchant_category_code_subscription_services\n"
+    "        },\n";
+
+static char *make_input(const char *snippet, size_t size)
+{
+    size_t len = strlen(snippet);
+    size_t n = size / len;
+    char *input;
+
+    input = ALLOC(n * len + 1);
+    for (size_t i = 0; i < n; i++)
+    {
+        memcpy(input + i * len, snippet, len);
+    }
+    input[n * len] = '\0';
+    return input;
+}
+
+static long lex_all(const char *input, const struct scanner *scanner)
+{
+    struct lexer *lexer;
+    struct token token;
+    long count = 0;
+
+    lexer = lexer_alloc(input);
+    lexer->scan = scanner;
+    do
+    {
+        token = lexer_next_token(lexer);
+        count++;
+    } while (token.type != END);
+    lexer_destroy(lexer);
+    return count;
+}
+
+static void bench(const char *name, const char *input, const struct scanner *scanner)
+{
+    long tokens = 0;
+    size_t mb = strlen(input);
+    clock_t start;
+    double secs;
+
+    lex_all(input, scanner);
+    start = clock();
+    for (int i = 0; i < ROUNDS; i++)
+    {
+        tokens += lex_all(input, scanner);
+    }
+    secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+    printf("%-8s %-7s %ld tokens in %.3f s: %6.1f Mtokens/s, %7.1f MB/s\n",
+           name, scanner->name, tokens, secs, tokens / secs / 1e6,
+           ROUNDS * mb / secs / (1024 * 1024));
+}
+
+int main(void)
+{
+    enum scanner_kind kinds[] = { SCALAR_SCANNER, SSE2_SCANNER, AVX2_SCANNER };
+    struct corpus
+    {
+        const char *name;
+        char *input;
+    } corpora[] =
+          {
+              { "program", NULL },
+              { "data", NULL }
+          };
+    const struct scanner *scanner;
+
+    corpora[0].input = make_input(program, INPUT_SZ);
+    corpora[1].input = make_input(data, INPUT_SZ);
+    for (int i = 0; i < sizeof corpora / sizeof corpora[0]; i++)
+    {
+        for (int j = 0; j < sizeof kinds / sizeof kinds[0]; j++)
+        {
+            scanner = scanner_get(kinds[j]);
+            if (scanner != NULL)
+            {
+                bench(corpora[i].name, corpora[i].input, scanner);
+            }
+        }
+        FREE(corpora[i].input);
+    }
+    return EXIT_SUCCESS;
+}
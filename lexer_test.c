@@ -1,8 +1,13 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <mem.h>
 
 #include "token.h"
 #include "lexer.h"
+#include "scan.h"
 
 static int test_next_token(void)
 {
@@ -119,8 +124,6 @@ static int test_next_token(void)
     struct lexer *lexer = NULL;
     int success = -1;
 
-    Fmt_register('T', Text_fmt);
-    lexer_init();
     lexer = lexer_alloc(input);
     for (int i = 0; i < (sizeof tokens / sizeof tokens[0]); i++)
     {
@@ -145,11 +148,231 @@ cleanup:
     return success;
 }
 
+static int test_keyword_lookalikes(void)
+{
+    const char *input = "lets fnord iff elsewhere tru falsey returns f _ if";
+
+    struct token tokens[] =
+        {
+            {IDENT, {sizeof "lets" - 1, "lets"}},
+            {IDENT, {sizeof "fnord" - 1, "fnord"}},
+            {IDENT, {sizeof "iff" - 1, "iff"}},
+            {IDENT, {sizeof "elsewhere" - 1, "elsewhere"}},
+            {IDENT, {sizeof "tru" - 1, "tru"}},
+            {IDENT, {sizeof "falsey" - 1, "falsey"}},
+            {IDENT, {sizeof "returns" - 1, "returns"}},
+            {IDENT, {sizeof "f" - 1, "f"}},
+            {IDENT, {sizeof "_" - 1, "_"}},
+            {IF, {sizeof "if" - 1, "if"}},
+            {END, {sizeof "", ""}},
+        };
+    struct lexer *lexer = NULL;
+    int success = -1;
+
+    lexer = lexer_alloc(input);
+    for (int i = 0; i < (sizeof tokens / sizeof tokens[0]); i++)
+    {
+        struct token token = lexer_next_token(lexer);
+        if (token.type != tokens[i].type)
+        {
+            Fmt_print("tests[%d] - token type wrong. expected=%d, got=%d\n", 
+                      i, tokens[i].type, token.type);
+            goto cleanup;
+        }
+        if (Text_cmp(token.literal, tokens[i].literal) != 0)
+        {
+            Fmt_print("tests[%d] - token literal wrong. expected=%T, got=%T\n",
+                      i, &tokens[i].literal, &token.literal);
+            goto cleanup;
+        }
+    }
+    success = 0;
+
+cleanup:
+    lexer_destroy(lexer);
+    return success;
+}
+
+static int test_end_of_input(void)
+{
+    const char *inputs[] = { "", "   \n\t", "\"unterminated", "x", "=" };
+    struct lexer *lexer;
+    struct token token;
+
+    for (int i = 0; i < (sizeof inputs / sizeof inputs[0]); i++)
+    {
+        lexer = lexer_alloc(inputs[i]);
+        do
+        {
+            token = lexer_next_token(lexer);
+        } while (token.type != END);
+        /* Asking again must not step past the sentinel. */
+        token = lexer_next_token(lexer);
+        lexer_destroy(lexer);
+        if (token.type != END)
+        {
+            Fmt_print("tests[%d] - token after END wrong. got=%d\n", i, token.type);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int test_streaming(void)
+{
+    const char *snippet = "let add = fn(x, y) { x + y; }; add(12345, 678) != 9; \"a b\";\n";
+    size_t len = strlen(snippet);
+    size_t long_len = 200 * 1024;
+    size_t n = 10000;
+    char *input;
+    char *p;
+    FILE *file;
+    struct lexer *expected;
+    struct lexer *streamed;
+    struct token token;
+    struct token stream_token;
+    int success = -1;
+
+    /* Enough text to cross several buffers, plus one token longer than a buffer. */
+    input = ALLOC(n * len + long_len + 4);
+    p = input;
+    for (size_t i = 0; i < n; i++, p += len)
+    {
+        memcpy(p, snippet, len);
+    }
+    *p++ = '"';
+    memset(p, 'x', long_len);
+    p += long_len;
+    *p++ = '"';
+    *p++ = '=';
+    *p = '\0';
+    file = tmpfile();
+    fwrite(input, 1, p - input, file);
+    rewind(file);
+    expected = lexer_alloc(input);
+    streamed = lexer_alloc_fd(fileno(file));
+    for (int i = 0; ; i++)
+    {
+        token = lexer_next_token(expected);
+        stream_token = lexer_next_token(streamed);
+        if (token.type != stream_token.type
+            || Text_cmp(token.literal, stream_token.literal) != 0)
+        {
+            Fmt_print("tokens[%d] - streamed token wrong. expected=%d, got=%d\n",
+                      i, token.type, stream_token.type);
+            goto cleanup;
+        }
+        if (token.type == END)
+        {
+            break;
+        }
+    }
+    success = 0;
+
+cleanup:
+    lexer_destroy(streamed);
+    lexer_destroy(expected);
+    fclose(file);
+    FREE(input);
+    return success;
+}
+
+/*
+ * Every scanner this machine can run must agree with the scalar one on
+ * runs of each kind, of every length up to past two vectors, starting
+ * at every offset in a block, and ended either by a character just
+ * outside the class or by the terminator.
+ */
+static int test_scanners(void)
+{
+    static const struct
+    {
+        const char *name;
+        const char *run;
+        const char *stops;
+    } kinds[] =
+          {
+              { "space", " \t\n\r", "x!\v\f\x80" },
+              { "letters", "abzAZ_qM", "@[`{0 \x80\xff" },
+              { "digits", "0123456789", "/:a \x80" },
+              { "string", "ab 1\\{\x80\xff\t", "\"" },
+          };
+    static char buf[32 + 70 + 1 + SCAN_PADDING] __attribute__((aligned(32)));
+    const struct scanner *scalar = scanner_get(SCALAR_SCANNER);
+    const struct scanner *scanner;
+    const char *(*scan)(const char *);
+    const char *(*expected)(const char *);
+    const char *run;
+    const char *stop;
+
+    for (int kind = SCALAR_SCANNER; kind <= AVX2_SCANNER; kind++)
+    {
+        if ((scanner = scanner_get(kind)) == NULL)
+        {
+            continue;
+        }
+        for (int k = 0; k < sizeof kinds / sizeof kinds[0]; k++)
+        {
+            scan = k == 0 ? scanner->space : k == 1 ? scanner->letters
+                : k == 2 ? scanner->digits : scanner->string;
+            expected = k == 0 ? scalar->space : k == 1 ? scalar->letters
+                : k == 2 ? scalar->digits : scalar->string;
+            run = kinds[k].run;
+            for (int offset = 0; offset < 32; offset++)
+            {
+                for (int length = 0; length <= 70; length++)
+                {
+                    /* The last pass ends at the terminator. */
+                    for (stop = kinds[k].stops; ; stop++)
+                    {
+                        memset(buf, 0, sizeof buf);
+                        for (int i = 0; i < length; i++)
+                        {
+                            buf[offset + i] = run[(i + offset) % strlen(run)];
+                        }
+                        buf[offset + length] = *stop;
+                        if (scan(buf + offset) != buf + offset + length
+                            || expected(buf + offset) != buf + offset + length)
+                        {
+                            Fmt_print("%s %s scanner wrong at offset %d, length %d, stop %d\n",
+                                      scanner->name, kinds[k].name, offset, length,
+                                      (unsigned char) *stop);
+                            return -1;
+                        }
+                        if (*stop == '\0')
+                        {
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
+
 int main(void)
 {
+    Fmt_register('T', Text_fmt);
     if (test_next_token() != 0)
     {
         return EXIT_FAILURE;
     }
+    if (test_keyword_lookalikes() != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    if (test_end_of_input() != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    if (test_streaming() != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    if (test_scanners() != 0)
+    {
+        return EXIT_FAILURE;
+    }
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,396 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <mem.h>
+#include <seq.h>
+#include <text.h>
+
+#include "monkey.h"
+#include "builtins.h"
+#include "compile.h"
+#include "object.h"
+#include "state.h"
+
+struct monkey
+{
+    struct interpreter_state *state;
+    /* The host_builtin records registered so far. */
+    Seq_T hosts;
+};
+
+struct host_builtin
+{
+    struct monkey *monkey;
+    union
+    {
+        monkey_builtin any;
+        monkey_builtin1 one;
+        monkey_builtin2 two;
+        monkey_builtin3 three;
+    } fn;
+    void *cl;
+};
+
+/* Values are objects; the public type only hides their layout. */
+#define VALUE(object) ((struct monkey_value *) (object))
+#define OBJECT(value) ((struct object *) (value))
+
+struct monkey *monkey_alloc(void)
+{
+    struct monkey *monkey;
+
+    NEW0(monkey);
+    monkey->state = interpreter_state_alloc();
+    monkey->hosts = Seq_new(0);
+    return monkey;
+}
+
+void monkey_destroy(struct monkey *monkey)
+{
+    struct host_builtin *host;
+
+    if (monkey == NULL)
+    {
+        return;
+    }
+    interpreter_state_destroy(monkey->state);
+    while (Seq_length(monkey->hosts) > 0)
+    {
+        host = Seq_remlo(monkey->hosts);
+        FREE(host);
+    }
+    Seq_free(&monkey->hosts);
+    FREE(monkey);
+}
+
+static struct host_builtin *host_alloc(struct monkey *monkey, const char *name, void *cl)
+{
+    struct host_builtin *host;
+
+    assert(name != NULL);
+    NEW0(host);
+    host->monkey = monkey;
+    host->cl = cl;
+    Seq_addhi(monkey->hosts, host);
+    return host;
+}
+
+static struct object *result(struct monkey_value *value)
+{
+    return value != NULL ? OBJECT(value) : (struct object *) &null_object;
+}
+
+/* pmap runs builtins in forks, whose values must be made by the fork. */
+static struct monkey *caller(struct host_builtin *host, struct interpreter_state *state,
+                             struct monkey *fork)
+{
+    if (state == host->monkey->state)
+    {
+        return host->monkey;
+    }
+    fork->state = state;
+    fork->hosts = NULL;
+    return fork;
+}
+
+static struct object *call_host(struct interpreter_state *state, int argc,
+                                struct object **argv, void *cl)
+{
+    struct host_builtin *host = cl;
+    struct monkey fork;
+
+    return result(host->fn.any(caller(host, state, &fork), argc,
+                               (struct monkey_value **) argv, host->cl));
+}
+
+static struct object *call_host1(struct interpreter_state *state, struct object *arg1,
+                                 void *cl)
+{
+    struct host_builtin *host = cl;
+    struct monkey fork;
+
+    return result(host->fn.one(caller(host, state, &fork), VALUE(arg1), host->cl));
+}
+
+static struct object *call_host2(struct interpreter_state *state, struct object *arg1,
+                                 struct object *arg2, void *cl)
+{
+    struct host_builtin *host = cl;
+    struct monkey fork;
+
+    return result(host->fn.two(caller(host, state, &fork), VALUE(arg1), VALUE(arg2),
+                               host->cl));
+}
+
+static struct object *call_host3(struct interpreter_state *state, struct object *arg1,
+                                 struct object *arg2, struct object *arg3, void *cl)
+{
+    struct host_builtin *host = cl;
+    struct monkey fork;
+
+    return result(host->fn.three(caller(host, state, &fork), VALUE(arg1), VALUE(arg2),
+                                 VALUE(arg3), host->cl));
+}
+
+void monkey_register(struct monkey *monkey, const char *name, monkey_builtin fn,
+                     void *cl)
+{
+    struct host_builtin *host;
+
+    assert(fn != NULL);
+    host = host_alloc(monkey, name, cl);
+    host->fn.any = fn;
+    builtins_register(monkey->state, name, call_host, host);
+}
+
+void monkey_register1(struct monkey *monkey, const char *name, monkey_builtin1 fn,
+                      void *cl)
+{
+    struct host_builtin *host;
+
+    assert(fn != NULL);
+    host = host_alloc(monkey, name, cl);
+    host->fn.one = fn;
+    builtins_register1(monkey->state, name, call_host1, host);
+}
+
+void monkey_register2(struct monkey *monkey, const char *name, monkey_builtin2 fn,
+                      void *cl)
+{
+    struct host_builtin *host;
+
+    assert(fn != NULL);
+    host = host_alloc(monkey, name, cl);
+    host->fn.two = fn;
+    builtins_register2(monkey->state, name, call_host2, host);
+}
+
+void monkey_register3(struct monkey *monkey, const char *name, monkey_builtin3 fn,
+                      void *cl)
+{
+    struct host_builtin *host;
+
+    assert(fn != NULL);
+    host = host_alloc(monkey, name, cl);
+    host->fn.three = fn;
+    builtins_register3(monkey->state, name, call_host3, host);
+}
+
+struct monkey_program *monkey_compile(const char *source)
+{
+    return (struct monkey_program *) compiled_program_alloc(source);
+}
+
+void monkey_program_destroy(struct monkey_program *program)
+{
+    compiled_program_destroy((struct compiled_program *) program);
+}
+
+int monkey_program_errors(struct monkey_program *program)
+{
+    return Seq_length(((struct compiled_program *) program)->errors);
+}
+
+const char *monkey_program_error(struct monkey_program *program, int i)
+{
+    return Seq_get(((struct compiled_program *) program)->errors, i);
+}
+
+struct monkey_value *monkey_run(struct monkey *monkey, struct monkey_program *program,
+                                struct monkey_value *inputs)
+{
+    if (inputs != NULL && OBJECT(inputs)->type != HASH_OBJ)
+    {
+        return VALUE(error_object_alloc(monkey->state, "inputs must be HASH, got %s",
+                                        object_type_str[OBJECT(inputs)->type]));
+    }
+    return VALUE(compiled_program_run(monkey->state, (struct compiled_program *) program,
+                                      (struct hash_object *) inputs));
+}
+
+struct monkey_value *monkey_integer(struct monkey *monkey, long long value)
+{
+    return VALUE(integer_object_alloc(monkey->state, value));
+}
+
+struct monkey_value *monkey_boolean(struct monkey *monkey, bool value)
+{
+    return VALUE(boolean_object_alloc(value));
+}
+
+struct monkey_value *monkey_null(struct monkey *monkey)
+{
+    return VALUE(&null_object);
+}
+
+struct monkey_value *monkey_string(struct monkey *monkey, const char *value, size_t len)
+{
+    return VALUE(string_object_alloc(monkey->state, Text_box(value, len)));
+}
+
+struct monkey_value *monkey_array(struct monkey *monkey, int n,
+                                  struct monkey_value *const *elements)
+{
+    Seq_T seq;
+
+    seq = Seq_new(n);
+    for (int i = 0; i < n; i++)
+    {
+        Seq_addhi(seq, OBJECT(elements[i]));
+    }
+    return VALUE(array_object_alloc(monkey->state, seq));
+}
+
+struct monkey_value *monkey_hash(struct monkey *monkey, int n,
+                                 struct monkey_value *const *keys,
+                                 struct monkey_value *const *values)
+{
+    struct hamt_node *pairs = NULL;
+    bool added;
+    int length = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        if (!is_object_hash_key(OBJECT(keys[i])))
+        {
+            return VALUE(error_object_alloc(monkey->state, "unusable as hash key, got %s",
+                                            object_type_str[OBJECT(keys[i])->type]));
+        }
+    }
+    for (int i = 0; i < n; i++)
+    {
+        pairs = hamt_put(pairs, OBJECT(keys[i]), OBJECT(values[i]), &added);
+        length += added;
+    }
+    return VALUE(hash_object_take(monkey->state, pairs, length));
+}
+
+struct monkey_value *monkey_error(struct monkey *monkey, const char *message)
+{
+    return VALUE(error_object_alloc(monkey->state, "%s", message));
+}
+
+enum monkey_type monkey_type(struct monkey_value *value)
+{
+    switch (OBJECT(value)->type)
+    {
+    case INTEGER_OBJ:
+    {
+        return MONKEY_INTEGER;
+    }
+    case BOOLEAN_OBJ:
+    {
+        return MONKEY_BOOLEAN;
+    }
+    case STRING_OBJ:
+    {
+        return MONKEY_STRING;
+    }
+    case ARRAY_OBJ:
+    {
+        return MONKEY_ARRAY;
+    }
+    case HASH_OBJ:
+    {
+        return MONKEY_HASH;
+    }
+    case FUNC_OBJ:
+    case BUILTIN_OBJ:
+    {
+        return MONKEY_FUNCTION;
+    }
+    case ERROR_OBJ:
+    {
+        return MONKEY_ERROR;
+    }
+    case RANGE_OBJ:
+    {
+        return MONKEY_RANGE;
+    }
+    case BIG_INTEGER_OBJ:
+    {
+        return MONKEY_BIG_INTEGER;
+    }
+    case LINES_OBJ:
+    {
+        return MONKEY_LINES;
+    }
+    default:
+    {
+        return MONKEY_NULL;
+    }
+    }
+}
+
+char *monkey_inspect(struct monkey_value *value)
+{
+    return object_inspect(OBJECT(value));
+}
+
+void monkey_print(struct monkey_value *value, FILE *stream)
+{
+    struct output output;
+
+    output_init(&output, stream);
+    object_write(OBJECT(value), &output);
+    output_free(&output);
+}
+
+long long monkey_integer_value(struct monkey_value *value)
+{
+    assert(OBJECT(value)->type == INTEGER_OBJ);
+    return ((struct integer_object *) value)->value;
+}
+
+bool monkey_boolean_value(struct monkey_value *value)
+{
+    assert(OBJECT(value)->type == BOOLEAN_OBJ);
+    return ((struct boolean_object *) value)->value;
+}
+
+const char *monkey_string_value(struct monkey_value *value, size_t *len)
+{
+    struct string_object *string = (struct string_object *) value;
+
+    assert(string->type == STRING_OBJ);
+    if (len != NULL)
+    {
+        *len = string->length;
+    }
+    return string_object_cstr(string);
+}
+
+int monkey_array_length(struct monkey_value *value)
+{
+    assert(OBJECT(value)->type == ARRAY_OBJ);
+    return ((struct array_object *) value)->length;
+}
+
+struct monkey_value *monkey_array_get(struct monkey *monkey, struct monkey_value *value, int i)
+{
+    assert(OBJECT(value)->type == ARRAY_OBJ);
+    assert(i >= 0 && i < ((struct array_object *) value)->length);
+    return VALUE(sequence_get(monkey->state, OBJECT(value), i));
+}
+
+int monkey_hash_length(struct monkey_value *value)
+{
+    assert(OBJECT(value)->type == HASH_OBJ);
+    return ((struct hash_object *) value)->length;
+}
+
+struct monkey_value *monkey_hash_get(struct monkey_value *value, struct monkey_value *key)
+{
+    assert(OBJECT(value)->type == HASH_OBJ);
+    if (!is_object_hash_key(OBJECT(key)))
+    {
+        return NULL;
+    }
+    return VALUE(hamt_get(((struct hash_object *) value)->pairs, OBJECT(key)));
+}
+
+const char *monkey_error_message(struct monkey_value *value)
+{
+    assert(OBJECT(value)->type == ERROR_OBJ);
+    return ((struct error_object *) value)->value;
+}
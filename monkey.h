@@ -0,0 +1,140 @@
+#ifndef MONKEY_H
+#define MONKEY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* libmonkey.so is built with hidden visibility, so only these are exported. */
+#if defined(__GNUC__)
+#define MONKEY_API __attribute__((visibility("default")))
+#else
+#define MONKEY_API
+#endif
+
+/*
+ * The interface for programs that embed the interpreter; link with
+ * -lmonkey -lcii -lpthread.
+ *
+ * An interpreter may be used by one thread at a time, but any number of
+ * interpreters may run at once.  Running a compiled program writes only
+ * the cache in each of its call sites, which is safe for several threads
+ * to share, so a program may be shared by every interpreter.  Values
+ * belong to the interpreter that made them and stay valid until its next
+ * monkey_run or monkey_destroy; they must not be passed to another
+ * interpreter.  The exception is a builtin, which must not keep the
+ * values it is passed or makes past returning: map, filter, reduce and
+ * each free whatever a call leaves unreachable.
+ */
+struct monkey;
+struct monkey_program;
+struct monkey_value;
+
+enum monkey_type
+{
+    MONKEY_INTEGER,
+    MONKEY_BOOLEAN,
+    MONKEY_STRING,
+    MONKEY_ARRAY,
+    MONKEY_HASH,
+    MONKEY_FUNCTION,
+    MONKEY_NULL,
+    MONKEY_ERROR,
+    /* A lazy sequence of integers, made by range(). */
+    MONKEY_RANGE,
+    /* An integer too large for a long long; monkey_inspect gives its digits. */
+    MONKEY_BIG_INTEGER,
+    /* The lines of a file, made by read_lines(); they can be iterated once. */
+    MONKEY_LINES
+};
+
+/*
+ * A builtin provided by the host.  argv holds the argc arguments; the
+ * result must be made by monkey, and NULL stands for null.  Report a
+ * failure by returning monkey_error.  pmap may call a builtin from
+ * several threads at once, each passing a monkey that can only make
+ * values, so builtins used by pmap callbacks must be thread safe.
+ */
+typedef struct monkey_value *(*monkey_builtin)(struct monkey *monkey, int argc,
+                                               struct monkey_value **argv, void *cl);
+/*
+ * Builtins that take exactly one, two or three arguments.  They are
+ * called without building an argument list, and a call with any other
+ * number of arguments is an error.
+ */
+typedef struct monkey_value *(*monkey_builtin1)(struct monkey *monkey,
+                                                struct monkey_value *arg1, void *cl);
+typedef struct monkey_value *(*monkey_builtin2)(struct monkey *monkey,
+                                                struct monkey_value *arg1,
+                                                struct monkey_value *arg2, void *cl);
+typedef struct monkey_value *(*monkey_builtin3)(struct monkey *monkey,
+                                                struct monkey_value *arg1,
+                                                struct monkey_value *arg2,
+                                                struct monkey_value *arg3, void *cl);
+
+MONKEY_API struct monkey *monkey_alloc(void);
+MONKEY_API void monkey_destroy(struct monkey *monkey);
+/* Makes fn visible to every program this interpreter runs as name. */
+MONKEY_API void monkey_register(struct monkey *monkey, const char *name, monkey_builtin fn,
+                                void *cl);
+MONKEY_API void monkey_register1(struct monkey *monkey, const char *name, monkey_builtin1 fn,
+                                 void *cl);
+MONKEY_API void monkey_register2(struct monkey *monkey, const char *name, monkey_builtin2 fn,
+                                 void *cl);
+MONKEY_API void monkey_register3(struct monkey *monkey, const char *name, monkey_builtin3 fn,
+                                 void *cl);
+
+/* Never NULL; check monkey_program_errors before running. */
+MONKEY_API struct monkey_program *monkey_compile(const char *source);
+MONKEY_API void monkey_program_destroy(struct monkey_program *program);
+MONKEY_API int monkey_program_errors(struct monkey_program *program);
+MONKEY_API const char *monkey_program_error(struct monkey_program *program, int i);
+
+/*
+ * Runs program in a fresh environment in which each string key of
+ * inputs, a hash or NULL, is bound to its value.  Every value made
+ * before the run is freed first, except those bound from inputs.
+ */
+MONKEY_API struct monkey_value *monkey_run(struct monkey *monkey, struct monkey_program *program,
+                                           struct monkey_value *inputs);
+
+MONKEY_API struct monkey_value *monkey_integer(struct monkey *monkey, long long value);
+MONKEY_API struct monkey_value *monkey_boolean(struct monkey *monkey, bool value);
+MONKEY_API struct monkey_value *monkey_null(struct monkey *monkey);
+MONKEY_API struct monkey_value *monkey_string(struct monkey *monkey, const char *value, size_t len);
+MONKEY_API struct monkey_value *monkey_array(struct monkey *monkey, int n,
+                                             struct monkey_value *const *elements);
+/* An error value if any key is not an integer, boolean or string. */
+MONKEY_API struct monkey_value *monkey_hash(struct monkey *monkey, int n,
+                                            struct monkey_value *const *keys,
+                                            struct monkey_value *const *values);
+MONKEY_API struct monkey_value *monkey_error(struct monkey *monkey, const char *message);
+
+MONKEY_API enum monkey_type monkey_type(struct monkey_value *value);
+/* The value as the REPL would print it, as a new string the caller must free. */
+MONKEY_API char *monkey_inspect(struct monkey_value *value);
+/* Writes the same to stream as it goes, never holding it whole. */
+MONKEY_API void monkey_print(struct monkey_value *value, FILE *stream);
+MONKEY_API long long monkey_integer_value(struct monkey_value *value);
+MONKEY_API bool monkey_boolean_value(struct monkey_value *value);
+/* NUL terminated; len, if not NULL, is set to its length. */
+MONKEY_API const char *monkey_string_value(struct monkey_value *value, size_t *len);
+MONKEY_API int monkey_array_length(struct monkey_value *value);
+/* Arrays of integers are stored unboxed, so this may make a value. */
+MONKEY_API struct monkey_value *monkey_array_get(struct monkey *monkey,
+                                                 struct monkey_value *value, int i);
+MONKEY_API int monkey_hash_length(struct monkey_value *value);
+/* NULL if key is missing. */
+MONKEY_API struct monkey_value *monkey_hash_get(struct monkey_value *value,
+                                                struct monkey_value *key);
+MONKEY_API const char *monkey_error_message(struct monkey_value *value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,359 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "monkey.h"
+
+static struct monkey_value *scale(struct monkey *monkey, int argc,
+                                  struct monkey_value **argv, void *cl)
+{
+    long long *factor = cl;
+
+    if (argc != 1 || monkey_type(argv[0]) != MONKEY_INTEGER)
+    {
+        return monkey_error(monkey, "scale wants one integer");
+    }
+    return monkey_integer(monkey, monkey_integer_value(argv[0]) * *factor);
+}
+
+static struct monkey_value *nothing(struct monkey *monkey, int argc,
+                                    struct monkey_value **argv, void *cl)
+{
+    return NULL;
+}
+
+static struct monkey_value *rate(struct monkey *monkey, struct monkey_value *region,
+                                 struct monkey_value *amount, void *cl)
+{
+    const char *name = monkey_string_value(region, NULL);
+
+    return monkey_integer(monkey, monkey_integer_value(amount) * (strcmp(name, "EU") == 0 ? 2 : 1));
+}
+
+static struct monkey_value *clamp(struct monkey *monkey, struct monkey_value *value,
+                                  struct monkey_value *low, struct monkey_value *high,
+                                  void *cl)
+{
+    long long v = monkey_integer_value(value);
+
+    if (v < monkey_integer_value(low))
+    {
+        return low;
+    }
+    return v > monkey_integer_value(high) ? high : value;
+}
+
+static struct monkey_value *negate(struct monkey *monkey, struct monkey_value *value,
+                                   void *cl)
+{
+    return monkey_integer(monkey, -monkey_integer_value(value));
+}
+
+static struct monkey_value *string(struct monkey *monkey, const char *s)
+{
+    return monkey_string(monkey, s, strlen(s));
+}
+
+static int test_compile_errors(void)
+{
+    struct monkey_program *program;
+    int success = -1;
+
+    program = monkey_compile("let = 5;");
+    if (monkey_program_errors(program) == 0)
+    {
+        printf("compile reported no errors\n");
+        goto cleanup;
+    }
+    if (strstr(monkey_program_error(program, 0), "IDENT") == NULL)
+    {
+        printf("wrong error: %s\n", monkey_program_error(program, 0));
+        goto cleanup;
+    }
+    success = 0;
+
+cleanup:
+    monkey_program_destroy(program);
+    return success;
+}
+
+static int test_run(void)
+{
+    struct monkey *monkey;
+    struct monkey_program *program;
+    struct monkey_value *keys[2];
+    struct monkey_value *values[2];
+    struct monkey_value *result;
+    long long factor = 3;
+    int success = -1;
+
+    monkey = monkey_alloc();
+    monkey_register(monkey, "scale", scale, &factor);
+    program = monkey_compile("let total = scale(price) * quantity; "
+                             "if (total > 100) { \"big\" } else { total }");
+    for (int i = 0; i < 100; i++)
+    {
+        keys[0] = string(monkey, "price");
+        values[0] = monkey_integer(monkey, i);
+        keys[1] = string(monkey, "quantity");
+        values[1] = monkey_integer(monkey, 2);
+        result = monkey_run(monkey, program, monkey_hash(monkey, 2, keys, values));
+        if (i * 6 > 100)
+        {
+            if (monkey_type(result) != MONKEY_STRING
+                || strcmp(monkey_string_value(result, NULL), "big") != 0)
+            {
+                printf("run %d got=%s, want=big\n", i, monkey_inspect(result));
+                goto cleanup;
+            }
+        }
+        else if (monkey_type(result) != MONKEY_INTEGER
+                 || monkey_integer_value(result) != i * 6)
+        {
+            printf("run %d got=%s, want=%d\n", i, monkey_inspect(result), i * 6);
+            goto cleanup;
+        }
+    }
+    /* Missing inputs and host errors both come back as errors. */
+    result = monkey_run(monkey, program, NULL);
+    if (monkey_type(result) != MONKEY_ERROR
+        || strcmp(monkey_error_message(result), "identifier not found: price") != 0)
+    {
+        printf("run without inputs got=%s\n", monkey_inspect(result));
+        goto cleanup;
+    }
+    keys[0] = string(monkey, "price");
+    values[0] = string(monkey, "free");
+    result = monkey_run(monkey, program, monkey_hash(monkey, 1, keys, values));
+    if (monkey_type(result) != MONKEY_ERROR
+        || strcmp(monkey_error_message(result), "scale wants one integer") != 0)
+    {
+        printf("host error got=%s\n", monkey_inspect(result));
+        goto cleanup;
+    }
+    result = monkey_run(monkey, program, monkey_integer(monkey, 1));
+    if (monkey_type(result) != MONKEY_ERROR)
+    {
+        printf("non-hash inputs got=%s\n", monkey_inspect(result));
+        goto cleanup;
+    }
+    success = 0;
+
+cleanup:
+    monkey_program_destroy(program);
+    monkey_destroy(monkey);
+    return success;
+}
+
+static int test_values(void)
+{
+    struct monkey *monkey;
+    struct monkey_program *program;
+    struct monkey_value *elements[3];
+    struct monkey_value *keys[1];
+    struct monkey_value *values[1];
+    struct monkey_value *result;
+    struct monkey_value *value;
+    char printed[16];
+    FILE *stream;
+    size_t len;
+    int success = -1;
+
+    monkey = monkey_alloc();
+    /* Host builtins replace the language's own. */
+    monkey_register(monkey, "puts", nothing, NULL);
+    program = monkey_compile("puts(\"hidden\"); "
+                             "{\"first\": first(xs), \"name\": name + \"!\", \"ok\": true, 1: []}");
+    elements[0] = monkey_integer(monkey, 7);
+    elements[1] = monkey_null(monkey);
+    elements[2] = monkey_boolean(monkey, false);
+    keys[0] = string(monkey, "xs");
+    values[0] = monkey_array(monkey, 3, elements);
+    if (monkey_array_length(values[0]) != 3
+        || monkey_type(monkey_array_get(monkey, values[0], 1)) != MONKEY_NULL)
+    {
+        printf("array value wrong: %s\n", monkey_inspect(values[0]));
+        goto cleanup;
+    }
+    result = monkey_run(monkey, program, monkey_hash(monkey, 1, keys, values));
+    if (monkey_type(result) != MONKEY_ERROR)
+    {
+        printf("run with only xs got=%s\n", monkey_inspect(result));
+        goto cleanup;
+    }
+    keys[0] = string(monkey, "name");
+    values[0] = string(monkey, "monkey");
+    result = monkey_run(monkey, program, monkey_hash(monkey, 1, keys, values));
+    if (monkey_type(result) != MONKEY_ERROR)
+    {
+        printf("run with only name got=%s\n", monkey_inspect(result));
+        goto cleanup;
+    }
+    elements[0] = string(monkey, "xs");
+    elements[1] = string(monkey, "name");
+    values[0] = monkey_array(monkey, 1, (struct monkey_value *[]) { monkey_integer(monkey, 42) });
+    result = monkey_run(monkey, program,
+                        monkey_hash(monkey, 2, elements,
+                                    (struct monkey_value *[]) { values[0], string(monkey, "monkey") }));
+    if (monkey_type(result) != MONKEY_HASH || monkey_hash_length(result) != 4)
+    {
+        printf("result is not a hash of 4: %s\n", monkey_inspect(result));
+        goto cleanup;
+    }
+    value = monkey_hash_get(result, string(monkey, "first"));
+    if (value == NULL || monkey_integer_value(value) != 42)
+    {
+        printf("first wrong\n");
+        goto cleanup;
+    }
+    value = monkey_hash_get(result, string(monkey, "name"));
+    if (value == NULL || strcmp(monkey_string_value(value, &len), "monkey!") != 0 || len != 7)
+    {
+        printf("name wrong\n");
+        goto cleanup;
+    }
+    value = monkey_hash_get(result, string(monkey, "ok"));
+    if (value == NULL || !monkey_boolean_value(value))
+    {
+        printf("ok wrong\n");
+        goto cleanup;
+    }
+    value = monkey_hash_get(result, monkey_integer(monkey, 1));
+    if (value == NULL || monkey_type(value) != MONKEY_ARRAY || monkey_array_length(value) != 0)
+    {
+        printf("1 wrong\n");
+        goto cleanup;
+    }
+    if (monkey_hash_get(result, string(monkey, "missing")) != NULL)
+    {
+        printf("missing key found\n");
+        goto cleanup;
+    }
+    if (monkey_type(monkey_hash(monkey, 1, &value, &value)) != MONKEY_ERROR)
+    {
+        printf("array accepted as hash key\n");
+        goto cleanup;
+    }
+    stream = tmpfile();
+    monkey_print(monkey_hash_get(result, string(monkey, "name")), stream);
+    rewind(stream);
+    len = fread(printed, 1, sizeof printed - 1, stream);
+    printed[len] = '\0';
+    fclose(stream);
+    if (strcmp(printed, "monkey!") != 0)
+    {
+        printf("monkey_print wrote %s\n", printed);
+        goto cleanup;
+    }
+    success = 0;
+
+cleanup:
+    monkey_program_destroy(program);
+    monkey_destroy(monkey);
+    return success;
+}
+
+static int test_fixed_arity(void)
+{
+    static const struct
+    {
+        const char *input;
+        const char *expected;
+    } tests[] =
+      {
+          { "clamp(rate(\"EU\", 30), 0, 50)", "50" },
+          { "clamp(rate(\"US\", 30), 0, 50)", "30" },
+          { "clamp(neg(5), 0, 50)", "0" },
+          { "neg(len([1, 2]))", "-2" },
+          { "rate(\"EU\")", "wrong number of arguments. got=1, want=2" },
+          { "clamp(1, 2, 3, 4)", "wrong number of arguments. got=4, want=3" },
+          { "neg(-x)", "identifier not found: x" },
+          { "clamp(len(range(0, 100, 7)), 0, 10)", "10" }
+      };
+    struct monkey *monkey;
+    struct monkey_program *program;
+    struct monkey_value *value;
+    char *inspect;
+    int success = 0;
+
+    monkey = monkey_alloc();
+    monkey_register(monkey, "neg", nothing, NULL);
+    monkey_register1(monkey, "neg", negate, NULL);
+    monkey_register2(monkey, "rate", rate, NULL);
+    monkey_register3(monkey, "clamp", clamp, NULL);
+    for (int i = 0; i < sizeof tests / sizeof tests[0]; i++)
+    {
+        program = monkey_compile(tests[i].input);
+        value = monkey_run(monkey, program, NULL);
+        inspect = monkey_inspect(value);
+        if (strcmp(inspect, tests[i].expected) != 0)
+        {
+            printf("%s got=%s, want=%s\n", tests[i].input, inspect, tests[i].expected);
+            success = -1;
+        }
+        free(inspect);
+        monkey_program_destroy(program);
+    }
+    monkey_destroy(monkey);
+    return success;
+}
+
+/* Calls in a shared program find each interpreter's own builtins, not the last one's. */
+static int test_shared_program(void)
+{
+    static const char *expected[] = { "3", "null", "3", "null" };
+    struct monkey *monkeys[2];
+    struct monkey_program *program;
+    char *inspect;
+    int success = 0;
+
+    monkeys[0] = monkey_alloc();
+    monkeys[1] = monkey_alloc();
+    monkey_register(monkeys[1], "len", nothing, NULL);
+    program = monkey_compile("let f = fn(s) { len(s) }; f(\"abc\")");
+    for (int i = 0; i < 4; i++)
+    {
+        inspect = monkey_inspect(monkey_run(monkeys[i % 2], program, NULL));
+        if (strcmp(inspect, expected[i]) != 0)
+        {
+            printf("run %d got=%s, want=%s\n", i, inspect, expected[i]);
+            success = -1;
+        }
+        free(inspect);
+    }
+    monkey_program_destroy(program);
+    monkey_destroy(monkeys[0]);
+    monkey_destroy(monkeys[1]);
+    return success;
+}
+
+int main(void)
+{
+    if (test_compile_errors() != 0)
+    {
+        printf("test_compile_errors failed\n");
+        return EXIT_FAILURE;
+    }
+    if (test_run() != 0)
+    {
+        printf("test_run failed\n");
+        return EXIT_FAILURE;
+    }
+    if (test_values() != 0)
+    {
+        printf("test_values failed\n");
+        return EXIT_FAILURE;
+    }
+    if (test_fixed_arity() != 0)
+    {
+        printf("test_fixed_arity failed\n");
+        return EXIT_FAILURE;
+    }
+    if (test_shared_program() != 0)
+    {
+        printf("test_shared_program failed\n");
+        return EXIT_FAILURE;
+    }
+    printf("Tests successful\n");
+    return EXIT_SUCCESS;
+}
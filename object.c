@@ -1,6 +1,13 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdbool.h>
 #include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
 #include <stdarg.h>
+#include <string.h>
+#include <limits.h>
+#include <stdint.h>
 #include <mem.h>
 #include <str.h>
 #include <seq.h>
@@ -21,15 +28,24 @@ const char *object_type_str [] =
     [RETURN_VALUE_OBJ] = "RETURN VALUE",
     [ENV_OBJ] = "ENV",
     [NULL_OBJ] = "NULL",
-    [ERROR_OBJ] = "ERROR"
+    [ERROR_OBJ] = "ERROR",
+    [RANGE_OBJ] = "RANGE",
+    [BIG_INTEGER_OBJ] = "BIG INTEGER",
+    [LINES_OBJ] = "LINES"
 };
 
-static Seq_T allocated_objects;
-struct boolean_object true_object = { BOOLEAN_OBJ, false, true, "true" };
-struct boolean_object false_object  = { BOOLEAN_OBJ, false, false, "false" };
-struct null_object null_object = { NULL_OBJ, false, "null" };
+struct boolean_object true_object = { BOOLEAN_OBJ, false, true };
+struct boolean_object false_object  = { BOOLEAN_OBJ, false, false };
+struct null_object null_object = { NULL_OBJ, false };
 static void objects_mark(struct object *object);
 
+int string_cmp(struct string_object *s1, struct string_object *s2)
+{
+    int cmp = memcmp(s1->value, s2->value, s1->length < s2->length ? s1->length : s2->length);
+
+    return cmp != 0 ? cmp : (s1->length > s2->length) - (s1->length < s2->length);
+}
+
 int object_cmp(const void *x, const void *y)
 {
     struct object *o1 = (struct object *) x;
@@ -45,8 +61,8 @@ int object_cmp(const void *x, const void *y)
     {
     case INTEGER_OBJ:
     {
-        return ((struct integer_object *) o1)->value -
-            ((struct integer_object *) o2)->value;
+        return (((struct integer_object *) o1)->value > ((struct integer_object *) o2)->value)
+            - (((struct integer_object *) o1)->value < ((struct integer_object *) o2)->value);
     }
     case BOOLEAN_OBJ:
     {
@@ -55,8 +71,13 @@ int object_cmp(const void *x, const void *y)
     }
     case STRING_OBJ:
     {
-        return Str_cmp(((struct string_object *) o1)->value, 1, 0,
-                       ((struct string_object *) o1)->value, 1, 0);
+        return string_cmp((struct string_object *) o1, (struct string_object *) o2);
+    }
+    case BIG_INTEGER_OBJ:
+    {
+        diff = AP_cmp(((struct big_integer_object *) o1)->value,
+                      ((struct big_integer_object *) o2)->value);
+        return (diff > 0) - (diff < 0);
     }
     default:
     {
@@ -69,7 +90,7 @@ int object_cmp(const void *x, const void *y)
 unsigned object_hash(const void *x)
 {
     struct object *o = (struct object *) x;
-    const char *str;
+    struct string_object *string;
     unsigned h = 0;
 
     switch (o->type)
@@ -84,13 +105,17 @@ unsigned object_hash(const void *x)
     }
     case STRING_OBJ:
     {
-        str = ((struct string_object *) o)->value;
-        while (*str)
+        string = (struct string_object *) o;
+        for (int i = 0; i < string->length; i++)
         {
-            h = (h << 1) + *str++;
+            h = (h << 1) + string->value[i];
         }
         return h;       
     }
+    case BIG_INTEGER_OBJ:
+    {
+        return AP_modi(((struct big_integer_object *) o)->value, 2147483647);
+    }
     default:
     {
         break;
@@ -99,25 +124,12 @@ unsigned object_hash(const void *x)
     return 0;      
 }
 
-static Text_T *copy_text(Text_T t)
-{
-    Text_T *p;
-
-    NEW0(p);
-    *p = Text_box(Text_get(NULL, 0, t), t.len);
-    return p;
-}
-
-static void free_text(Text_T *t)
+/* An index's keys are boxes around names the environment frees itself. */
+static void free_key(const void *key, void **value, void *cl)
 {
-    char *c = (char *) t->str;
-    FREE(c);
-    FREE(t);
-}
+    Text_T *box = (Text_T *) key;
 
-static void free_store(const void *key, void **value, void *cl)
-{
-    free_text((Text_T *) key);
+    FREE(box);
 }
 
 static void integer_object_destroy(struct integer_object *integer)
@@ -125,97 +137,122 @@ static void integer_object_destroy(struct integer_object *integer)
     FREE(integer);
 }
 
-static char *integer_object_inspect(struct integer_object *integer)
+static void string_object_destroy(struct string_object *string)
 {
-    return integer->inspect;
+    if (string->parent == NULL)
+    {
+        FREE(string->value);
+    }
+    FREE(string->terminated);
+    FREE(string);
 }
 
-static char *boolean_object_inspect(struct boolean_object *boolean)
+static void array_object_destroy(struct array_object *array)
 {
-    return boolean->inspect;
+    if (array->elements != NULL)
+    {
+        Seq_free(&array->elements);
+    }
+    FREE(array->ints);
+    FREE(array);
 }
 
-static void string_object_destroy(struct string_object *string)
+/*
+ * A slice is terminated when first asked.  Forks evaluating for pmap
+ * may ask for the same slice at once; the first copy stored wins.
+ */
+static char *publish(char **terminated, char *str)
 {
-    FREE(string->value);
-    FREE(string);
-}
+    char *stored = NULL;
 
-static char *string_object_inspect(struct string_object *string)
-{
-    return string->value;
+    if (!__atomic_compare_exchange_n(terminated, &stored, str, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+        FREE(str);
+        return stored;
+    }
+    return str;
 }
 
-static void array_object_destroy(struct array_object *array)
+const char *string_object_cstr(struct string_object *string)
 {
-    Seq_free(&array->elements);
-    FREE(array->inspect);
-    FREE(array);
+    char *terminated;
+
+    if (string->parent == NULL)
+    {
+        return string->value;
+    }
+    terminated = __atomic_load_n(&string->terminated, __ATOMIC_ACQUIRE);
+    if (terminated == NULL)
+    {
+        terminated = ALLOC(string->length + 1);
+        memcpy(terminated, string->value, string->length);
+        terminated[string->length] = '\0';
+        terminated = publish(&string->terminated, terminated);
+    }
+    return terminated;
 }
 
-static char *array_object_inspect(struct array_object *array)
+static void big_integer_object_destroy(struct big_integer_object *integer)
 {
-    return array->inspect;
+    AP_free(&integer->value);
+    FREE(integer);
 }
 
 static void hash_object_destroy(struct hash_object *hash)
 {
-    Table_free(&hash->pairs);
-    FREE(hash->inspect);
+    hamt_free(hash->pairs);
     FREE(hash);
 }
 
-static char *hash_object_inspect(struct hash_object *hash)
-{
-    return hash->inspect;
-}
-
 static void function_object_destroy(struct function_object *function)
 {
     function_literal_destroy(function->value);
-    FREE(function->inspect);
     FREE(function);
 }
 
-static char *function_object_inspect(struct function_object *function)
-{
-    return function->inspect;
-}
-
-static char *builtin_object_inspect(struct builtin_object *builtin)
-{
-    return "builtin function";
-}
-
 static void return_value_destroy(struct return_value *return_value)
 {
     FREE(return_value);
 }
 
-static char *return_value_inspect(struct return_value *return_value)
-{
-    return object_inspect(return_value->value);
-}
-
-static char *null_object_inspect(struct null_object *null)
+static void error_object_destroy(struct error_object *error_object)
 {
-    return null->inspect;
+    FREE(error_object);
 }
 
-static void error_object_destroy(struct error_object *error_object)
+static void range_object_destroy(struct range_object *range)
 {
-    FREE(error_object);
+    FREE(range);
 }
 
-static char *error_object_inspect(struct error_object *error)
+static void lines_object_destroy(struct lines_object *lines)
 {
-    return error->value;
+    if (lines->fd >= 0)
+    {
+        close(lines->fd);
+    }
+    FREE(lines->buf);
+    FREE(lines->path);
+    FREE(lines);
 }
 
 static void env_object_destroy(struct env_object *env)
 {
-    Table_map(env->store, free_store, NULL);
-    Table_free(&env->store);
+    char *c;
+
+    for (int i = 0; i < env->count; i++)
+    {
+        c = (char *) env->names[i].str;
+        FREE(c);
+    }
+    if (env->index != NULL)
+    {
+        Table_map(env->index, free_key, NULL);
+        Table_free(&env->index);
+        FREE(env->names);
+        FREE(env->values);
+    }
     FREE(env);
 }
 
@@ -268,224 +305,537 @@ void object_destroy(struct object *object)
         error_object_destroy((struct error_object *) object);
         break;
     }
+    case RANGE_OBJ:
+    {
+        range_object_destroy((struct range_object *) object);
+        break;
+    }
+    case BIG_INTEGER_OBJ:
+    {
+        big_integer_object_destroy((struct big_integer_object *) object);
+        break;
+    }
+    case LINES_OBJ:
+    {
+        lines_object_destroy((struct lines_object *) object);
+        break;
+    }
     default:
     {
     }
     }
 }
 
-char *object_inspect(struct object *object)
+static void write_str(struct output *output, const char *s)
+{
+    output_write(output, s, strlen(s));
+}
+
+static void write_integer(struct output *output, long long value)
+{
+    /* "-9223372036854775808" and sprintf's NUL. */
+    output_reserve(output, 21);
+    output->length += sprintf(output->data + output->length, "%lld", value);
+}
+
+static void write_big_integer(struct big_integer_object *integer, struct output *output)
+{
+    char *digits;
+
+    digits = AP_tostr(NULL, 0, 10, integer->value);
+    write_str(output, digits);
+    FREE(digits);
+}
+
+static void write_array(struct array_object *array, struct output *output)
+{
+    output_write(output, "[", 1);
+    for (int i = 0; i < array->length; i++)
+    {
+        if (i > 0)
+        {
+            output_write(output, ", ", 2);
+        }
+        if (array->ints != NULL)
+        {
+            write_integer(output, array->ints[i]);
+        }
+        else
+        {
+            object_write((struct object *) Seq_get(array->elements, i), output);
+        }
+    }
+    output_write(output, "]", 1);
+}
+
+struct pair_writer
+{
+    struct output *output;
+    bool first;
+};
+
+static void write_pair(struct object *key, struct object *value, void *cl)
+{
+    struct pair_writer *pairs = cl;
+
+    if (!pairs->first)
+    {
+        output_write(pairs->output, ", ", 2);
+    }
+    pairs->first = false;
+    object_write(key, pairs->output);
+    output_write(pairs->output, ":", 1);
+    object_write(value, pairs->output);
+}
+
+static void write_hash(struct hash_object *hash, struct output *output)
+{
+    struct pair_writer pairs = { output, true };
+
+    output_write(output, "{", 1);
+    hamt_map(hash->pairs, write_pair, &pairs);
+    output_write(output, "}", 1);
+}
+
+static void write_function(struct function_object *function, struct output *output)
+{
+    Seq_T parameters = function->value->parameters;
+    char *str;
+
+    output_write(output, "fn(", 3);
+    for (int i = 0; i < Seq_length(parameters); i++)
+    {
+        if (i > 0)
+        {
+            output_write(output, ", ", 2);
+        }
+        str = identifier_to_string((struct identifier *) Seq_get(parameters, i));
+        write_str(output, str);
+        FREE(str);
+    }
+    output_write(output, ") {\n", 4);
+    str = block_statement_to_string(function->value->body);
+    if (str != NULL)
+    {
+        write_str(output, str);
+        FREE(str);
+    }
+    output_write(output, "\n", 1);
+}
+
+static void write_range(struct range_object *range, struct output *output)
+{
+    /* Three integers, their separators and sprintf's NUL. */
+    output_reserve(output, 80);
+    output->length += sprintf(output->data + output->length, "range(%lld, %lld, %lld)",
+                              range->start, range->end, range->step);
+}
+
+void object_write(struct object *object, struct output *output)
 {
     switch (object->type)
     {
     case INTEGER_OBJ:
     {
-        return integer_object_inspect((struct integer_object *) object);
+        write_integer(output, ((struct integer_object *) object)->value);
+        break;
     }
     case BOOLEAN_OBJ:
     {
-        return boolean_object_inspect((struct boolean_object *) object);
+        write_str(output, ((struct boolean_object *) object)->value ? "true" : "false");
+        break;
     }
     case STRING_OBJ:
     {
-        return string_object_inspect((struct string_object *) object);
+        output_write(output, ((struct string_object *) object)->value,
+                     ((struct string_object *) object)->length);
+        break;
     }
     case ARRAY_OBJ:
     {
-        return array_object_inspect((struct array_object *) object);
+        write_array((struct array_object *) object, output);
+        break;
     }
     case HASH_OBJ:
     {
-        return hash_object_inspect((struct hash_object *) object);
+        write_hash((struct hash_object *) object, output);
+        break;
     }
     case FUNC_OBJ:
     {
-        return function_object_inspect((struct function_object *) object);
+        write_function((struct function_object *) object, output);
+        break;
     }
     case BUILTIN_OBJ:
     {
-        return builtin_object_inspect((struct builtin_object *) object);
+        write_str(output, "builtin function");
+        break;
     }
     case RETURN_VALUE_OBJ:
     {
-        return return_value_inspect((struct return_value *) object);
+        object_write(((struct return_value *) object)->value, output);
+        break;
     }
     case NULL_OBJ:
     {
-        return null_object_inspect((struct null_object *) object);
+        write_str(output, "null");
+        break;
     }
     case ERROR_OBJ:
     {
-        return error_object_inspect((struct error_object *) object);
+        write_str(output, ((struct error_object *) object)->value);
+        break;
+    }
+    case RANGE_OBJ:
+    {
+        write_range((struct range_object *) object, output);
+        break;
+    }
+    case BIG_INTEGER_OBJ:
+    {
+        write_big_integer((struct big_integer_object *) object, output);
+        break;
+    }
+    case LINES_OBJ:
+    {
+        write_str(output, "read_lines(");
+        write_str(output, ((struct lines_object *) object)->path);
+        write_str(output, ")");
+        break;
     }
     default:
     {
-        return NULL;
+        break;
     }
     }
-    return NULL;
 }
 
-struct integer_object *integer_object_alloc(long long value)
+char *object_inspect(struct object *object)
+{
+    struct output output;
+
+    output_init(&output, NULL);
+    object_write(object, &output);
+    return output_take(&output);
+}
+
+struct integer_object *integer_object_alloc(struct interpreter_state *state, long long value)
 {
     struct integer_object *integer;
     
     NEW0(integer);
     integer->type = INTEGER_OBJ;
     integer->value = value;
-    snprintf(integer->inspect, sizeof integer->inspect, "%lld", integer->value);
-    Seq_addhi(allocated_objects, integer);
+    Seq_addhi(state->allocated_objects, integer);
     return integer;
 }
 
-struct string_object *string_object_alloc(Text_T value)
+struct object *integer_object_from_ap(struct interpreter_state *state, AP_T value)
+{
+    struct big_integer_object *integer;
+    long long n;
+
+    if (AP_cmpi(value, LLONG_MAX) <= 0 && AP_cmpi(value, LLONG_MIN) >= 0)
+    {
+        /* AP_toint reduces modulo LONG_MAX + 1, so it makes LLONG_MIN 0. */
+        n = AP_cmpi(value, LLONG_MIN) == 0 ? LLONG_MIN : AP_toint(value);
+        AP_free(&value);
+        return (struct object *) integer_object_alloc(state, n);
+    }
+    NEW0(integer);
+    integer->type = BIG_INTEGER_OBJ;
+    integer->value = value;
+    Seq_addhi(state->allocated_objects, integer);
+    return (struct object *) integer;
+}
+
+AP_T integer_to_ap(struct object *integer)
+{
+    if (integer->type == BIG_INTEGER_OBJ)
+    {
+        return AP_addi(((struct big_integer_object *) integer)->value, 0);
+    }
+    return AP_new(((struct integer_object *) integer)->value);
+}
+
+struct range_object *range_object_alloc(struct interpreter_state *state, long long start,
+                                        long long end, long long step)
+{
+    struct range_object *range;
+    unsigned long long span;
+    unsigned long long length = 0;
+
+    NEW0(range);
+    range->type = RANGE_OBJ;
+    range->start = start;
+    range->end = end;
+    range->step = step;
+    /* Unsigned, so spans wider than LLONG_MAX still divide correctly. */
+    if (step > 0 && start < end)
+    {
+        span = (unsigned long long) end - (unsigned long long) start;
+        length = (span - 1) / (unsigned long long) step + 1;
+    }
+    else if (step < 0 && start > end)
+    {
+        span = (unsigned long long) start - (unsigned long long) end;
+        length = (span - 1) / (0 - (unsigned long long) step) + 1;
+    }
+    range->length = length > LLONG_MAX ? LLONG_MAX : (long long) length;
+    Seq_addhi(state->allocated_objects, range);
+    return range;
+}
+
+/* Large enough that reading costs about one system call per 64 KiB. */
+#define LINES_BUFFER (1 << 16)
+
+struct lines_object *lines_object_alloc(struct interpreter_state *state, int fd,
+                                        const char *path)
+{
+    struct lines_object *lines;
+
+    NEW0(lines);
+    lines->type = LINES_OBJ;
+    lines->fd = fd;
+    lines->size = LINES_BUFFER;
+    lines->buf = ALLOC(lines->size);
+    lines->path = Str_dup(path, 1, 0, 1);
+    Seq_addhi(state->allocated_objects, lines);
+    return lines;
+}
+
+long long sequence_length(struct object *object)
+{
+    if (object->type == RANGE_OBJ)
+    {
+        return ((struct range_object *) object)->length;
+    }
+    return ((struct array_object *) object)->length;
+}
+
+struct object *sequence_get(struct interpreter_state *state, struct object *object,
+                            long long i)
+{
+    struct array_object *array;
+
+    if (object->type == RANGE_OBJ)
+    {
+        return (struct object *) integer_object_alloc(state,
+                                                      range_get((struct range_object *) object, i));
+    }
+    array = (struct array_object *) object;
+    if (array->ints != NULL)
+    {
+        return (struct object *) integer_object_alloc(state, array->ints[i]);
+    }
+    return (struct object *) Seq_get(array->elements, i);
+}
+
+void iterator_init(struct iterator *iterator, struct object *object)
+{
+    iterator->object = object;
+    iterator->next = 0;
+}
+
+/* The next line, read on when buf holds no whole one. */
+static struct object *lines_next(struct interpreter_state *state, struct lines_object *lines)
+{
+    struct string_object *line;
+    char *newline;
+    int length;
+    ssize_t n;
+
+    for (;;)
+    {
+        newline = memchr(lines->buf + lines->start, '\n', lines->end - lines->start);
+        /* A line longer than a buffer can grow to is returned in pieces. */
+        if (newline != NULL || lines->fd < 0
+            || (lines->start == 0 && lines->end == lines->size && lines->size > INT_MAX / 2))
+        {
+            break;
+        }
+        memmove(lines->buf, lines->buf + lines->start, lines->end - lines->start);
+        lines->end -= lines->start;
+        lines->start = 0;
+        if (lines->end == lines->size)
+        {
+            lines->size *= 2;
+            RESIZE(lines->buf, lines->size);
+        }
+        n = read(lines->fd, lines->buf + lines->end, lines->size - lines->end);
+        if (n > 0)
+        {
+            lines->end += n;
+        }
+        else if (n == 0 || errno != EINTR)
+        {
+            close(lines->fd);
+            lines->fd = -1;
+        }
+    }
+    if (newline == NULL && lines->start == lines->end)
+    {
+        return NULL;
+    }
+    length = (newline != NULL ? newline : lines->buf + lines->end) - (lines->buf + lines->start);
+    line = string_object_alloc(state, (Text_T) {
+            length > 0 && lines->buf[lines->start + length - 1] == '\r' ? length - 1 : length,
+            lines->buf + lines->start });
+    lines->start += newline != NULL ? length + 1 : length;
+    return (struct object *) line;
+}
+
+struct object *iterator_next(struct interpreter_state *state, struct iterator *iterator)
+{
+    if (iterator->object->type == LINES_OBJ)
+    {
+        return lines_next(state, (struct lines_object *) iterator->object);
+    }
+    if (iterator->next >= sequence_length(iterator->object))
+    {
+        return NULL;
+    }
+    return sequence_get(state, iterator->object, iterator->next++);
+}
+
+struct string_object *string_object_alloc(struct interpreter_state *state, Text_T value)
+{
+    return string_object_take(state, Text_get(NULL, 0, value), value.len);
+}
+
+struct string_object *string_object_take(struct interpreter_state *state, char *value,
+                                         int length)
 {
     struct string_object *string;
     
     NEW0(string);
     string->type = STRING_OBJ;
-    string->value = Text_get(NULL, 0, value);
-    Seq_addhi(allocated_objects, string);
+    string->value = value;
+    string->length = length;
+    Seq_addhi(state->allocated_objects, string);
     return string;
 }
 
-struct array_object *array_object_alloc(Seq_T elements)
+/* Slices of slices share the root's buffer, so no chain is kept alive. */
+struct string_object *string_slice_alloc(struct interpreter_state *state,
+                                         struct string_object *string, int start, int length)
+{
+    struct string_object *slice;
+
+    if (start == 0 && length == string->length)
+    {
+        return string;
+    }
+    NEW0(slice);
+    slice->type = STRING_OBJ;
+    slice->value = string->value + start;
+    slice->length = length;
+    slice->parent = string->parent != NULL ? string->parent : string;
+    Seq_addhi(state->allocated_objects, slice);
+    return slice;
+}
+
+static struct array_object *array_alloc(struct interpreter_state *state, Seq_T elements,
+                                        long long *ints, int length)
 {
     struct array_object *array;
-    struct object *object;
-    char *str;
-    char *str1;
-    char *str2;
-    
+
     NEW0(array);
     array->type = ARRAY_OBJ;
     array->elements = elements;
-    str1 = Str_dup("[", 1, 0, 1);
-    if (Seq_length(array->elements) > 0)
-    {
-        object = (struct object *) Seq_get(array->elements, 0);
-        str2 = object_inspect(object);
-        str = Str_cat(str1, 1, 0, str2, 1, 0);
-        FREE(str1);
-        str1 = str;
-        for (int i = 1; i < Seq_length(array->elements); i++)
+    array->ints = ints;
+    array->length = length;
+    Seq_addhi(state->allocated_objects, array);
+    return array;
+}
+
+struct array_object *array_object_alloc(struct interpreter_state *state, Seq_T elements)
+{
+    struct object *object;
+    long long *ints;
+    int n = Seq_length(elements);
+    
+    for (int i = 0; i < n; i++)
+    {
+        object = (struct object *) Seq_get(elements, i);
+        if (object->type != INTEGER_OBJ)
         {
-            object = (struct object *) Seq_get(array->elements, i);
-            str2 = object_inspect(object);
-            str = Str_catv(str1, 1, 0, ", ", 1, 0, str2, 1, 0, NULL);
-            FREE(str1);
-            str1 = str;
+            return array_alloc(state, elements, NULL, n);
         }
     }
-    str = Str_cat(str1, 1, 0, "]", 1, 0);
-    FREE(str1);
-    array->inspect = str;
-    Seq_addhi(allocated_objects, array);
-    return array;
+    if (n == 0)
+    {
+        return array_alloc(state, elements, NULL, 0);
+    }
+    ints = ALLOC(n * sizeof *ints);
+    for (int i = 0; i < n; i++)
+    {
+        ints[i] = ((struct integer_object *) Seq_get(elements, i))->value;
+    }
+    Seq_free(&elements);
+    return array_alloc(state, NULL, ints, n);
 }
 
-struct hash_object *hash_object_alloc(Table_T pairs)
+struct array_object *int_array_object_alloc(struct interpreter_state *state, long long *ints,
+                                            int length)
 {
-    struct hash_object *hash;
-    struct object *object;
-    int i = 0;
+    return array_alloc(state, NULL, ints, length);
+}
+
+struct hash_object *hash_object_alloc(struct interpreter_state *state, Table_T pairs)
+{
+    struct hamt_node *trie = NULL;
     void **array;
-    char *str;
-    char *str1;
-    char *str2;
-    char *str3;
+    bool added;
+    int n;
+
+    n = Table_length(pairs);
+    array = Table_toArray(pairs, NULL);
+    for (int i = 0; i < n; i++)
+    {
+        trie = hamt_put(trie, array[2 * i], array[2 * i + 1], &added);
+    }
+    FREE(array);
+    Table_free(&pairs);
+    return hash_object_take(state, trie, n);
+}
+
+struct hash_object *hash_object_take(struct interpreter_state *state, struct hamt_node *pairs,
+                                     int length)
+{
+    struct hash_object *hash;
 
     NEW0(hash);
     hash->type = HASH_OBJ;
     hash->pairs = pairs;
-    array = Table_toArray(hash->pairs, NULL);
-    str1 = Str_dup("{", 1, 0, 1);
-    if (array[i] != NULL)
-    {
-        object = (struct object *) array[i++];
-        str2 = object_inspect(object);
-        object = (struct object *) array[i++];
-        str3 = object_inspect(object);
-        str = Str_catv(str1, 1, 0, str2, 1, 0, ":", 1, 0, str3, 1, 0, NULL);
-        FREE(str1);
-        str1 = str;
-        while (array[i] != NULL)
-        {
-            object = (struct object *) array[i++];
-            str2 = object_inspect(object);
-            object = (struct object *) array[i++];
-            str3 = object_inspect(object);
-            str = Str_catv(str1, 1, 0, ", ", 1, 0, str2, 1, 0, ":", 1, 0, str3, 1, 0, NULL);
-            FREE(str1);
-            str1 = str;
-        }
-    }
-    FREE(array);
-    str = Str_cat(str1, 1, 0, "}", 1, 0);
-    FREE(str1);
-    hash->inspect = str;
-    Seq_addhi(allocated_objects, hash);
+    hash->length = length;
+    Seq_addhi(state->allocated_objects, hash);
     return hash;
 }
 
-struct function_object *function_object_alloc(struct function_literal *value,
+struct function_object *function_object_alloc(struct interpreter_state *state,
+                                              struct function_literal *value,
                                               struct env_object *env)
 {
     struct function_object *function;
-    struct identifier *identifier;
-    char *str;
-    char *str1;
-    char *str2;
 
     NEW0(function);
     function->type = FUNC_OBJ;
     function_literal_addref(value);
     function->value = value;
     function->env = env;
-    str = ALLOC(sizeof "fn(");
-    Fmt_sfmt(str, sizeof "fn(", "fn(");
-    str1 = str;
-    if (Seq_length(function->value->parameters) > 0)
-    {
-        identifier = (struct identifier *) Seq_get(function->value->parameters, 0);
-        str2 = identifier_to_string(identifier);
-        str = Str_cat(str, 1, 0, str2, 1, 0);
-        FREE(str2);
-        FREE(str1);
-        str1 = str;
-        for (int i = 1; i < Seq_length(function->value->parameters); i++)
-        {
-            identifier = (struct identifier *) Seq_get(function->value->parameters, i);
-            str2 = identifier_to_string(identifier);
-            str = Str_catv(str, 1, 0, ", ", 1, 0, str2, 1, 0, NULL);
-            FREE(str2);
-            FREE(str1);
-            str1 = str;
-        }
-    }
-    str = Str_cat(str1, 1, 0, ") {\n", 1, 0);
-    FREE(str1);
-    str1 = str;
-    str2 = block_statement_to_string(function->value->body);
-    str = Str_cat(str1, 1, 0, str2, 1, 0);
-    FREE(str2);
-    FREE(str1);
-    str1 = str;
-    str = Str_cat(str1, 1, 0, "\n", 1, 0);
-    FREE(str1);
-    function->inspect = str;
-    Seq_addhi(allocated_objects, function);
+    Seq_addhi(state->allocated_objects, function);
     return function;
 }
 
-struct return_value *return_value_alloc(struct object *value)
+struct return_value *return_value_alloc(struct interpreter_state *state, struct object *value)
 {
     struct return_value *return_value;
     
     NEW0(return_value);
     return_value->type = RETURN_VALUE_OBJ;
     return_value->value = value;
-    Seq_addhi(allocated_objects, return_value);
+    Seq_addhi(state->allocated_objects, return_value);
     return return_value;
 }
 
@@ -494,7 +844,7 @@ struct boolean_object *boolean_object_alloc(bool value)
     return value ? &true_object : &false_object;
 }
 
-struct error_object *error_object_alloc(const char *value, ...)
+struct error_object *error_object_alloc(struct interpreter_state *state, const char *value, ...)
 {
     struct error_object *error;
     va_list_box box;
@@ -504,53 +854,128 @@ struct error_object *error_object_alloc(const char *value, ...)
     va_start(box.ap, value);
     Fmt_vsfmt(error->value, sizeof error->value, value, &box);
     va_end(box.ap);
-    Seq_addhi(allocated_objects, error);
+    Seq_addhi(state->allocated_objects, error);
     return error;
 }
 
-struct env_object *env_object_alloc(struct env_object *outer)
+struct env_object *env_object_alloc(struct interpreter_state *state, struct env_object *outer)
 {
     struct env_object *env;
 
     NEW0(env);
     env->type = ENV_OBJ;
-    env->store = Table_new(0, text_cmp, text_hash);
+    env->size = ENV_SLOTS;
+    env->names = env->inline_names;
+    env->values = env->inline_values;
     env->outer = outer;
-    Seq_addhi(allocated_objects, env);
+    Seq_addhi(state->allocated_objects, env);
     return env;
 }
 
+/* Which bit of an index's filter a name sets; names are short, so two of their bytes will do. */
+static unsigned long long name_bit(Text_T name)
+{
+    if (name.len == 0)
+    {
+        return 1;
+    }
+    return 1ULL << ((name.len * 7 + name.str[0] + name.str[name.len - 1]) & 63);
+}
+
+static void index_add(struct env_object *env, int slot)
+{
+    Text_T *key;
+
+    NEW(key);
+    *key = env->names[slot];
+    Table_put(env->index, key, (void *) (intptr_t) (slot + 1));
+    env->filter |= name_bit(*key);
+}
+
+int env_slot(struct env_object *env, Text_T name)
+{
+    if (env->index != NULL)
+    {
+        if ((env->filter & name_bit(name)) == 0)
+        {
+            return -1;
+        }
+        return (int) (intptr_t) Table_get(env->index, &name) - 1;
+    }
+    for (int i = 0; i < env->count; i++)
+    {
+        if (env->names[i].len == name.len
+            && memcmp(env->names[i].str, name.str, name.len) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
 struct object *env_get(struct env_object *env, Text_T name)
 {
-    struct object *value;
-    
-    value = (struct object *) Table_get(env->store, &name);
-    if (value == NULL && env->outer != NULL)
+    int slot;
+
+    for (; env != NULL; env = env->outer)
     {
-        value = env_get(env->outer, name);
+        if ((slot = env_slot(env, name)) >= 0)
+        {
+            return env->values[slot];
+        }
     }
-    return value;
+    return NULL;
+}
+
+/* Moves the bindings out of line once they fill the inline slots, and indexes them. */
+static void env_grow(struct env_object *env)
+{
+    env->size *= 2;
+    if (env->index == NULL)
+    {
+        env->names = ALLOC(env->size * sizeof *env->names);
+        env->values = ALLOC(env->size * sizeof *env->values);
+        memcpy(env->names, env->inline_names, sizeof env->inline_names);
+        memcpy(env->values, env->inline_values, sizeof env->inline_values);
+        env->index = Table_new(0, text_cmp, text_hash);
+        for (int i = 0; i < env->count; i++)
+        {
+            index_add(env, i);
+        }
+        return;
+    }
+    RESIZE(env->names, env->size * sizeof *env->names);
+    RESIZE(env->values, env->size * sizeof *env->values);
 }
 
 struct object *env_set(struct env_object *env, Text_T name, struct object *value)
 {
-    struct object *prev = NULL;
+    struct object *prev;
+    int slot;
 
-    if (Table_get(env->store, &name) != NULL)
+    if ((slot = env_slot(env, name)) >= 0)
     {
-        prev = (struct object *) Table_put(env->store, &name, value);
+        prev = env->values[slot];
+        env->values[slot] = value;
+        return prev;
     }
-    else
+    if (env->count == env->size)
     {
-        Table_put(env->store, copy_text(name), value);
-        
+        env_grow(env);
     }
-    return prev;
+    env->names[env->count] = Text_box(Text_get(NULL, 0, name), name.len);
+    env->values[env->count] = value;
+    if (env->index != NULL)
+    {
+        index_add(env, env->count);
+    }
+    env->count++;
+    return NULL;
 }
 
-void objects_init(void)
+void objects_init(struct interpreter_state *state)
 {
-    allocated_objects = Seq_new(100);
+    state->allocated_objects = Seq_new(100);
 }
 
 static void array_object_mark(struct array_object *array)
@@ -558,23 +983,36 @@ static void array_object_mark(struct array_object *array)
     struct object *object;
     
     array->marked = true;
-    for (int i = 1; i < Seq_length(array->elements); i++)
+    if (array->elements == NULL)
+    {
+        return;
+    }
+    for (int i = 0; i < Seq_length(array->elements); i++)
     {
         object = (struct object *) Seq_get(array->elements, i);
         objects_mark(object);
     }
 }
 
-static void mark_hash_pairs(const void *key, void **value, void *cl)
+static void mark_hash_pair(struct object *key, struct object *value, void *cl)
 {
-    objects_mark((struct object *) key);
-    objects_mark((struct object *) *value);
+    objects_mark(key);
+    objects_mark(value);
 }
 
 static void hash_object_mark(struct hash_object *hash)
 {
     hash->marked = true;
-    Table_map(hash->pairs, mark_hash_pairs, NULL);
+    hamt_map(hash->pairs, mark_hash_pair, NULL);
+}
+
+static void string_object_mark(struct string_object *string)
+{
+    string->marked = true;
+    if (string->parent != NULL)
+    {
+        string->parent->marked = true;
+    }
 }
 
 static void return_value_mark(struct return_value *return_value)
@@ -589,16 +1027,17 @@ static void function_object_mark(struct function_object *function)
     objects_mark((struct object *) function->env);
 }
 
-static void mark_store(const void *key, void **value, void *cl)
-{
-    objects_mark((struct object *) *value);   
-}
-
 static void env_object_mark(struct env_object *env)
 {
     env->marked = true;
-    Table_map(env->store, mark_store, NULL);
-    
+    for (int i = 0; i < env->count; i++)
+    {
+        objects_mark(env->values[i]);
+    }
+    if (env->outer != NULL)
+    {
+        objects_mark((struct object *) env->outer);
+    }
 }
 
 static void objects_mark(struct object *object)
@@ -610,12 +1049,19 @@ static void objects_mark(struct object *object)
     switch (object->type)
     {
     case INTEGER_OBJ:
-    case STRING_OBJ:
     case ERROR_OBJ:
+    case RANGE_OBJ:
+    case BIG_INTEGER_OBJ:
+    case LINES_OBJ:
     {
         object->marked = true;
         break;
     }
+    case STRING_OBJ:
+    {
+        string_object_mark((struct string_object *) object);
+        break;
+    }
     case ARRAY_OBJ:
     {
         array_object_mark((struct array_object *) object);
@@ -647,20 +1093,20 @@ static void objects_mark(struct object *object)
     }    
 }
 
-void objects_gc(struct env_object *env)
+void objects_gc(struct interpreter_state *state, struct env_object *env)
 {
     int len;
     struct object *object;
 
     objects_mark((struct object *) env);
-    len = Seq_length(allocated_objects);
+    len = Seq_length(state->allocated_objects);
     for (int i = 0; i < len; i++)
     {
-        object = (struct object *) Seq_remlo(allocated_objects);
+        object = (struct object *) Seq_remlo(state->allocated_objects);
         if (object->marked)
         {
             object->marked = false;
-            Seq_addhi(allocated_objects, object);
+            Seq_addhi(state->allocated_objects, object);
         }
         else
         {
@@ -669,11 +1115,157 @@ void objects_gc(struct env_object *env)
     }
 }
 
-void objects_destroy(void)
+/* Objects a loop makes before it is worth looking for garbage. */
+#define SCOPE_MIN (1 << 15)
+
+static void rescue(struct object *object);
+
+static void rescue_pair(struct object *key, struct object *value, void *cl)
+{
+    rescue(key);
+    rescue(value);
+}
+
+/*
+ * The objects made in a scope are flagged as garbage, and those found
+ * here are unflagged.  Older objects are never flagged, so the search
+ * stops at them, and builtins are always flagged but never collected.
+ */
+static void rescue(struct object *object)
+{
+    struct env_object *env;
+
+    if (!object->marked || object->type == BUILTIN_OBJ)
+    {
+        return;
+    }
+    object->marked = false;
+    switch (object->type)
+    {
+    case STRING_OBJ:
+    {
+        if (((struct string_object *) object)->parent != NULL)
+        {
+            rescue((struct object *) ((struct string_object *) object)->parent);
+        }
+        break;
+    }
+    case ARRAY_OBJ:
+    {
+        if (((struct array_object *) object)->elements != NULL)
+        {
+            for (int i = 0; i < Seq_length(((struct array_object *) object)->elements); i++)
+            {
+                rescue(Seq_get(((struct array_object *) object)->elements, i));
+            }
+        }
+        break;
+    }
+    case HASH_OBJ:
+    {
+        hamt_map(((struct hash_object *) object)->pairs, rescue_pair, NULL);
+        break;
+    }
+    case FUNC_OBJ:
+    {
+        rescue((struct object *) ((struct function_object *) object)->env);
+        break;
+    }
+    case RETURN_VALUE_OBJ:
+    {
+        rescue(((struct return_value *) object)->value);
+        break;
+    }
+    case ENV_OBJ:
+    {
+        env = (struct env_object *) object;
+        for (int i = 0; i < env->count; i++)
+        {
+            rescue(env->values[i]);
+        }
+        if (env->outer != NULL)
+        {
+            rescue((struct object *) env->outer);
+        }
+        break;
+    }
+    default:
+    {
+    }
+    }
+}
+
+void objects_scope_begin(struct interpreter_state *state, struct objects_scope *scope)
+{
+    scope->base = Seq_length(state->allocated_objects);
+    scope->limit = SCOPE_MIN;
+}
+
+/*
+ * Collects once the scope has made limit objects, and sets limit so the
+ * next search is at least as far off as this one was long.
+ */
+void objects_scope_collect(struct interpreter_state *state, struct objects_scope *scope,
+                           Seq_T kept, struct object *root)
+{
+    int made = Seq_length(state->allocated_objects) - scope->base;
+    struct object **objects;
+    int survivors = 0;
+    int work;
+
+    if (made < scope->limit)
+    {
+        return;
+    }
+    objects = ALLOC(made * sizeof *objects);
+    for (int i = made - 1; i >= 0; i--)
+    {
+        objects[i] = Seq_remhi(state->allocated_objects);
+        objects[i]->marked = true;
+    }
+    for (int i = 0; kept != NULL && i < Seq_length(kept); i++)
+    {
+        rescue(Seq_get(kept, i));
+    }
+    if (root != NULL)
+    {
+        rescue(root);
+    }
+    for (int i = 0; i < made; i++)
+    {
+        if (objects[i]->marked)
+        {
+            object_destroy(objects[i]);
+        }
+        else
+        {
+            Seq_addhi(state->allocated_objects, objects[i]);
+            survivors++;
+        }
+    }
+    FREE(objects);
+    work = survivors + (kept != NULL ? Seq_length(kept) : 0);
+    scope->limit = survivors + (work > SCOPE_MIN ? work : SCOPE_MIN);
+}
+
+int objects_allocated(struct interpreter_state *state)
+{
+    return Seq_length(state->allocated_objects);
+}
+
+void objects_move(struct interpreter_state *state, struct interpreter_state *from)
+{
+    while (Seq_length(from->allocated_objects) > 0)
+    {
+        Seq_addhi(state->allocated_objects, Seq_remlo(from->allocated_objects));
+    }
+}
+
+void objects_destroy(struct interpreter_state *state)
 {
-    while (Seq_length(allocated_objects) > 0)
+    while (Seq_length(state->allocated_objects) > 0)
     {
-        object_destroy((struct object *) Seq_remlo(allocated_objects));
+        object_destroy((struct object *) Seq_remlo(state->allocated_objects));
     }
-    Seq_free(&allocated_objects);
+    Seq_free(&state->allocated_objects);
 }
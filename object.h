@@ -2,10 +2,14 @@
 #define OBJECT_H
 
 #include <stdbool.h>
+#include <ap.h>
 #include <table.h>
 #include <text.h>
 #include <seq.h>
 
+#include "hamt.h"
+#include "state.h"
+
 enum object_type
 {
     INTEGER_OBJ,
@@ -18,7 +22,10 @@ enum object_type
     RETURN_VALUE_OBJ,
     ENV_OBJ,
     NULL_OBJ,
-    ERROR_OBJ
+    ERROR_OBJ,
+    RANGE_OBJ,
+    BIG_INTEGER_OBJ,
+    LINES_OBJ
 };
 
 extern const char *object_type_str[];
@@ -29,12 +36,31 @@ struct object
     bool marked;
 };
 
+/* Bindings a fresh environment holds before it needs a table. */
+#define ENV_SLOTS 8
+
+/*
+ * Most environments are call frames with a handful of parameters, so
+ * names and values start out in the inline slots and are searched in
+ * order.  Past ENV_SLOTS bindings they move to arrays of their own and
+ * index is made to find them, with filter, a bit per name, to turn most
+ * names away first.  A binding keeps its slot for as long as the
+ * environment lives, so call sites can remember where they found it.
+ */
 struct env_object
 {
     enum object_type type;
     bool marked;
-    Table_T store;
+    int count;
+    int size;
+    Text_T *names;
+    struct object **values;
+    /* Maps each name to its slot + 1 once the inline slots are full. */
+    Table_T index;
+    unsigned long long filter;
     struct env_object *outer;
+    Text_T inline_names[ENV_SLOTS];
+    struct object *inline_values[ENV_SLOTS];
 };
 
 struct integer_object
@@ -42,7 +68,18 @@ struct integer_object
     enum object_type type;
     bool marked;
     long long value;
-    char inspect[24];
+};
+
+/*
+ * An integer arithmetic promoted past the range of a long long.  Results
+ * that fit are always INTEGER_OBJ again, so the two never hold the same
+ * value.
+ */
+struct big_integer_object
+{
+    enum object_type type;
+    bool marked;
+    AP_T value;
 };
 
 struct boolean_object
@@ -50,30 +87,76 @@ struct boolean_object
     enum object_type type;
     bool marked;
     bool value;
-    char *inspect;
 };
 
+/*
+ * length is cached so no builtin needs strlen.  A slice has a parent,
+ * whose buffer value points into and which it keeps alive; its value
+ * is not NUL terminated, so terminated holds a copy that is, made once
+ * asked.
+ */
 struct string_object
 {
     enum object_type type;
     bool marked;
     char *value;
+    int length;
+    struct string_object *parent;
+    char *terminated;
 };
 
+/*
+ * An array whose elements are all integers keeps them unboxed in ints
+ * and has no elements; any other array keeps its objects in elements.
+ * array_object_alloc picks the form, so only code that reaches inside
+ * an array needs to know.
+ */
 struct array_object
 {
     enum object_type type;
     bool marked;
     Seq_T elements;
-    char *inspect;
+    long long *ints;
+    int length;
+};
+
+/* The integers from start up to, but not including, end by step. */
+struct range_object
+{
+    enum object_type type;
+    bool marked;
+    long long start;
+    long long end;
+    long long step;
+    long long length;
+};
+
+/*
+ * The lines of a file without their line endings, read through buf
+ * only as they are asked for, so the file is never held whole.  They
+ * can be iterated once: fd is closed at the end of the file, or when
+ * the GC frees them, and a read error ends them early.
+ */
+struct lines_object
+{
+    enum object_type type;
+    bool marked;
+    int fd;
+    /* The bytes from start up to end of buf are read but not returned. */
+    char *buf;
+    int size;
+    int start;
+    int end;
+    char *path;
 };
 
+/* pairs is a persistent trie, so hashes derived from this one share it. */
 struct hash_object
 {
     enum object_type type;
     bool marked;
-    Table_T pairs;
-    char *inspect;
+    struct hamt_node *pairs;
+    int length;
 };
 
 struct function_object
@@ -82,14 +165,38 @@ struct function_object
     bool marked;
     struct env_object *env;
     struct function_literal *value;
-    char *inspect;
 };
 
+/* Builtins taking any number of arguments; argv holds argc of them. */
+typedef struct object *(*native_fn)(struct interpreter_state *state, int argc,
+                                    struct object **argv, void *cl);
+/* Builtins of a fixed arity get their arguments directly. */
+typedef struct object *(*native1_fn)(struct interpreter_state *state,
+                                     struct object *arg1, void *cl);
+typedef struct object *(*native2_fn)(struct interpreter_state *state,
+                                     struct object *arg1, struct object *arg2, void *cl);
+typedef struct object *(*native3_fn)(struct interpreter_state *state,
+                                     struct object *arg1, struct object *arg2,
+                                     struct object *arg3, void *cl);
+
+/*
+ * native is called when arity is 0; otherwise arity says which member of
+ * fixed to call.  Calls to a fixed builtin evaluate their arguments on
+ * the C stack.
+ */
 struct builtin_object
 {
     enum object_type type;
     bool marked;
-    struct object *(*value)(Seq_T args);
+    native_fn native;
+    int arity;
+    union
+    {
+        native1_fn one;
+        native2_fn two;
+        native3_fn three;
+    } fixed;
+    void *cl;
 };
 
 struct return_value
@@ -103,7 +210,6 @@ struct null_object
 {
     enum object_type type;
     bool marked;
-    char *inspect;
 };
 
 struct error_object
@@ -113,32 +219,131 @@ struct error_object
     char value[128];
 };
 
+/* Shared by every interpreter; the GC never marks them. */
 extern struct boolean_object true_object;
 extern struct boolean_object false_object;
 extern struct null_object null_object;
 
-void objects_init(void);
-void objects_gc(struct env_object *env);
-void objects_destroy(void);
+void objects_init(struct interpreter_state *state);
+void objects_gc(struct interpreter_state *state, struct env_object *env);
+int objects_allocated(struct interpreter_state *state);
+/*
+ * Lets a builtin that calls functions in a loop free what each call
+ * leaves behind, so the loop runs in constant memory.  No object comes
+ * to refer to one made after it, and between calls nothing made since
+ * the loop began is held outside it, so whatever the loop's own results
+ * cannot reach is garbage.
+ */
+struct objects_scope
+{
+    /* How many objects there were when the loop began. */
+    int base;
+    /* How many more there may be before they are collected. */
+    int limit;
+};
+void objects_scope_begin(struct interpreter_state *state, struct objects_scope *scope);
+/* Call between calls; kept and root, either of which may be NULL, are what the loop holds. */
+void objects_scope_collect(struct interpreter_state *state, struct objects_scope *scope,
+                           Seq_T kept, struct object *root);
+/* Makes state own every object from owns, leaving from empty. */
+void objects_move(struct interpreter_state *state, struct interpreter_state *from);
+void objects_destroy(struct interpreter_state *state);
+static inline bool is_integer(struct object *object)
+{
+    return object->type == INTEGER_OBJ || object->type == BIG_INTEGER_OBJ;
+}
 static inline bool is_object_hash_key(struct object *object)
 {
-    return object->type == INTEGER_OBJ
+    return is_integer(object)
         || object->type == BOOLEAN_OBJ
         || object->type == STRING_OBJ;
 }
+/*
+ * Arrays and ranges are sequences: their length is known and any
+ * element can be fetched by position.  A range makes the element asked
+ * for, so walking one never materializes it.
+ */
+static inline bool is_sequence(struct object *object)
+{
+    return object->type == ARRAY_OBJ || object->type == RANGE_OBJ;
+}
+/* Wraps like the unsigned arithmetic that found the range's length. */
+static inline long long range_get(struct range_object *range, long long i)
+{
+    return (long long) ((unsigned long long) range->start
+                        + (unsigned long long) i * (unsigned long long) range->step);
+}
+long long sequence_length(struct object *object);
+/* i must be within the sequence. */
+struct object *sequence_get(struct interpreter_state *state, struct object *object,
+                            long long i);
+
+/* Visits the elements of anything iterable in order. */
+struct iterator
+{
+    struct object *object;
+    long long next;
+};
+
+static inline bool is_iterable(struct object *object)
+{
+    return is_sequence(object) || object->type == LINES_OBJ;
+}
+void iterator_init(struct iterator *iterator, struct object *object);
+/* NULL once every element has been visited. */
+struct object *iterator_next(struct interpreter_state *state, struct iterator *iterator);
+
+/* Orders by bytes, then by length. */
+int string_cmp(struct string_object *s1, struct string_object *s2);
 int object_cmp(const void *x, const void *y);
 unsigned object_hash(const void *x);
+/*
+ * Writes object as the REPL prints it.  Nothing is kept, so this costs
+ * time and memory in proportion to what is written, however deeply
+ * object nests.
+ */
+void object_write(struct object *object, struct output *output);
+/* What object_write would write, as a new string the caller must FREE. */
 char *object_inspect(struct object *object);
-struct integer_object *integer_object_alloc(long long value);
+struct integer_object *integer_object_alloc(struct interpreter_state *state, long long value);
+/* Takes value, and makes an INTEGER_OBJ of it if it fits. */
+struct object *integer_object_from_ap(struct interpreter_state *state, AP_T value);
+/* A new AP_T holding either kind of integer. */
+AP_T integer_to_ap(struct object *integer);
 struct boolean_object *boolean_object_alloc(bool value);
-struct string_object *string_object_alloc(Text_T value);
-struct array_object *array_object_alloc(Seq_T elements);
-struct hash_object *hash_object_alloc(Table_T pairs);
-struct function_object *function_object_alloc(struct function_literal *value,
+struct string_object *string_object_alloc(struct interpreter_state *state, Text_T value);
+/* string's bytes followed by a NUL, which may be a copy kept with it. */
+const char *string_object_cstr(struct string_object *string);
+/* Takes value, length bytes and a NUL allocated with ALLOC, without copying it. */
+struct string_object *string_object_take(struct interpreter_state *state, char *value,
+                                         int length);
+/* The length bytes of string from start, sharing its buffer. */
+struct string_object *string_slice_alloc(struct interpreter_state *state,
+                                         struct string_object *string, int start, int length);
+/* Takes elements, which it frees if the array is stored unboxed. */
+struct array_object *array_object_alloc(struct interpreter_state *state, Seq_T elements);
+/* Takes ints, which holds length > 0 integers allocated with ALLOC. */
+struct array_object *int_array_object_alloc(struct interpreter_state *state, long long *ints,
+                                            int length);
+/* Takes pairs, which it frees once they are copied into a trie. */
+struct hash_object *hash_object_alloc(struct interpreter_state *state, Table_T pairs);
+/* Takes the reference to pairs, a trie of length pairs. */
+struct hash_object *hash_object_take(struct interpreter_state *state, struct hamt_node *pairs,
+                                     int length);
+/* step must not be 0. */
+struct range_object *range_object_alloc(struct interpreter_state *state, long long start,
+                                        long long end, long long step);
+/* Takes fd, open for reading path. */
+struct lines_object *lines_object_alloc(struct interpreter_state *state, int fd,
+                                        const char *path);
+struct function_object *function_object_alloc(struct interpreter_state *state,
+                                              struct function_literal *value,
                                               struct env_object *env);
-struct return_value *return_value_alloc(struct object *value);
-struct error_object *error_object_alloc(const char *value, ...);
-struct env_object *env_object_alloc(struct env_object *outer);
+struct return_value *return_value_alloc(struct interpreter_state *state, struct object *value);
+struct error_object *error_object_alloc(struct interpreter_state *state, const char *value, ...);
+struct env_object *env_object_alloc(struct interpreter_state *state, struct env_object *outer);
+/* The slot env itself binds name in, or -1. */
+int env_slot(struct env_object *env, Text_T name);
 struct object *env_get(struct env_object *env, Text_T name);
 struct object *env_set(struct env_object *env, Text_T name, struct object *value);
 void free_hash_pairs(const void *key, void **value, void *cl);
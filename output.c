@@ -0,0 +1,99 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+#include <unistd.h>
+#include <mem.h>
+
+#include "output.h"
+
+/* Large enough that a pipe takes a whole buffer per write. */
+#define OUTPUT_BUFFER (1 << 16)
+/* Where a string starts; most inspected values are short. */
+#define STRING_BUFFER 64
+
+void output_init(struct output *output, FILE *stream)
+{
+    output->stream = stream;
+    output->size = stream != NULL ? OUTPUT_BUFFER : STRING_BUFFER;
+    output->data = ALLOC(output->size);
+    output->length = 0;
+    output->interactive = stream != NULL && isatty(fileno(stream));
+}
+
+void output_free(struct output *output)
+{
+    output_flush(output);
+    FREE(output->data);
+}
+
+char *output_take(struct output *output)
+{
+    output_reserve(output, 1);
+    output->data[output->length] = '\0';
+    return output->data;
+}
+
+/* Makes room for n more bytes, which may mean flushing first. */
+static void make_room(struct output *output, int n)
+{
+    if (output->stream != NULL)
+    {
+        output_flush(output);
+        return;
+    }
+    while (output->size - output->length < n)
+    {
+        output->size *= 2;
+    }
+    RESIZE(output->data, output->size);
+}
+
+/* Writes longer than a stream's buffer skip it. */
+void output_write(struct output *output, const char *bytes, int n)
+{
+    if (output->length + n > output->size)
+    {
+        make_room(output, n);
+        if (n > output->size)
+        {
+            fwrite(bytes, 1, n, output->stream);
+            fflush(output->stream);
+            return;
+        }
+    }
+    memcpy(output->data + output->length, bytes, n);
+    output->length += n;
+}
+
+void output_reserve(struct output *output, int n)
+{
+    if (output->length + n > output->size)
+    {
+        make_room(output, n);
+    }
+}
+
+void output_line(struct output *output)
+{
+    output_reserve(output, 1);
+    output->data[output->length++] = '\n';
+    if (output->interactive)
+    {
+        output_flush(output);
+    }
+}
+
+/* The stream is flushed too, so what is later written to it through stdio comes after. */
+void output_flush(struct output *output)
+{
+    if (output->stream == NULL)
+    {
+        return;
+    }
+    if (output->length > 0)
+    {
+        fwrite(output->data, 1, output->length, output->stream);
+        output->length = 0;
+    }
+    fflush(output->stream);
+}
@@ -0,0 +1,37 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/*
+ * Bytes on their way to a stream, gathered so that writing many short
+ * lines costs a copy each and a write per buffer.  They reach the
+ * stream when the buffer fills and at each output_flush; a terminal
+ * also gets them whenever a line is finished, as stdio would.  With no
+ * stream, the buffer grows to hold everything written, for
+ * output_take.
+ */
+struct output
+{
+    FILE *stream;
+    char *data;
+    int length;
+    int size;
+    bool interactive;
+};
+
+/* stream may be NULL. */
+void output_init(struct output *output, FILE *stream);
+/* Flushes, then frees the buffer. */
+void output_free(struct output *output);
+/* The NUL terminated bytes of an output with no stream, which it gives up. */
+char *output_take(struct output *output);
+void output_write(struct output *output, const char *bytes, int n);
+/* Makes room for a few bytes at data + length, which the caller then fills. */
+void output_reserve(struct output *output, int n);
+/* Marks the end of a line, flushing if the stream is a terminal. */
+void output_line(struct output *output);
+void output_flush(struct output *output);
+
+#endif
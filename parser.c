@@ -1,8 +1,10 @@
+#include <errno.h>
+#include <limits.h>
 #include <stdlib.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <fmt.h>
 #include <mem.h>
-#include <table.h>
 
 #include "parser.h"
 
@@ -30,33 +32,70 @@ struct infix_parse_fn
     struct expression *(*fn)(struct parser *, struct expression *);
 };
 
-static Table_T prefix_parse_fns;
-static Table_T infix_parse_fns;
-static Table_T precedences;
+static struct identifier *parse_identifier(struct parser *parser);
+static struct string_literal *parse_string_literal(struct parser *parser);
+static struct integer_literal *parse_integer_literal(struct parser *parser);
+static struct boolean *parse_boolean(struct parser *parser);
+static struct array_literal *parse_array_literal(struct parser *parser);
+static struct hash_literal *parse_hash_literal(struct parser *parser);
+static struct expression *parse_grouped_expression(struct parser *parser);
+static struct expression *parse_prefix_expression(struct parser *parser);
+static struct expression *parse_if_expression(struct parser *parser);
+static struct expression *parse_function_literal(struct parser *parser);
+static struct expression *parse_infix_expression(struct parser *parser,
+                                                 struct expression *left);
+static struct expression *parse_call_expression(struct parser *parser,
+                                                struct expression *function);
+static struct expression *parse_index_expression(struct parser *parser,
+                                                 struct expression *left);
+
+/*
+ * Indexed by token type and never written, so every parser on every
+ * thread can share them.
+ */
+static const enum precedence_type precedences[TOKEN_TYPES] =
+{
+    [EQ] = EQUALS_PREC,
+    [NOT_EQ] = EQUALS_PREC,
+    [LT] = LESSGREATER_PREC,
+    [GT] = LESSGREATER_PREC,
+    [PLUS] = SUM_PREC,
+    [MINUS] = SUM_PREC,
+    [SLASH] = PRODUCT_PREC,
+    [ASTERISK] = PRODUCT_PREC,
+    [LPAREN] = CALL_PREC,
+    [LBRAKET] = INDEX_PREC
+};
 
-static int int_cmp (const void *x, const void *y)
-{
-    int ix = *((int *) x);
-    int iy = *((int *) y);
-    
-    if (ix < iy)
-    {
-        return -1;
-    }
-    else if (ix > iy)
-    {
-        return +1;
-    }
-    else
-    {
-        return 0;
-    }
-}
+static const struct prefix_parse_fn prefix_parse_fns[TOKEN_TYPES] =
+{
+    [IDENT] = {(struct expression *(*)(struct parser *)) parse_identifier},
+    [STRING] = {(struct expression *(*)(struct parser *)) parse_string_literal},
+    [INT] = {(struct expression *(*)(struct parser *)) parse_integer_literal},
+    [LBRAKET] = {(struct expression *(*)(struct parser *)) parse_array_literal},
+    [LBRACE] = {(struct expression *(*)(struct parser *)) parse_hash_literal},
+    [TRUE] = {(struct expression *(*)(struct parser *)) parse_boolean},
+    [FALSE] = {(struct expression *(*)(struct parser *)) parse_boolean},
+    [BANG] = {parse_prefix_expression},
+    [MINUS] = {parse_prefix_expression},
+    [LPAREN] = {parse_grouped_expression},
+    [IF] = {parse_if_expression},
+    [FUNCTION] = {parse_function_literal}
+};
 
-static unsigned int_hash(const void *x)
-{
-    return *((int *)x);
-}
+static const struct infix_parse_fn infix_parse_fns[TOKEN_TYPES] =
+{
+    [PLUS] = {parse_infix_expression},
+    [MINUS] = {parse_infix_expression},
+    [SLASH] = {parse_infix_expression},
+    [ASTERISK] = {parse_infix_expression},
+    [EQ] = {parse_infix_expression},
+    [NOT_EQ] = {parse_infix_expression},
+    [LT] = {parse_infix_expression},
+    [GT] = {parse_infix_expression},
+    [LPAREN] = {parse_call_expression},
+    [LBRAKET] = {parse_index_expression}
+};
 
 static void peek_error(struct parser *parser, enum token_type type)
 {
@@ -80,14 +119,12 @@ static void no_prefix_parse_fn_error(struct parser *parser, enum token_type type
 
 static enum precedence_type peek_precedence(struct parser *parser)
 {
-    return (enum precedence_type) Table_get(precedences,
-                                            &parser->peek_token.type);
+    return precedences[parser->peek_token.type];
 }
 
 static enum precedence_type cur_precedence(struct parser *parser)
 {
-    return (enum precedence_type) Table_get(precedences,
-                                            &parser->cur_token.type);
+    return precedences[parser->cur_token.type];
 }
 
 static void next_token(struct parser *parser)
@@ -143,7 +180,7 @@ static struct string_literal *parse_string_literal(struct parser *parser)
 static struct integer_literal *parse_integer_literal(struct parser *parser)
 {
     struct integer_literal *integer_literal;
-    long long value;
+    unsigned long long value;
     char *value_str = NULL;
     char *end;
     char *msg;
@@ -151,6 +188,7 @@ static struct integer_literal *parse_integer_literal(struct parser *parser)
 
     integer_literal = integer_literal_alloc(parser->cur_token);
     value_str = Text_get(NULL, 0, parser->cur_token.literal);
+    errno = 0;
     value = strtoull(value_str, &end, 10);
     if (*end)
     {
@@ -160,7 +198,14 @@ static struct integer_literal *parse_integer_literal(struct parser *parser)
         Seq_addhi(parser->errors, msg);
         goto cleanup;
     }
-    integer_literal->value = value;
+    if (errno == ERANGE || value > LLONG_MAX)
+    {
+        integer_literal->big = true;
+    }
+    else
+    {
+        integer_literal->value = value;
+    }
     success = true;
 
 cleanup:
@@ -184,13 +229,12 @@ static struct boolean *parse_boolean(struct parser *parser)
 static struct expression *parse_expression(struct parser *parser,
                                            enum precedence_type precedence)
 {
-    struct prefix_parse_fn *prefix_parse_fn;
-    struct infix_parse_fn *infix_parse_fn;
+    const struct prefix_parse_fn *prefix_parse_fn;
+    const struct infix_parse_fn *infix_parse_fn;
     struct expression *left_expression;
 
-    prefix_parse_fn = (struct prefix_parse_fn *)
-        Table_get(prefix_parse_fns, &parser->cur_token.type);
-    if (prefix_parse_fn == NULL)
+    prefix_parse_fn = &prefix_parse_fns[parser->cur_token.type];
+    if (prefix_parse_fn->fn == NULL)
     {
         no_prefix_parse_fn_error(parser, parser->cur_token.type);
         return NULL;
@@ -199,9 +243,8 @@ static struct expression *parse_expression(struct parser *parser,
     while (!peek_token_is(parser, SEMICOLON)
            && precedence < peek_precedence(parser))
     {
-        infix_parse_fn = (struct infix_parse_fn *)
-            Table_get(infix_parse_fns, &parser->peek_token.type);
-        if (infix_parse_fn == NULL)
+        infix_parse_fn = &infix_parse_fns[parser->peek_token.type];
+        if (infix_parse_fn->fn == NULL)
         {
             return left_expression;
         }
@@ -569,15 +612,55 @@ cleanup:
     return hash_literal;
 }
 
+/* left[start:end], with the start, if any, already parsed and current. */
+static struct expression *parse_slice_expression(struct parser *parser,
+                                                 struct token token,
+                                                 struct expression *left,
+                                                 struct expression *start)
+{
+    struct slice_expression *slice_expression;
+
+    slice_expression = slice_expression_alloc(token);
+    slice_expression->left = left;
+    slice_expression->start = start;
+    if (start != NULL)
+    {
+        next_token(parser);
+    }
+    if (!peek_token_is(parser, RBRAKET))
+    {
+        next_token(parser);
+        slice_expression->end = parse_expression(parser, LOWEST_PREC);
+    }
+    if (!expect_peek(parser, RBRAKET))
+    {
+        slice_expression_destroy(slice_expression);
+        slice_expression = NULL;
+    }
+    return (struct expression *) slice_expression;
+}
+
 static struct expression *parse_index_expression(struct parser *parser,
                                                  struct expression *left)
 {
     struct index_expression *index_expression;
+    struct token token;
+    struct expression *index;
 
-    index_expression = index_expression_alloc(parser->cur_token);
-    index_expression->left = left;
+    token = parser->cur_token;
     next_token(parser);
-    index_expression->index = parse_expression(parser, LOWEST_PREC);
+    if (cur_token_is(parser, COLON))
+    {
+        return parse_slice_expression(parser, token, left, NULL);
+    }
+    index = parse_expression(parser, LOWEST_PREC);
+    if (index != NULL && peek_token_is(parser, COLON))
+    {
+        return parse_slice_expression(parser, token, left, index);
+    }
+    index_expression = index_expression_alloc(token);
+    index_expression->left = left;
+    index_expression->index = index;
     if (!expect_peek(parser, RBRAKET))
     {
         index_expression_destroy(index_expression);
@@ -586,80 +669,17 @@ static struct expression *parse_index_expression(struct parser *parser,
     return (struct expression *) index_expression;
 }
 
-void parser_init(void)
+static void register_formats(void)
 {
-    static struct type_precedence
-    {
-        enum token_type type;
-        enum precedence_type precedence;
-    } type_precedences[] =
-      {
-          { EQ, EQUALS_PREC },
-          { NOT_EQ, EQUALS_PREC },
-          { LT, LESSGREATER_PREC },
-          { GT, LESSGREATER_PREC },
-          { PLUS, SUM_PREC },
-          { MINUS, SUM_PREC },
-          { SLASH, PRODUCT_PREC },
-          { ASTERISK, PRODUCT_PREC },
-          { LPAREN, CALL_PREC },
-          { LBRAKET, INDEX_PREC }
-      };
-    static struct type_prefix
-    {
-        enum token_type type;
-        struct prefix_parse_fn prefix_parse_fn;
-    } type_prefixes[] =
-      {
-          {IDENT, {(struct expression *(*)(struct parser *)) parse_identifier}},
-          {STRING, {(struct expression *(*)(struct parser *)) parse_string_literal}},
-          {INT, {(struct expression *(*)(struct parser *)) parse_integer_literal}},
-          {LBRAKET, {(struct expression *(*)(struct parser *)) parse_array_literal}},
-          {LBRACE, {(struct expression *(*)(struct parser *)) parse_hash_literal}},
-          {TRUE, {(struct expression *(*)(struct parser *)) parse_boolean}},
-          {FALSE, {(struct expression *(*)(struct parser *)) parse_boolean}},
-          {BANG, {parse_prefix_expression}},
-          {MINUS, {parse_prefix_expression}},
-          {LPAREN, {parse_grouped_expression}},
-          {IF, {parse_if_expression}},
-          {FUNCTION, {parse_function_literal}}
-      };
-    static struct type_infix
-    {
-        enum token_type type;
-        struct infix_parse_fn infix_parse_fn;
-    } type_infixes[] =
-      {
-          {PLUS, {parse_infix_expression}},          
-          {MINUS, {parse_infix_expression}},
-          {SLASH, {parse_infix_expression}},
-          {ASTERISK, {parse_infix_expression}},
-          {EQ, {parse_infix_expression}},
-          {NOT_EQ, {parse_infix_expression}},
-          {LT, {parse_infix_expression}},
-          {GT, {parse_infix_expression}},
-          {LPAREN, {parse_call_expression}},
-          {LBRAKET, {parse_index_expression}}
-      };
     Fmt_register('T', Text_fmt);
-    precedences = Table_new(0, int_cmp, int_hash);
-    prefix_parse_fns = Table_new(0, int_cmp, int_hash);
-    infix_parse_fns = Table_new(0, int_cmp, int_hash);
-    for (int i = 0; i < sizeof type_precedences / sizeof type_precedences[0]; i++)
-    {
-        Table_put(precedences, &type_precedences[i].type,
-                  (void *) type_precedences[i].precedence);
-    }
-    for (int i = 0; i < sizeof type_prefixes / sizeof type_prefixes[0]; i++)
-    {
-        Table_put(prefix_parse_fns, &type_prefixes[i].type,
-                  &type_prefixes[i].prefix_parse_fn);
-    }
-    for (int i = 0; i < sizeof type_infixes / sizeof type_infixes[0]; i++)
-    {
-        Table_put(infix_parse_fns, &type_infixes[i].type,
-                  &type_infixes[i].infix_parse_fn);
-    }
+}
+
+/* Fmt's conversion table is process-wide, so it is filled in only once. */
+void parser_init(void)
+{
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+    pthread_once(&once, register_formats);
 }
 
 struct parser *parser_alloc(struct lexer *lexer)
@@ -687,19 +707,26 @@ void parser_destroy(struct parser *parser)
     FREE(parser);
 }
 
+struct statement *parser_next_statement(struct parser *parser)
+{
+    struct statement *statement = NULL;
+
+    while (statement == NULL && parser->cur_token.type != END)
+    {
+        statement = parse_statement(parser);
+        next_token(parser);
+    }
+    return statement;
+}
+
 struct program *parser_parse_program(struct parser *parser)
 {
     struct program *program = program_alloc();
     struct statement *statement;
 
-    while (parser->cur_token.type != END)
+    while ((statement = parser_next_statement(parser)) != NULL)
     {
-        statement = parse_statement(parser);
-        if (statement != NULL)
-        {
-            program_append_statement(program, statement);
-        }
-        next_token(parser);
+        program_append_statement(program, statement);
     }
     return program;
 }
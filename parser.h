@@ -14,9 +14,12 @@ struct parser
     Seq_T errors;
 };
 
+/* Process-wide setup; safe to call from any thread, any number of times. */
 void parser_init(void);
 struct parser *parser_alloc(struct lexer *lexer);
 void parser_destroy(struct parser *parser);
 struct program *parser_parse_program(struct parser *parser);
+/* Parses one top-level statement; NULL at the end of the input. */
+struct statement *parser_next_statement(struct parser *parser);
 Seq_T parser_errors(struct parser *parser);
 #endif
@@ -1,9 +1,15 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <str.h>
 #include <mem.h>
 
 #include "parser.h"
+#include "cache.h"
 
 static int check_parse_errors(struct parser *parser)
 {
@@ -1397,6 +1403,14 @@ static int test_operator_precedence_parsing()
                   "add(a * b[2], b[1], 2 * [1, 2][1])",
                   "add((a * (b[2])), (b[1]), (2 * ([1, 2][1])))",
               },
+              {
+                  "a[1 + b:len(a) - 1] + a[:2][1:][:]",
+                  "((a[(1 + b):(len(a) - 1)]) + (((a[:2])[1:])[:]))",
+              },
+              {
+                  "{a[1:]: a[1]}[b]",
+                  "({(a[1:]) : (a[1])}[b])",
+              },
           };
     struct lexer *lexer = NULL;
     struct parser *parser = NULL;
@@ -1722,9 +1736,126 @@ cleanup:
     return success;
 }
 
+static int test_cache_round_trip(void)
+{
+    const char *input =
+        "let add = fn(a, b) { return a + b; };"
+        "let h = {\"one\": [1, -2, \"three\"], true: fn() {}};"
+        "if (!(add(1, 2) < 4)) { h[\"one\"] } else { puts(h) };"
+        "add(1, 2 * 3)[0];"
+        "add(99999999999999999999, 9223372036854775807);"
+        "h[\"one\"][1:][:-1][:];";
+    char path[] = "/tmp/parser_testXXXXXX";
+    char cache_path[sizeof path + sizeof CACHE_SUFFIX];
+    struct lexer *lexer = NULL;
+    struct parser *parser = NULL;
+    struct program *program = NULL;
+    struct cached_program *cached = NULL;
+    struct cache_writer *writer;
+    struct statement *statement;
+    struct stat st;
+    char *expected = NULL;
+    char *actual = NULL;
+    char *changed = NULL;
+    FILE *file;
+    int fd;
+    int success = -1;
+
+    fd = mkstemp(path);
+    if (fd < 0)
+    {
+        Fmt_print("cannot create %s\n", path);
+        return -1;
+    }
+    snprintf(cache_path, sizeof cache_path, "%s%s", path, CACHE_SUFFIX);
+    file = fdopen(fd, "w");
+    fputs(input, file);
+    fclose(file);
+    if (stat(path, &st) != 0)
+    {
+        goto cleanup;
+    }
+    writer = cache_writer_alloc(path, &st, input);
+    if (writer == NULL)
+    {
+        Fmt_print("cannot create cache for %s\n", path);
+        goto cleanup;
+    }
+    lexer = lexer_alloc(input);
+    parser = parser_alloc(lexer);
+    program = program_alloc();
+    while ((statement = parser_next_statement(parser)) != NULL)
+    {
+        cache_writer_add(writer, statement);
+        program_append_statement(program, statement);
+    }
+    cache_writer_commit(writer);
+    if (check_parse_errors(parser) != 0)
+    {
+        goto cleanup;
+    }
+    cached = cache_load(path, &st, input);
+    if (cached == NULL)
+    {
+        Fmt_print("cache_load returned NULL\n");
+        goto cleanup;
+    }
+    expected = program_to_string(program);
+    actual = program_to_string(cached->program);
+    if (strcmp(expected, actual) != 0)
+    {
+        Fmt_print("cached program wrong, expected=%s, got=%s\n", expected, actual);
+        goto cleanup;
+    }
+    /* The statement count follows the magic, version and byte order mark; one
+       larger than the file must not be believed. */
+    file = fopen(cache_path, "r+b");
+    fseek(file, 12, SEEK_SET);
+    fwrite("\xff\xff\xff\xff", 1, 4, file);
+    fclose(file);
+    if (cache_load(path, &st, input) != NULL)
+    {
+        Fmt_print("cache_load accepted a corrupt statement count\n");
+        goto cleanup;
+    }
+    /* A changed source with the same size must not use the cache. */
+    st.st_mtim.tv_sec++;
+    changed = Str_dup(input, 1, 0, 1);
+    changed[4] = 'b';
+    if (cache_load(path, &st, changed) != NULL)
+    {
+        Fmt_print("cache_load accepted a stale cache\n");
+        goto cleanup;
+    }
+    success = 0;
+
+cleanup:
+    FREE(expected);
+    FREE(actual);
+    FREE(changed);
+    if (cached != NULL)
+    {
+        cache_unload(cached);
+    }
+    if (program != NULL)
+    {
+        program_destroy(program);
+    }
+    if (parser != NULL)
+    {
+        parser_destroy(parser);
+    }
+    if (lexer != NULL)
+    {
+        lexer_destroy(lexer);
+    }
+    remove(cache_path);
+    remove(path);
+    return success;
+}
+
 int main(void)
 {
-    lexer_init();
     parser_init();
     if (test_let_statements() != 0)
     {
@@ -1802,6 +1933,10 @@ int main(void)
     {
         return EXIT_FAILURE;
     }
+    if (test_cache_round_trip() != 0)
+    {
+        return EXIT_FAILURE;
+    }
     printf("Tests successful\n");
     return EXIT_SUCCESS;
 }
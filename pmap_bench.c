@@ -0,0 +1,79 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "compile.h"
+#include "object.h"
+#include "state.h"
+
+#define ELEMENTS 1000000
+
+/* A pure, CPU-bound transform of each element. */
+static const char *program =
+    "let f = fn(x) { let fib = fn(n) { if (n < 2) { n } else { fib(n - 1) + fib(n - 2) } }; "
+    "fib(x - x / 4 * 4) * x }; len(%s(xs, f))";
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double run(struct interpreter_state *state, const char *builtin)
+{
+    struct compiled_program *compiled;
+    struct hash_object *inputs;
+    struct object *object;
+    Seq_T elements;
+    Table_T pairs;
+    char source[256];
+    double start;
+    double secs;
+
+    elements = Seq_new(ELEMENTS);
+    for (int i = 0; i < ELEMENTS; i++)
+    {
+        Seq_addhi(elements, integer_object_alloc(state, i));
+    }
+    pairs = Table_new(1, object_cmp, object_hash);
+    Table_put(pairs, string_object_alloc(state, (Text_T) { 2, "xs" }),
+              array_object_alloc(state, elements));
+    inputs = hash_object_alloc(state, pairs);
+    snprintf(source, sizeof source, program, builtin);
+    compiled = compiled_program_alloc(source);
+    start = now();
+    object = compiled_program_run(state, compiled, inputs);
+    secs = now() - start;
+    if (object->type != INTEGER_OBJ || ((struct integer_object *) object)->value != ELEMENTS)
+    {
+        printf("%s failed: %s\n", builtin, object_inspect(object));
+    }
+    compiled_program_destroy(compiled);
+    return secs;
+}
+
+int main(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    struct interpreter_state *state;
+    double base;
+    double secs;
+
+    state = interpreter_state_alloc();
+    printf("%d elements, %ld cpus\n", ELEMENTS, cpus);
+    base = run(state, "map");
+    printf("map:              %.3f s\n", base);
+    for (int threads = 1; threads <= 2 * cpus; threads *= 2)
+    {
+        state->threads = threads;
+        secs = run(state, "pmap");
+        printf("pmap %3d threads: %.3f s, speedup %.2f\n", threads, secs, base / secs);
+    }
+    interpreter_state_destroy(state);
+    return EXIT_SUCCESS;
+}
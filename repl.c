@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 
 #include "repl.h"
 #include <mem.h>
@@ -8,30 +9,52 @@
 #include "parser.h"
 #include "evaluator.h"
 #include "object.h"
-#include "builtins.h"
+#include "state.h"
 
-static void print_parse_errors(struct parser *parser)
+static void print(struct output *output, const char *s)
+{
+    output_write(output, s, strlen(s));
+}
+
+static void print_parse_errors(struct output *output, struct parser *parser)
 {
-    char *msg;
-    
     for (int i = 0; i < Seq_length(parser->errors); i++)
     {
-        msg = (char *) Seq_get(parser->errors, i);
-        Fmt_print("\t%s\n", msg);
+        print(output, "\t");
+        print(output, (char *) Seq_get(parser->errors, i));
+        output_line(output);
     }    
 }
 
+#define LINE_SZ 1024
+
+/* Reads a whole line however long it is, growing *line as needed. */
+static char *read_line(char **line, int *size)
+{
+    int len = 0;
+
+    while (fgets(*line + len, *size - len, stdin) != NULL)
+    {
+        len += strlen(*line + len);
+        if ((*line)[len - 1] == '\n')
+        {
+            return *line;
+        }
+        *size *= 2;
+        RESIZE(*line, *size);
+    }
+    return len > 0 ? *line : NULL;
+}
+
 void repl_start(void)
 {
+    struct interpreter_state *state;
     struct env_object *env;
-    char input[1024];
+    int size = LINE_SZ;
+    char *input = ALLOC(size);
 
-    Fmt_register('T', Text_fmt);
-    lexer_init();
-    parser_init();
-    builtins_init();
-    objects_init();
-    env = env_object_alloc(NULL);
+    state = interpreter_state_alloc();
+    env = env_object_alloc(state, NULL);
     while (true)
     {
         struct lexer *lexer;
@@ -39,8 +62,10 @@ void repl_start(void)
         struct program *program;
         struct object *object;
 
-        Fmt_print(">> ");
-        if (fgets(input, sizeof input, stdin) == NULL)
+        /* Everything the last input printed goes out with the prompt. */
+        print(&state->output, ">> ");
+        output_flush(&state->output);
+        if (read_line(&input, &size) == NULL)
         {
             break;
         }
@@ -49,7 +74,7 @@ void repl_start(void)
         program = parser_parse_program(parser);
         if (Seq_length(parser->errors) != 0)
         {
-            print_parse_errors(parser);
+            print_parse_errors(&state->output, parser);
             program_destroy(program);
             parser_destroy(parser);
             lexer_destroy(lexer);
@@ -57,16 +82,18 @@ void repl_start(void)
         }
         if (Seq_length(program->statements) > 0)
         {
-            object = eval((struct node *) program, env);
+            object = eval(state, (struct node *) program, env);
             if (object != (struct object *) &null_object)
             {
-                Fmt_print("%s\n", object_inspect(object));
+                object_write(object, &state->output);
+                output_line(&state->output);
             }
-            objects_gc(env);
+            objects_gc(state, env);
         }
         program_destroy(program);
         parser_destroy(parser);
         lexer_destroy(lexer);
     }
-    objects_destroy();
+    FREE(input);
+    interpreter_state_destroy(state);
 }
@@ -0,0 +1,268 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include "scan.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+#define L LETTER
+#define D DIGIT
+#define S SPACE
+
+/* Indexed by unsigned char; everything past 0x7f is zero. */
+const unsigned char char_class[256] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 0, S, S, 0, 0, S, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    S, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    D, D, D, D, D, D, D, D, D, D, 0, 0, 0, 0, 0, 0,
+    0, L, L, L, L, L, L, L, L, L, L, L, L, L, L, L,
+    L, L, L, L, L, L, L, L, L, L, L, 0, 0, 0, 0, L,
+    0, L, L, L, L, L, L, L, L, L, L, L, L, L, L, L,
+    L, L, L, L, L, L, L, L, L, L, L, 0, 0, 0, 0, 0,
+};
+
+#undef L
+#undef D
+#undef S
+
+static const char *scalar_space(const char *p)
+{
+    while (is_space(*p))
+    {
+        p++;
+    }
+    return p;
+}
+
+static const char *scalar_letters(const char *p)
+{
+    while (is_letter(*p))
+    {
+        p++;
+    }
+    return p;
+}
+
+static const char *scalar_digits(const char *p)
+{
+    while (is_digit(*p))
+    {
+        p++;
+    }
+    return p;
+}
+
+static const char *scalar_string(const char *p)
+{
+    while (*p != '"' && *p != '\0')
+    {
+        p++;
+    }
+    return p;
+}
+
+static const struct scanner scalar_scanner =
+{
+    "scalar", scalar_space, scalar_letters, scalar_digits, scalar_string
+};
+
+#ifdef HAVE_X86_SIMD
+
+/*
+ * The stop functions return a byte mask that is set wherever the run
+ * ends.  '\0' is never part of a run, so the terminator's block always
+ * stops the scan and nothing past it is loaded.
+ */
+static inline __m128i sse2_space_stop(__m128i v)
+{
+    __m128i m;
+
+    m = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                     _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+    return _mm_xor_si128(m, _mm_set1_epi8(-1));
+}
+
+static inline __m128i sse2_letters_stop(__m128i v)
+{
+    __m128i lower;
+    __m128i m;
+
+    /* Folding case leaves only 'a'..'z', all below 0x80. */
+    lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    m = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                      _mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), lower));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+    return _mm_xor_si128(m, _mm_set1_epi8(-1));
+}
+
+static inline __m128i sse2_digits_stop(__m128i v)
+{
+    __m128i m;
+
+    m = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                      _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), v));
+    return _mm_xor_si128(m, _mm_set1_epi8(-1));
+}
+
+static inline __m128i sse2_string_stop(__m128i v)
+{
+    return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                        _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+}
+
+/* The loads may read past the end of a caller's string by design. */
+#define NO_ASAN __attribute__((no_sanitize_address))
+
+#define SSE2_RUN(name, stop)                                            \
+    static NO_ASAN const char *name(const char *p)                      \
+    {                                                                   \
+        size_t offset = (uintptr_t) p & 15;                             \
+        const char *block = p - offset;                                 \
+        unsigned mask;                                                  \
+                                                                        \
+        mask = _mm_movemask_epi8(stop(_mm_load_si128((const __m128i *) block))); \
+        mask >>= offset;                                                \
+        if (mask != 0)                                                  \
+        {                                                               \
+            return p + __builtin_ctz(mask);                             \
+        }                                                               \
+        for (;;)                                                        \
+        {                                                               \
+            block += 16;                                                \
+            mask = _mm_movemask_epi8(stop(_mm_load_si128((const __m128i *) block))); \
+            if (mask != 0)                                              \
+            {                                                           \
+                return block + __builtin_ctz(mask);                     \
+            }                                                           \
+        }                                                               \
+    }
+
+SSE2_RUN(sse2_space, sse2_space_stop)
+SSE2_RUN(sse2_letters, sse2_letters_stop)
+SSE2_RUN(sse2_digits, sse2_digits_stop)
+SSE2_RUN(sse2_string, sse2_string_stop)
+
+static const struct scanner sse2_scanner =
+{
+    "sse2", sse2_space, sse2_letters, sse2_digits, sse2_string
+};
+
+#define AVX2 __attribute__((target("avx2")))
+
+static inline AVX2 __m256i avx2_space_stop(__m256i v)
+{
+    __m256i m;
+
+    m = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                        _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+    return _mm256_xor_si256(m, _mm256_set1_epi8(-1));
+}
+
+static inline AVX2 __m256i avx2_letters_stop(__m256i v)
+{
+    __m256i lower;
+    __m256i m;
+
+    lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    m = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                         _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+    return _mm256_xor_si256(m, _mm256_set1_epi8(-1));
+}
+
+static inline AVX2 __m256i avx2_digits_stop(__m256i v)
+{
+    __m256i m;
+
+    m = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+                         _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+    return _mm256_xor_si256(m, _mm256_set1_epi8(-1));
+}
+
+static inline AVX2 __m256i avx2_string_stop(__m256i v)
+{
+    return _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+                           _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+}
+
+#define AVX2_RUN(name, stop)                                            \
+    static AVX2 NO_ASAN const char *name(const char *p)                 \
+    {                                                                   \
+        size_t offset = (uintptr_t) p & 31;                             \
+        const char *block = p - offset;                                 \
+        unsigned mask;                                                  \
+                                                                        \
+        mask = _mm256_movemask_epi8(stop(_mm256_load_si256((const __m256i *) block))); \
+        mask >>= offset;                                                \
+        if (mask != 0)                                                  \
+        {                                                               \
+            return p + __builtin_ctz(mask);                             \
+        }                                                               \
+        for (;;)                                                        \
+        {                                                               \
+            block += 32;                                                \
+            mask = _mm256_movemask_epi8(stop(_mm256_load_si256((const __m256i *) block))); \
+            if (mask != 0)                                              \
+            {                                                           \
+                return block + __builtin_ctz(mask);                     \
+            }                                                           \
+        }                                                               \
+    }
+
+AVX2_RUN(avx2_space, avx2_space_stop)
+AVX2_RUN(avx2_letters, avx2_letters_stop)
+AVX2_RUN(avx2_digits, avx2_digits_stop)
+AVX2_RUN(avx2_string, avx2_string_stop)
+
+static const struct scanner avx2_scanner =
+{
+    "avx2", avx2_space, avx2_letters, avx2_digits, avx2_string
+};
+
+#endif
+
+const struct scanner *scanner_get(enum scanner_kind kind)
+{
+    switch (kind)
+    {
+    case SCALAR_SCANNER:
+    {
+        return &scalar_scanner;
+    }
+#ifdef HAVE_X86_SIMD
+    case SSE2_SCANNER:
+    {
+        return &sse2_scanner;
+    }
+    case AVX2_SCANNER:
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") ? &avx2_scanner : NULL;
+    }
+#endif
+    default:
+    {
+        return NULL;
+    }
+    }
+}
+
+const struct scanner *scanner_best(void)
+{
+    const struct scanner *scanner;
+
+    if ((scanner = scanner_get(AVX2_SCANNER)) != NULL
+        || (scanner = scanner_get(SSE2_SCANNER)) != NULL)
+    {
+        return scanner;
+    }
+    return &scalar_scanner;
+}
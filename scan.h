@@ -0,0 +1,60 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stdbool.h>
+
+enum char_class
+{
+    LETTER = 1,
+    DIGIT = 2,
+    SPACE = 4
+};
+
+extern const unsigned char char_class[256];
+
+static inline bool is_letter(char ch)
+{
+    return char_class[(unsigned char) ch] & LETTER;
+}
+
+static inline bool is_digit(char ch)
+{
+    return char_class[(unsigned char) ch] & DIGIT;
+}
+
+static inline bool is_space(char ch)
+{
+    return char_class[(unsigned char) ch] & SPACE;
+}
+
+/*
+ * Each function returns a pointer to the first character at or after p
+ * that ends the run.  The input must be '\0' terminated; '\0' ends every
+ * run.  The vector versions only issue aligned loads, so they never
+ * touch a page the terminator is not on; buffers the interpreter owns
+ * reserve SCAN_PADDING bytes past the terminator so those loads stay
+ * inside the allocation.
+ */
+#define SCAN_PADDING 32
+
+struct scanner
+{
+    const char *name;
+    const char *(*space)(const char *p);
+    const char *(*letters)(const char *p);
+    const char *(*digits)(const char *p);
+    /* Stops at '"' or '\0'. */
+    const char *(*string)(const char *p);
+};
+
+enum scanner_kind
+{
+    SCALAR_SCANNER,
+    SSE2_SCANNER,
+    AVX2_SCANNER
+};
+
+const struct scanner *scanner_get(enum scanner_kind kind);
+const struct scanner *scanner_best(void);
+
+#endif
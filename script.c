@@ -0,0 +1,234 @@
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fmt.h>
+
+#include "script.h"
+#include "lexer.h"
+#include "parser.h"
+#include "evaluator.h"
+#include "object.h"
+#include "state.h"
+#include "scan.h"
+#include "cache.h"
+
+#define GC_THRESHOLD 10000
+
+static void print_parse_errors(struct parser *parser)
+{
+    char *msg;
+
+    for (int i = 0; i < Seq_length(parser->errors); i++)
+    {
+        msg = (char *) Seq_get(parser->errors, i);
+        Fmt_fprint(stderr, "\t%s\n", msg);
+    }
+}
+
+/*
+ * Runs one top-level statement and collects garbage if enough has built
+ * up.  Returns false once the script should stop, setting rc on error.
+ */
+static bool execute(struct interpreter_state *state, struct statement *statement,
+                    struct env_object *env, int *threshold, int *rc)
+{
+    struct object *object;
+
+    object = eval(state, (struct node *) statement, env);
+    if (object->type == ERROR_OBJ)
+    {
+        output_flush(&state->output);
+        Fmt_fprint(stderr, "%s\n", ((struct error_object *) object)->value);
+        *rc = EXIT_FAILURE;
+        return false;
+    }
+    if (object->type == RETURN_VALUE_OBJ)
+    {
+        return false;
+    }
+    if (objects_allocated(state) > *threshold)
+    {
+        objects_gc(state, env);
+        *threshold = 2 * objects_allocated(state) + GC_THRESHOLD;
+    }
+    return true;
+}
+
+/*
+ * Runs a script one top-level statement at a time and frees each
+ * statement once it has run, so neither the source nor its AST is ever
+ * held in full.  Function literals are reference counted and outlive
+ * the statement that defined them.  With a writer, each statement is
+ * also saved to the cache, which is only kept if the whole script
+ * parsed.
+ */
+static int run(struct lexer *lexer, struct cache_writer *writer)
+{
+    struct interpreter_state *state;
+    struct env_object *env;
+    struct parser *parser;
+    struct statement *statement;
+    int threshold = GC_THRESHOLD;
+    int rc = EXIT_SUCCESS;
+
+    state = interpreter_state_alloc();
+    env = env_object_alloc(state, NULL);
+    parser = parser_alloc(lexer);
+    while ((statement = parser_next_statement(parser)) != NULL)
+    {
+        if (Seq_length(parser->errors) != 0)
+        {
+            statement_destroy(statement);
+            break;
+        }
+        if (writer != NULL)
+        {
+            cache_writer_add(writer, statement);
+        }
+        if (!execute(state, statement, env, &threshold, &rc))
+        {
+            statement_destroy(statement);
+            break;
+        }
+        statement_destroy(statement);
+    }
+    if (Seq_length(parser->errors) != 0)
+    {
+        output_flush(&state->output);
+        print_parse_errors(parser);
+        rc = EXIT_FAILURE;
+    }
+    if (writer != NULL)
+    {
+        /* Stopping early leaves the rest of the script unparsed. */
+        while (Seq_length(parser->errors) == 0
+               && (statement = parser_next_statement(parser)) != NULL)
+        {
+            if (Seq_length(parser->errors) == 0)
+            {
+                cache_writer_add(writer, statement);
+            }
+            statement_destroy(statement);
+        }
+        if (Seq_length(parser->errors) == 0)
+        {
+            cache_writer_commit(writer);
+        }
+        else
+        {
+            cache_writer_abort(writer);
+        }
+    }
+    parser_destroy(parser);
+    interpreter_state_destroy(state);
+    return rc;
+}
+
+/*
+ * Runs a program loaded from the cache.  Its statements belong to the
+ * cache and are released with it, after every object is gone.
+ */
+static int run_cached(struct program *program)
+{
+    struct interpreter_state *state;
+    struct env_object *env;
+    int threshold = GC_THRESHOLD;
+    int rc = EXIT_SUCCESS;
+
+    state = interpreter_state_alloc();
+    env = env_object_alloc(state, NULL);
+    for (int i = 0; i < Seq_length(program->statements); i++)
+    {
+        if (!execute(state, Seq_get(program->statements, i), env, &threshold, &rc))
+        {
+            break;
+        }
+    }
+    interpreter_state_destroy(state);
+    return rc;
+}
+
+int script_run_fd(int fd)
+{
+    struct lexer *lexer;
+    int rc;
+
+    lexer = lexer_alloc_fd(fd);
+    rc = run(lexer, NULL);
+    lexer_destroy(lexer);
+    return rc;
+}
+
+/*
+ * Maps the file read-only followed by zeroed anonymous memory, so the
+ * text is NUL-terminated and padded for the vector scanners without
+ * being copied.  Reserving the whole range first and mapping the file
+ * over its start keeps the pages past the end of the file valid.
+ */
+static char *map_file(int fd, size_t size, size_t *mapped)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    char *base;
+
+    *mapped = (size + 1 + SCAN_PADDING + page - 1) / page * page;
+    base = mmap(NULL, *mapped, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+    {
+        return NULL;
+    }
+    if (mmap(base, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+    {
+        munmap(base, *mapped);
+        return NULL;
+    }
+    /* The lexer reads front to back exactly once. */
+    madvise(base, size, MADV_SEQUENTIAL);
+    return base;
+}
+
+int script_run_file(const char *path)
+{
+    struct stat st;
+    struct lexer *lexer;
+    struct cached_program *cached;
+    char *input;
+    size_t mapped;
+    int fd;
+    int rc;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        Fmt_fprint(stderr, "cannot open %s: %s\n", path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    /* Pipes and other unmappable input are streamed instead. */
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0
+        || (input = map_file(fd, st.st_size, &mapped)) == NULL)
+    {
+        rc = script_run_fd(fd);
+        close(fd);
+        return rc;
+    }
+    close(fd);
+    cached = cache_load(path, &st, input);
+    if (cached != NULL)
+    {
+        munmap(input, mapped);
+        rc = run_cached(cached->program);
+        cache_unload(cached);
+        return rc;
+    }
+    lexer = lexer_alloc(input);
+    rc = run(lexer, cache_writer_alloc(path, &st, input));
+    lexer_destroy(lexer);
+    munmap(input, mapped);
+    return rc;
+}
@@ -0,0 +1,7 @@
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+int script_run_fd(int fd);
+int script_run_file(const char *path);
+
+#endif
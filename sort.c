@@ -0,0 +1,209 @@
+#include <string.h>
+#include <mem.h>
+
+#include "sort.h"
+
+/* Runs this short are finished with insertion sort. */
+#define SORT_RUN 16
+
+#define SWAP(type, x, y)                                                \
+    do                                                                  \
+    {                                                                   \
+        type t_ = (x);                                                  \
+        (x) = (y);                                                      \
+        (y) = t_;                                                       \
+    } while (0)
+
+/*
+ * Defines prefix_insertion, prefix_heap and prefix_intro for arrays of
+ * type ordered by LESS, which may use the less and cl every helper is
+ * passed.
+ */
+#define INTROSORT(prefix, type, LESS)                                   \
+    static void prefix##_insertion(type *a, int n, sort_less less, void *cl) \
+    {                                                                   \
+        type t;                                                         \
+        int j;                                                          \
+                                                                        \
+        for (int i = 1; i < n; i++)                                     \
+        {                                                               \
+            t = a[i];                                                   \
+            for (j = i; j > 0 && LESS(t, a[j - 1]); j--)                \
+            {                                                           \
+                a[j] = a[j - 1];                                        \
+            }                                                           \
+            a[j] = t;                                                   \
+        }                                                               \
+    }                                                                   \
+                                                                        \
+    static void prefix##_sift(type *a, int root, int n, sort_less less, void *cl) \
+    {                                                                   \
+        int child;                                                      \
+                                                                        \
+        while ((child = 2 * root + 1) < n)                              \
+        {                                                               \
+            if (child + 1 < n && LESS(a[child], a[child + 1]))          \
+            {                                                           \
+                child++;                                                \
+            }                                                           \
+            if (!LESS(a[root], a[child]))                               \
+            {                                                           \
+                return;                                                 \
+            }                                                           \
+            SWAP(type, a[root], a[child]);                              \
+            root = child;                                               \
+        }                                                               \
+    }                                                                   \
+                                                                        \
+    static void prefix##_heap(type *a, int n, sort_less less, void *cl) \
+    {                                                                   \
+        for (int i = n / 2 - 1; i >= 0; i--)                            \
+        {                                                               \
+            prefix##_sift(a, i, n, less, cl);                           \
+        }                                                               \
+        for (int i = n - 1; i > 0; i--)                                 \
+        {                                                               \
+            SWAP(type, a[0], a[i]);                                     \
+            prefix##_sift(a, 0, i, less, cl);                           \
+        }                                                               \
+    }                                                                   \
+                                                                        \
+    static void prefix##_intro(type *a, int n, int depth, sort_less less, void *cl) \
+    {                                                                   \
+        type pivot;                                                     \
+        int mid;                                                        \
+        int i;                                                          \
+        int j;                                                          \
+                                                                        \
+        while (n > SORT_RUN)                                            \
+        {                                                               \
+            if (depth-- == 0)                                           \
+            {                                                           \
+                prefix##_heap(a, n, less, cl);                          \
+                return;                                                 \
+            }                                                           \
+            mid = (n - 1) / 2;                                          \
+            if (LESS(a[mid], a[0]))                                     \
+            {                                                           \
+                SWAP(type, a[mid], a[0]);                               \
+            }                                                           \
+            if (LESS(a[n - 1], a[mid]))                                 \
+            {                                                           \
+                SWAP(type, a[n - 1], a[mid]);                           \
+                if (LESS(a[mid], a[0]))                                 \
+                {                                                       \
+                    SWAP(type, a[mid], a[0]);                           \
+                }                                                       \
+            }                                                           \
+            pivot = a[mid];                                             \
+            /* The bounds only matter when LESS is inconsistent. */     \
+            i = -1;                                                     \
+            j = n;                                                      \
+            for (;;)                                                    \
+            {                                                           \
+                do                                                      \
+                {                                                       \
+                    i++;                                                \
+                } while (i < n - 1 && LESS(a[i], pivot));               \
+                do                                                      \
+                {                                                       \
+                    j--;                                                \
+                } while (j > 0 && LESS(pivot, a[j]));                   \
+                if (i >= j)                                             \
+                {                                                       \
+                    break;                                              \
+                }                                                       \
+                SWAP(type, a[i], a[j]);                                 \
+            }                                                           \
+            /* Recurse into the smaller side, so the stack stays shallow. */ \
+            if (j + 1 < n - j - 1)                                      \
+            {                                                           \
+                prefix##_intro(a, j + 1, depth, less, cl);              \
+                a += j + 1;                                             \
+                n -= j + 1;                                             \
+            }                                                           \
+            else                                                        \
+            {                                                           \
+                prefix##_intro(a + j + 1, n - j - 1, depth, less, cl);  \
+                n = j + 1;                                              \
+            }                                                           \
+        }                                                               \
+        prefix##_insertion(a, n, less, cl);                             \
+    }
+
+static int depth_limit(int n)
+{
+    int depth = 0;
+
+    while (n > 1)
+    {
+        n >>= 1;
+        depth += 2;
+    }
+    return depth;
+}
+
+#define INT_LESS(x, y) ((x) < (y))
+
+INTROSORT(ints, long long, INT_LESS)
+
+void sort_ints(long long *a, int n)
+{
+    ints_intro(a, n, depth_limit(n), NULL, NULL);
+}
+
+#define OBJECT_LESS(x, y) less((x), (y), cl)
+
+INTROSORT(objects, struct object *, OBJECT_LESS)
+
+void sort_objects(struct object **a, int n, sort_less less, void *cl)
+{
+    objects_intro(a, n, depth_limit(n), less, cl);
+}
+
+/* Merges the sorted a[lo..mid) and a[mid..hi); ties come from the left. */
+static void merge(struct object **a, struct object **tmp, int lo, int mid, int hi,
+                  sort_less less, void *cl)
+{
+    int i = lo;
+    int j = mid;
+    int k = lo;
+
+    while (i < mid && j < hi)
+    {
+        tmp[k++] = less(a[j], a[i], cl) ? a[j++] : a[i++];
+    }
+    while (i < mid)
+    {
+        tmp[k++] = a[i++];
+    }
+    while (j < hi)
+    {
+        tmp[k++] = a[j++];
+    }
+    memcpy(a + lo, tmp + lo, (hi - lo) * sizeof *a);
+}
+
+void sort_objects_stable(struct object **a, int n, sort_less less, void *cl)
+{
+    struct object **tmp;
+
+    for (int lo = 0; lo < n; lo += SORT_RUN)
+    {
+        objects_insertion(a + lo, n - lo < SORT_RUN ? n - lo : SORT_RUN, less, cl);
+    }
+    if (n <= SORT_RUN)
+    {
+        return;
+    }
+    tmp = ALLOC(n * sizeof *tmp);
+    for (int width = SORT_RUN; width < n; width *= 2)
+    {
+        for (int lo = 0; lo + width < n; lo += 2 * width)
+        {
+            merge(a, tmp, lo, lo + width, lo + 2 * width < n ? lo + 2 * width : n,
+                  less, cl);
+        }
+    }
+    FREE(tmp);
+}
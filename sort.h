@@ -0,0 +1,23 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include <stdbool.h>
+
+struct object;
+
+/* True if a must come before b. */
+typedef bool (*sort_less)(struct object *a, struct object *b, void *cl);
+
+/*
+ * Introsort: quicksort with a median of three pivot, insertion sort for
+ * short runs, and heapsort once the recursion gets deeper than
+ * 2 log2(n), so the worst case stays O(n log n).  less may be
+ * inconsistent, as a Monkey callback can be; the order is then
+ * unspecified but every access stays within the array.
+ */
+void sort_ints(long long *a, int n);
+void sort_objects(struct object **a, int n, sort_less less, void *cl);
+/* A merge sort that keeps elements that are not less than each other in order. */
+void sort_objects_stable(struct object **a, int n, sort_less less, void *cl);
+
+#endif
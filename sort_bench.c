@@ -0,0 +1,99 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "compile.h"
+#include "object.h"
+#include "state.h"
+
+/* The quicksort users write without a sort builtin. */
+static const char *quicksort =
+    "let concat = fn(a, b) { if (len(b) == 0) { a } else { concat(push(a, first(b)), rest(b)) } }; "
+    "let partition = fn(xs, p, lo, hi) { if (len(xs) == 0) { [lo, hi] } else { "
+    "let x = first(xs); if (x < p) { partition(rest(xs), p, push(lo, x), hi) } "
+    "else { partition(rest(xs), p, lo, push(hi, x)) } } }; "
+    "let quicksort = fn(xs) { if (len(xs) < 2) { xs } else { let p = first(xs); "
+    "let parts = partition(rest(xs), p, [], []); "
+    "concat(push(quicksort(parts[0]), p), quicksort(parts[1])) } }; "
+    "quicksort(xs)";
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double run(struct interpreter_state *state, const char *source, int n)
+{
+    struct compiled_program *compiled;
+    struct hash_object *inputs;
+    struct object *object;
+    Seq_T elements;
+    Table_T pairs;
+    unsigned seed = 1;
+    double start;
+    double secs;
+
+    /* Collect the last run's garbage now, so it is not timed. */
+    objects_gc(state, env_object_alloc(state, NULL));
+    elements = Seq_new(n);
+    for (int i = 0; i < n; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        Seq_addhi(elements, integer_object_alloc(state, seed >> 8));
+    }
+    pairs = Table_new(1, object_cmp, object_hash);
+    Table_put(pairs, string_object_alloc(state, (Text_T) { 2, "xs" }),
+              array_object_alloc(state, elements));
+    inputs = hash_object_alloc(state, pairs);
+    compiled = compiled_program_alloc(source);
+    start = now();
+    object = compiled_program_run(state, compiled, inputs);
+    secs = now() - start;
+    if (object->type != ARRAY_OBJ || sequence_length(object) != n)
+    {
+        printf("%s failed: %.60s\n", source, object_inspect(object));
+    }
+    compiled_program_destroy(compiled);
+    return secs;
+}
+
+int main(void)
+{
+    static const struct
+    {
+        const char *name;
+        const char *source;
+    } sorts[] =
+      {
+          { "sort", "sort(xs)" },
+          { "sort, less", "sort(xs, fn(a, b) { a < b })" },
+          { "sort_stable, less", "sort_stable(xs, fn(a, b) { a < b })" }
+      };
+    struct interpreter_state *state;
+    double base;
+    double secs;
+
+    state = interpreter_state_alloc();
+    /* The Monkey quicksort recurses once per element, so n stays small. */
+    base = run(state, quicksort, 2000);
+    printf("%d integers\n", 2000);
+    printf("%-18s %.4f s\n", "monkey quicksort", base);
+    for (int i = 0; i < sizeof sorts / sizeof sorts[0]; i++)
+    {
+        secs = run(state, sorts[i].source, 2000);
+        printf("%-18s %.4f s, speedup %.0f\n", sorts[i].name, secs, base / secs);
+    }
+    /* Every callback makes an environment that lives until the run ends. */
+    printf("%d integers\n", 200000);
+    for (int i = 0; i < sizeof sorts / sizeof sorts[0]; i++)
+    {
+        printf("%-18s %.4f s\n", sorts[i].name, run(state, sorts[i].source, 200000));
+    }
+    interpreter_state_destroy(state);
+    return EXIT_SUCCESS;
+}
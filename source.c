@@ -0,0 +1,87 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <mem.h>
+
+#include "source.h"
+#include "scan.h"
+
+struct source *source_alloc(int fd, size_t chunk)
+{
+    struct source *source;
+
+    NEW0(source);
+    source->fd = fd;
+    source->chunk = chunk;
+    source->size = chunk;
+    source->buffer = ALLOC(source->size + 1 + SCAN_PADDING);
+    source->buffer[0] = '\0';
+    source->limit = source->buffer;
+    return source;
+}
+
+void source_destroy(struct source *source)
+{
+    FREE(source->buffer);
+    FREE(source->retired);
+    FREE(source);
+}
+
+/*
+ * Moves [*keep, limit) to the front of a buffer, updating *keep, and
+ * reads more input after it.  Returns false once the input is
+ * exhausted; *keep is still valid then.
+ */
+bool source_refill(struct source *source, const char **keep)
+{
+    size_t kept = source->limit - *keep;
+    char *buffer;
+    size_t size;
+    ssize_t n;
+
+    if (source->eof)
+    {
+        return false;
+    }
+    if (*keep == source->buffer)
+    {
+        /* The token fills the buffer: grow it, nothing else points in. */
+        if (source->size < kept + source->chunk)
+        {
+            source->size = kept + source->chunk;
+            RESIZE(source->buffer, source->size + 1 + SCAN_PADDING);
+        }
+    }
+    else
+    {
+        /* Nothing points into the retired buffer any more: reuse it. */
+        buffer = source->retired;
+        size = source->retired_size;
+        if (buffer == NULL || size < kept + source->chunk)
+        {
+            FREE(buffer);
+            size = kept + source->chunk;
+            buffer = ALLOC(size + 1 + SCAN_PADDING);
+        }
+        memcpy(buffer, *keep, kept);
+        source->retired = source->buffer;
+        source->retired_size = source->size;
+        source->buffer = buffer;
+        source->size = size;
+    }
+    *keep = source->buffer;
+    do
+    {
+        n = read(source->fd, source->buffer + kept, source->size - kept);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0)
+    {
+        source->eof = true;
+        n = 0;
+    }
+    source->limit = source->buffer + kept + n;
+    source->buffer[kept + n] = '\0';
+    return n > 0;
+}
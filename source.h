@@ -0,0 +1,34 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Buffered input from a file descriptor for the lexer.  The valid text
+ * is [buffer, limit) and *limit is always '\0', so the lexer's scan
+ * loops stop at the end of a buffer exactly as they do at the end of a
+ * string.
+ *
+ * Refilling copies the partial token at the end of the buffer into a
+ * fresh buffer and keeps the old one until the next refill, because
+ * the parser still holds the token returned before it.  Memory is
+ * bounded by two buffers of about the chunk size or the longest token.
+ */
+struct source
+{
+    int fd;
+    size_t chunk;
+    char *buffer;
+    size_t size;
+    const char *limit;
+    char *retired;
+    size_t retired_size;
+    bool eof;
+};
+
+struct source *source_alloc(int fd, size_t chunk);
+void source_destroy(struct source *source);
+bool source_refill(struct source *source, const char **keep);
+
+#endif
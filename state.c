@@ -0,0 +1,57 @@
+#include <mem.h>
+
+#include "state.h"
+#include "parser.h"
+#include "object.h"
+#include "builtins.h"
+#include "evaluator.h"
+
+struct interpreter_state *interpreter_state_alloc(void)
+{
+    struct interpreter_state *state;
+
+    parser_init();
+    NEW0(state);
+    objects_init(state);
+    builtins_init(state);
+    evaluator_init(state);
+    output_init(&state->output, stdout);
+    return state;
+}
+
+void interpreter_state_destroy(struct interpreter_state *state)
+{
+    output_free(&state->output);
+    objects_destroy(state);
+    builtins_destroy(state);
+    evaluator_destroy(state);
+    FREE(state);
+}
+
+struct interpreter_state *interpreter_state_fork(struct interpreter_state *state)
+{
+    struct interpreter_state *fork;
+
+    NEW0(fork);
+    objects_init(fork);
+    fork->builtins = state->builtins;
+    fork->builtins_version = state->builtins_version;
+    evaluator_init(fork);
+    /* Forks never fork again; nested pmaps run serially. */
+    fork->threads = 1;
+    fork->parent = state;
+    /* Kept in memory until the join, so forks neither split each other's lines nor overtake state. */
+    output_init(&fork->output, NULL);
+    return fork;
+}
+
+void interpreter_state_join(struct interpreter_state *state,
+                            struct interpreter_state *fork)
+{
+    output_write(&state->output, fork->output.data, fork->output.length);
+    output_free(&fork->output);
+    objects_move(state, fork);
+    Seq_free(&fork->allocated_objects);
+    evaluator_destroy(fork);
+    FREE(fork);
+}
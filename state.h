@@ -0,0 +1,55 @@
+#ifndef STATE_H
+#define STATE_H
+
+#include <seq.h>
+#include <table.h>
+
+#include "output.h"
+
+struct arg_chunk;
+
+/*
+ * Everything one interpreter mutates.  Interpreters share nothing else,
+ * so each may run on its own thread; objects and environments must not
+ * be passed between them.  ASTs may only be shared once parsed, as
+ * compiled programs are.
+ */
+struct interpreter_state
+{
+    /* Every live object the GC owns. */
+    Seq_T allocated_objects;
+    /* Builtins visible to this interpreter, keyed by Text_T name. */
+    Table_T builtins;
+    /* Builtins registered by the host, which own their entries above. */
+    Seq_T natives;
+    /* The evaluator's argument stack and a chunk kept for reuse. */
+    struct arg_chunk *args;
+    struct arg_chunk *spare_args;
+    /* Threads pmap may use; 0 means one per online CPU. */
+    int threads;
+    /*
+     * Changes whenever a builtin is added, so call sites can tell that
+     * the builtin they remember is still the one its name means.  It is
+     * 0 while the builtins are the language's own, which every
+     * interpreter shares.
+     */
+    unsigned builtins_version;
+    /* The interpreter this one was forked from, or NULL. */
+    struct interpreter_state *parent;
+    /* What puts writes, flushed at the end of each program. */
+    struct output output;
+};
+
+struct interpreter_state *interpreter_state_alloc(void);
+void interpreter_state_destroy(struct interpreter_state *state);
+/*
+ * A fork has its own heap, argument stack and output buffer but shares
+ * the builtins of state, so it can evaluate functions made by state on
+ * another thread while state waits.  Joining appends the fork's output to
+ * state's, hands every object the fork made to state and frees the fork.
+ */
+struct interpreter_state *interpreter_state_fork(struct interpreter_state *state);
+void interpreter_state_join(struct interpreter_state *state,
+                            struct interpreter_state *fork);
+
+#endif
@@ -0,0 +1,100 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <mem.h>
+
+#include "compile.h"
+#include "object.h"
+#include "state.h"
+
+#define LINES 20000
+
+/* Monkey strings have no escapes, so the separators are literal newlines. */
+static const struct
+{
+    const char *name;
+    const char *source;
+} programs[] =
+  {
+      /* How lines were counted before there were string builtins. */
+      { "lines, per byte", "reduce(range(len(log)), 0, fn(n, i) { "
+        "if (substr(log, i, 1) == \"\n\") { n + 1 } else { n } })" },
+      { "lines, index", "reduce(range(len(log)), 0, fn(n, i) { "
+        "if (log[i] == \"\n\") { n + 1 } else { n } })" },
+      { "lines, split", "len(split(log, \"\n\")) - 1" },
+      { "fields, split", "reduce(split(log, \"\n\"), 0, fn(n, line) { n + len(split(line, \" \")) })" },
+      { "errors, starts_with", "len(filter(split(log, \"\n\"), fn(line) { "
+        "starts_with(substr(line, 20), \"ERROR\") }))" },
+      { "replace", "len(replace(log, \"user=\", \"u=\"))" },
+      { "index_of, missing", "index_of(log, \"user=none\")" },
+      { "join", "len(join(split(log, \"\n\"), \"\r\n\"))" }
+  };
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Lines like "2024-03-01 12:00:07 INFO user=1234 action=login took=17ms". */
+static char *make_log(int *length)
+{
+    static const char *levels[] = { "INFO", "WARN", "ERROR", "DEBUG" };
+    static const char *actions[] = { "login", "logout", "upload", "search" };
+    char *log;
+    char *p;
+
+    p = log = ALLOC(LINES * 80);
+    for (int i = 0; i < LINES; i++)
+    {
+        p += sprintf(p, "2024-03-01 12:%02d:%02d %s user=%d action=%s took=%dms\n",
+                     i / 60 % 60, i % 60, levels[i * 7 % 4], i * 31 % 10000,
+                     actions[i * 13 % 4], i % 997);
+    }
+    *length = p - log;
+    return log;
+}
+
+int main(void)
+{
+    struct interpreter_state *state;
+    struct compiled_program *compiled;
+    struct hash_object *inputs;
+    struct object *object;
+    Table_T pairs;
+    char *inspect;
+    char *log;
+    int length;
+    double start;
+    double secs;
+
+    state = interpreter_state_alloc();
+    log = make_log(&length);
+    printf("%d lines, %d bytes\n", LINES, length);
+    for (int i = 0; i < sizeof programs / sizeof programs[0]; i++)
+    {
+        /* A fresh input each time; the last run's garbage is collected untimed. */
+        objects_gc(state, env_object_alloc(state, NULL));
+        pairs = Table_new(1, object_cmp, object_hash);
+        Table_put(pairs, string_object_alloc(state, (Text_T) { 3, "log" }),
+                  string_object_alloc(state, (Text_T) { length, log }));
+        inputs = hash_object_alloc(state, pairs);
+        compiled = compiled_program_alloc(programs[i].source);
+        start = now();
+        object = compiled_program_run(state, compiled, inputs);
+        secs = now() - start;
+        inspect = object_inspect(object);
+        printf("%-20s %.4f s, %7.1f MB/s  (%s)\n", programs[i].name, secs,
+               length / secs / 1e6, inspect);
+        FREE(inspect);
+        compiled_program_destroy(compiled);
+    }
+    FREE(log);
+    interpreter_state_destroy(state);
+    return EXIT_SUCCESS;
+}
@@ -41,11 +41,14 @@ enum token_type
     RET
 };
 
+/* One past the last token type; sizes tables indexed by type. */
+#define TOKEN_TYPES (RET + 1)
+
 struct token
 {
     enum token_type type;
     Text_T literal;
-} token;
+};
 
 const char *token_type_name(enum token_type type);
 